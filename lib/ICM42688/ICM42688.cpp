@@ -0,0 +1,415 @@
+/**
+ * @file ICM42688.cpp
+ * @author Timo Lehnertz
+ * @brief Register level SPI driver for the TDK InvenSense ICM-42688-P
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "ICM42688.h"
+
+/**
+ * Anti alias filter settings from the datasheet table (section 5.3)
+ * 3dB bandwidth, delt, deltSqr, bitshift
+ */
+struct AafConfig {
+    uint16_t bandwidthHz;
+    uint8_t delt;
+    uint16_t deltSqr;
+    uint8_t bitshift;
+};
+
+static const AafConfig aafConfigs[] = {
+    { 126,   3,    9, 12},
+    { 258,   6,   36, 10},
+    { 536,  12,  144,  8},
+    { 997,  21,  440,  6},
+    {1962,  37, 1376,  4},
+    {3979,  63, 3968,  3},
+};
+
+static inline int16_t be16(const uint8_t* data) {
+    return int16_t((((uint16_t)data[0]) << 8) | data[1]);
+}
+
+ICM42688::ICM42688(SPIClass &bus, uint8_t csPin) {
+    _spi = &bus;
+    _csPin = csPin;
+    _useSPIHS = false;
+}
+
+int ICM42688::begin() {
+    pinMode(_csPin, OUTPUT);
+    digitalWrite(_csPin, HIGH);
+    _spi->begin();
+    _useSPIHS = false;
+    _bank = 0xFF; // force bank write
+    if(setBank(0) < 0) {
+        return -1;
+    }
+    // reset the device. Registers are not accessible for 1ms after a reset
+    writeRegister(DEVICE_CONFIG, DEVICE_RESET, false);
+    delay(2);
+    _bank = 0xFF;
+    if(setBank(0) < 0) {
+        return -2;
+    }
+    if(whoAmI() != WHO_AM_I_VALUE) {
+        return -3;
+    }
+    if(writeRegister(INTF_CONFIG0, INTF_CONFIG0_SPI_ONLY) < 0) {
+        return -4;
+    }
+    // gyro and accel in low noise mode. No register writes for 200us after changing power modes
+    if(writeRegister(PWR_MGMT0, PWR_GYRO_ACCEL_LN) < 0) {
+        return -5;
+    }
+    delayMicroseconds(300);
+    if(setGyroRange(GYRO_RANGE_2000DPS) < 0) {
+        return -6;
+    }
+    if(setAccelRange(ACCEL_RANGE_16G) < 0) {
+        return -7;
+    }
+    if(setOdr(ODR_8KHZ) < 0) {
+        return -8;
+    }
+    if(writeRegister(TMST_CONFIG, TMST_EN_1US) < 0) {
+        return -9;
+    }
+    if(disableFifo() < 0) {
+        return -10;
+    }
+    return 1;
+}
+
+int ICM42688::setGyroRange(GyroRange range) {
+    _useSPIHS = false;
+    uint8_t config = (_gyroConfig0 & 0x0F) | (uint8_t(range) << 5);
+    if(writeRegister(GYRO_CONFIG0, config) < 0) {
+        return -1;
+    }
+    _gyroConfig0 = config;
+    // 2000dps => 16.4 LSB/dps, every step halves the range
+    _gyroScale16 = (2000.0f / 32768.0f) / float(1 << range);
+    updateScales();
+    return 1;
+}
+
+int ICM42688::setAccelRange(AccelRange range) {
+    _useSPIHS = false;
+    uint8_t config = (_accelConfig0 & 0x0F) | (uint8_t(range) << 5);
+    if(writeRegister(ACCEL_CONFIG0, config) < 0) {
+        return -1;
+    }
+    _accelConfig0 = config;
+    // 16g => 2048 LSB/g, every step halves the range
+    _accelScale16 = (16.0f / 32768.0f) / float(1 << range);
+    updateScales();
+    return 1;
+}
+
+int ICM42688::setOdr(Odr odr) {
+    _useSPIHS = false;
+    uint8_t gyroConfig = (_gyroConfig0 & 0xF0) | uint8_t(odr);
+    uint8_t accelConfig = (_accelConfig0 & 0xF0) | uint8_t(odr);
+    if(writeRegister(GYRO_CONFIG0, gyroConfig) < 0) {
+        return -1;
+    }
+    if(writeRegister(ACCEL_CONFIG0, accelConfig) < 0) {
+        return -2;
+    }
+    _gyroConfig0 = gyroConfig;
+    _accelConfig0 = accelConfig;
+    return 1;
+}
+
+uint32_t ICM42688::getOdrHz() const {
+    switch(_gyroConfig0 & 0x0F) {
+        case ODR_32KHZ: return 32000;
+        case ODR_16KHZ: return 16000;
+        case ODR_8KHZ:  return 8000;
+        case ODR_4KHZ:  return 4000;
+        case ODR_2KHZ:  return 2000;
+        case ODR_1KHZ:  return 1000;
+        case ODR_200HZ: return 200;
+        case ODR_100HZ: return 100;
+        default:        return 1000;
+    }
+}
+
+void ICM42688::getAafConfig(AafBandwidth bandwidth, uint8_t& delt, uint16_t& deltSqr, uint8_t& bitshift) {
+    const AafConfig& config = aafConfigs[bandwidth < AAF_DISABLED ? bandwidth : AAF_BANDWIDTH_258HZ];
+    delt = config.delt;
+    deltSqr = config.deltSqr;
+    bitshift = config.bitshift;
+}
+
+int ICM42688::setGyroAaf(AafBandwidth bandwidth) {
+    _useSPIHS = false;
+    uint8_t delt, bitshift;
+    uint16_t deltSqr;
+    getAafConfig(bandwidth, delt, deltSqr, bitshift);
+    int status = 1;
+    if(setBank(1) < 0) return -1;
+    // keep the notch filter disabled, only toggle the AAF
+    if(writeRegister(GYRO_CONFIG_STATIC2, bandwidth == AAF_DISABLED ? 0x03 : 0x01) < 0) status = -2;
+    if(bandwidth != AAF_DISABLED && status > 0) {
+        if(writeRegister(GYRO_CONFIG_STATIC3, delt & 0x3F) < 0) status = -3;
+        if(writeRegister(GYRO_CONFIG_STATIC4, deltSqr & 0xFF) < 0) status = -4;
+        if(writeRegister(GYRO_CONFIG_STATIC5, (bitshift << 4) | ((deltSqr >> 8) & 0x0F)) < 0) status = -5;
+    }
+    if(setBank(0) < 0) return -6;
+    return status;
+}
+
+int ICM42688::setAccelAaf(AafBandwidth bandwidth) {
+    _useSPIHS = false;
+    uint8_t delt, bitshift;
+    uint16_t deltSqr;
+    getAafConfig(bandwidth, delt, deltSqr, bitshift);
+    int status = 1;
+    if(setBank(2) < 0) return -1;
+    if(bandwidth == AAF_DISABLED) {
+        if(writeRegister(ACCEL_CONFIG_STATIC2, 0x01) < 0) status = -2;
+    } else {
+        if(writeRegister(ACCEL_CONFIG_STATIC2, (delt & 0x3F) << 1) < 0) status = -2;
+        if(writeRegister(ACCEL_CONFIG_STATIC3, deltSqr & 0xFF) < 0) status = -3;
+        if(writeRegister(ACCEL_CONFIG_STATIC4, (bitshift << 4) | ((deltSqr >> 8) & 0x0F)) < 0) status = -4;
+    }
+    if(setBank(0) < 0) return -5;
+    return status;
+}
+
+int ICM42688::enableFifo(bool hires) {
+    _useSPIHS = false;
+    uint8_t config1 = FIFO_ACCEL_GYRO_TEMP_EN | (hires ? FIFO_HIRES_EN : 0);
+    if(writeRegister(FIFO_CONFIG1, config1) < 0) {
+        return -1;
+    }
+    if(writeRegister(FIFO_CONFIG, FIFO_MODE_STREAM) < 0) {
+        return -2;
+    }
+    writeRegister(SIGNAL_PATH_RESET, FIFO_FLUSH, false);
+    _fifoEnabled = true;
+    _fifoHires = hires;
+    _timestampInitialized = false;
+    _fifoSampleCount = 0;
+    updateScales();
+    return 1;
+}
+
+int ICM42688::disableFifo() {
+    _useSPIHS = false;
+    if(writeRegister(FIFO_CONFIG, FIFO_MODE_BYPASS) < 0) {
+        return -1;
+    }
+    _fifoEnabled = false;
+    _fifoHires = false;
+    _fifoSampleCount = 0;
+    updateScales();
+    return 1;
+}
+
+/**
+ * In high resolution mode the full scale range is fixed to 16g / 2000dps.
+ * The datasheet specifies 8192 LSB/g (18 bit) and 131 LSB/dps (19 bit). The 20 bit counts
+ * keep the always zero LSBs so they are scaled by 4 and 2 respectively
+ */
+void ICM42688::updateScales() {
+    if(_fifoHires) {
+        _accelScale = 1.0f / (8192.0f * 4.0f);
+        _gyroScale = 1.0f / (131.072f * 2.0f);
+    } else {
+        _accelScale = _accelScale16;
+        _gyroScale = _gyroScale16;
+    }
+}
+
+int ICM42688::readSensor() {
+    _useSPIHS = true;
+    if(readRegisters(TEMP_DATA1, 14, _buffer) < 0) {
+        return -1;
+    }
+    _sampleTimeUs = micros();
+    _t = be16(_buffer) / 132.48f + 25.0f;
+    // register data is always 16 bit. Scale it to the counts used by the fifo
+    float accelMul = _accelScale16 / _accelScale;
+    float gyroMul = _gyroScale16 / _gyroScale;
+    _axcounts = be16(_buffer + 2) * accelMul;
+    _aycounts = be16(_buffer + 4) * accelMul;
+    _azcounts = be16(_buffer + 6) * accelMul;
+    _gxcounts = be16(_buffer + 8) * gyroMul;
+    _gycounts = be16(_buffer + 10) * gyroMul;
+    _gzcounts = be16(_buffer + 12) * gyroMul;
+    return 1;
+}
+
+int ICM42688::readFifo() {
+    _fifoSampleCount = 0;
+    if(!_fifoEnabled) {
+        return -1;
+    }
+    _useSPIHS = true;
+    if(readRegisters(FIFO_COUNTH, 2, _buffer) < 0) {
+        return -2;
+    }
+    size_t count = (((uint16_t)_buffer[0]) << 8) | _buffer[1];
+    if(count == 0xFFFF) {
+        return -2; // MISO floating high: the chip does not answer
+    }
+    size_t packetSize = _fifoHires ? PACKET_SIZE_20 : PACKET_SIZE_16;
+    if(count > FIFO_SIZE) {
+        count = FIFO_SIZE;
+    }
+    count -= count % packetSize; // only read complete packets. The rest stays in the FIFO
+    if(count == 0) {
+        return 0;
+    }
+    if(readRegisters(FIFO_DATA, count, _fifoBuffer) < 0) {
+        return -3;
+    }
+    uint64_t readTimeUs = micros();
+    _fifoSampleCount = decodeFifo(_fifoBuffer, count, _fifoSamples, MAX_FIFO_SAMPLES);
+    if(_fifoSampleCount == 0) {
+        return 0;
+    }
+    unwrapTimestamps(readTimeUs);
+    // latest valid values
+    for (size_t i = _fifoSampleCount; i > 0; i--) {
+        const FifoSample& sample = _fifoSamples[i - 1];
+        if(sample.accelValid && sample.gyroValid) {
+            _axcounts = sample.accel[0];
+            _aycounts = sample.accel[1];
+            _azcounts = sample.accel[2];
+            _gxcounts = sample.gyro[0];
+            _gycounts = sample.gyro[1];
+            _gzcounts = sample.gyro[2];
+            _sampleTimeUs = _fifoSampleTimesUs[i - 1];
+            _t = _fifoHires ? sample.temperature / 132.48f + 25.0f : sample.temperature / 2.07f + 25.0f;
+            break;
+        }
+    }
+    return _fifoSampleCount;
+}
+
+/**
+ * Extends the 16 bit chip timestamps to 64 bit and maps them to micros().
+ * The newest sample is assumed to have been taken at the time of the FIFO read
+ */
+void ICM42688::unwrapTimestamps(uint64_t readTimeUs) {
+    if(!_timestampInitialized) {
+        _lastTimestamp = _fifoSamples[0].timestamp;
+        _timestampInitialized = true;
+    }
+    uint64_t chipTimes[MAX_FIFO_SAMPLES];
+    for (size_t i = 0; i < _fifoSampleCount; i++) {
+        uint16_t delta = _fifoSamples[i].timestamp - _lastTimestamp; // wraps correctly in 16 bit
+        _chipTimeUs += delta;
+        _lastTimestamp = _fifoSamples[i].timestamp;
+        chipTimes[i] = _chipTimeUs;
+    }
+    uint64_t newest = chipTimes[_fifoSampleCount - 1];
+    for (size_t i = 0; i < _fifoSampleCount; i++) {
+        _fifoSampleTimesUs[i] = readTimeUs - (newest - chipTimes[i]);
+    }
+}
+
+size_t ICM42688::getPacketSize(uint8_t header) {
+    if(header & HEADER_MSG) return 0; // fifo empty
+    if(header & HEADER_20) return PACKET_SIZE_20;
+    bool accel = header & HEADER_ACCEL;
+    bool gyro = header & HEADER_GYRO;
+    if(accel && gyro) return PACKET_SIZE_16;
+    if(accel || gyro) return 8; // packet 1 / 2
+    return 0;
+}
+
+size_t ICM42688::decodeFifo(const uint8_t* data, size_t length, FifoSample* dest, size_t maxSamples) {
+    size_t samples = 0;
+    size_t offset = 0;
+    while(offset < length && samples < maxSamples) {
+        const uint8_t* packet = data + offset;
+        size_t size = getPacketSize(packet[0]);
+        if(size == 0 || offset + size > length) break;
+        offset += size;
+        if(size == 8) continue; // single sensor packets are not used
+        FifoSample& sample = dest[samples++];
+        bool hires = size == PACKET_SIZE_20;
+        bool accelValid = true;
+        bool gyroValid = true;
+        for (size_t axis = 0; axis < 3; axis++) {
+            int16_t accel = be16(packet + 1 + axis * 2);
+            int16_t gyro = be16(packet + 7 + axis * 2);
+            // -32768 marks an invalid sample in both modes
+            accelValid &= accel != INT16_MIN;
+            gyroValid &= gyro != INT16_MIN;
+            if(hires) {
+                // extension byte: accel bits 3:0 in the upper nibble, gyro bits 3:0 in the lower nibble
+                uint8_t extension = packet[17 + axis];
+                sample.accel[axis] = int32_t(accel) * 16 + (extension >> 4);
+                sample.gyro[axis] = int32_t(gyro) * 16 + (extension & 0x0F);
+            } else {
+                sample.accel[axis] = accel;
+                sample.gyro[axis] = gyro;
+            }
+        }
+        if(hires) {
+            sample.temperature = be16(packet + 13);
+            sample.timestamp = uint16_t(be16(packet + 15));
+        } else {
+            sample.temperature = int8_t(packet[13]);
+            sample.timestamp = uint16_t(be16(packet + 14));
+        }
+        sample.accelValid = accelValid && (packet[0] & HEADER_ACCEL);
+        sample.gyroValid = gyroValid && (packet[0] & HEADER_GYRO);
+    }
+    return samples;
+}
+
+int ICM42688::setBank(uint8_t bank) {
+    if(bank == _bank) return 1;
+    if(writeRegister(REG_BANK_SEL, bank, false) < 0) {
+        return -1;
+    }
+    _bank = bank;
+    return 1;
+}
+
+int ICM42688::whoAmI() {
+    if(readRegisters(WHO_AM_I, 1, _buffer) < 0) {
+        return -1;
+    }
+    return _buffer[0];
+}
+
+int ICM42688::writeRegister(uint8_t subAddress, uint8_t data, bool verify) {
+    _spi->beginTransaction(SPISettings(SPI_LS_CLOCK, MSBFIRST, SPI_MODE3));
+    digitalWriteFast(_csPin, LOW);
+    delayNanoseconds(200);
+    _spi->transfer(subAddress);
+    _spi->transfer(data);
+    digitalWriteFast(_csPin, HIGH);
+    delayNanoseconds(200);
+    _spi->endTransaction();
+    if(!verify) return 1;
+    delayMicroseconds(10);
+    /* read back the register */
+    uint8_t readBack;
+    readRegisters(subAddress, 1, &readBack);
+    return readBack == data ? 1 : -1;
+}
+
+int ICM42688::readRegisters(uint8_t subAddress, size_t count, uint8_t* dest) {
+    _spi->beginTransaction(SPISettings(_useSPIHS ? SPI_HS_CLOCK : SPI_LS_CLOCK, MSBFIRST, SPI_MODE3));
+    digitalWriteFast(_csPin, LOW);
+    delayNanoseconds(200);
+    _spi->transfer(subAddress | SPI_READ);
+    _spi->transfer(nullptr, dest, count); // burst read
+    digitalWriteFast(_csPin, HIGH);
+    delayNanoseconds(200);
+    _spi->endTransaction();
+    return 1;
+}
@@ -0,0 +1,256 @@
+/**
+ * @file ICM42688.h
+ * @author Timo Lehnertz
+ * @brief Register level SPI driver for the TDK InvenSense ICM-42688-P
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Supports:
+ *  - output data rates up to 32kHz for gyro and accelerometer
+ *  - burst reads of the 2kB FIFO in 16 bit (packet 3) or 20 bit (packet 4) mode
+ *  - configuration of the on chip anti alias filters (AAF)
+ *  - the on chip 16 bit ODR timestamp which gets unwrapped and mapped into the micros() time base
+ *
+ * Register addresses and packet layouts refer to the ICM-42688-P datasheet (DS-000347)
+ */
+#pragma once
+#include "Arduino.h"
+#include "SPI.h"
+
+class ICM42688 {
+public:
+    enum GyroRange {
+        GYRO_RANGE_2000DPS = 0,
+        GYRO_RANGE_1000DPS = 1,
+        GYRO_RANGE_500DPS = 2,
+        GYRO_RANGE_250DPS = 3,
+        GYRO_RANGE_125DPS = 4
+    };
+    enum AccelRange {
+        ACCEL_RANGE_16G = 0,
+        ACCEL_RANGE_8G = 1,
+        ACCEL_RANGE_4G = 2,
+        ACCEL_RANGE_2G = 3
+    };
+    /**
+     * Output data rates as encoded in GYRO_CONFIG0 / ACCEL_CONFIG0
+     */
+    enum Odr {
+        ODR_32KHZ = 1,
+        ODR_16KHZ = 2,
+        ODR_8KHZ = 3,
+        ODR_4KHZ = 4,
+        ODR_2KHZ = 5,
+        ODR_1KHZ = 6,
+        ODR_200HZ = 7,
+        ODR_100HZ = 8
+    };
+    /**
+     * 3dB bandwidths of the anti alias filter. Subset of the datasheet table in section 5.3
+     */
+    enum AafBandwidth {
+        AAF_BANDWIDTH_126HZ,
+        AAF_BANDWIDTH_258HZ,
+        AAF_BANDWIDTH_536HZ,
+        AAF_BANDWIDTH_997HZ,
+        AAF_BANDWIDTH_1962HZ,
+        AAF_BANDWIDTH_3979HZ,
+        AAF_DISABLED
+    };
+
+    /**
+     * One decoded FIFO packet in raw counts.
+     * 16 bit packets are stored as is, 20 bit packets keep their full resolution
+     */
+    struct FifoSample {
+        int32_t accel[3];
+        int32_t gyro[3];
+        int16_t temperature;
+        uint16_t timestamp; // raw 16 bit chip timestamp
+        bool accelValid;
+        bool gyroValid;
+    };
+
+    static constexpr size_t FIFO_SIZE = 2048;               // bytes
+    static constexpr size_t PACKET_SIZE_16 = 16;            // packet 3: header, accel, gyro, temp(1), timestamp
+    static constexpr size_t PACKET_SIZE_20 = 20;            // packet 4: header, accel, gyro, temp(2), timestamp, 3 extension bytes
+    static constexpr size_t MAX_FIFO_SAMPLES = FIFO_SIZE / PACKET_SIZE_16;
+
+    ICM42688(SPIClass &bus, uint8_t csPin);
+
+    /**
+     * Resets and wakes up the sensor in low noise mode
+     * @return 1 on success negative on failure
+     */
+    int begin();
+    int setGyroRange(GyroRange range);
+    int setAccelRange(AccelRange range);
+    int setOdr(Odr odr);
+    int setGyroAaf(AafBandwidth bandwidth);
+    int setAccelAaf(AafBandwidth bandwidth);
+
+    /**
+     * Starts the FIFO in stream mode and flushes it
+     * @param hires true for 20 bit packets (range fixed to 16g / 2000dps)
+     */
+    int enableFifo(bool hires);
+    int disableFifo();
+
+    /**
+     * Reads the data registers directly. Bypasses the FIFO
+     */
+    int readSensor();
+
+    /**
+     * Burst reads all complete packets from the FIFO and decodes them
+     * @return number of decoded samples, -1 if the FIFO is disabled, -2 if the chip does not answer
+     */
+    int readFifo();
+
+    size_t getFifoSampleCount() const { return _fifoSampleCount; }
+    const FifoSample& getFifoSample(size_t i) const { return _fifoSamples[i]; }
+
+    /**
+     * Sample time of the i-th FIFO sample in the micros() time base.
+     * Derived from the unwrapped chip timestamps relative to the time of the FIFO read
+     */
+    uint64_t getFifoSampleTimeUs(size_t i) const { return _fifoSampleTimesUs[i]; }
+
+    /**
+     * Sample time of the latest valid reading in the micros() time base
+     */
+    uint64_t getSampleTimeUs() const { return _sampleTimeUs; }
+
+    /**
+     * Latest valid reading. Updated by readSensor() and readFifo()
+     */
+    float getAccelX_G() const { return _axcounts * _accelScale; }
+    float getAccelY_G() const { return _aycounts * _accelScale; }
+    float getAccelZ_G() const { return _azcounts * _accelScale; }
+    float getGyroX_dps() const { return _gxcounts * _gyroScale; }
+    float getGyroY_dps() const { return _gycounts * _gyroScale; }
+    float getGyroZ_dps() const { return _gzcounts * _gyroScale; }
+    float getTemperature_C() const { return _t; }
+
+    /**
+     * @return G per LSB of the counts delivered in the current mode
+     */
+    float getAccelScale() const { return _accelScale; }
+
+    /**
+     * @return deg/s per LSB of the counts delivered in the current mode
+     */
+    float getGyroScale() const { return _gyroScale; }
+
+    uint32_t getOdrHz() const;
+
+    /**
+     * Decodes raw FIFO bytes into samples. Pure function without any bus access
+     * Decoding stops at the first empty marker, unknown header or incomplete packet
+     *
+     * @param data raw FIFO bytes
+     * @param length number of bytes in data
+     * @param dest output buffer
+     * @param maxSamples capacity of dest
+     * @return number of samples written to dest
+     */
+    static size_t decodeFifo(const uint8_t* data, size_t length, FifoSample* dest, size_t maxSamples);
+
+    /**
+     * @return size in bytes of the packet starting with header or 0 if the header is not a valid packet
+     */
+    static size_t getPacketSize(uint8_t header);
+
+protected:
+    // spi
+    SPIClass *_spi;
+    uint8_t _csPin;
+    bool _useSPIHS;
+    const uint8_t SPI_READ = 0x80;
+    const uint32_t SPI_LS_CLOCK = 1000000;  // 1 MHz
+    const uint32_t SPI_HS_CLOCK = 24000000; // 24 MHz
+    // buffers
+    uint8_t _buffer[14];
+    uint8_t _fifoBuffer[FIFO_SIZE];
+    FifoSample _fifoSamples[MAX_FIFO_SAMPLES];
+    uint64_t _fifoSampleTimesUs[MAX_FIFO_SAMPLES];
+    size_t _fifoSampleCount = 0;
+    // latest data counts
+    int32_t _axcounts = 0, _aycounts = 0, _azcounts = 0;
+    int32_t _gxcounts = 0, _gycounts = 0, _gzcounts = 0;
+    float _t = 0;
+    uint64_t _sampleTimeUs = 0;
+    // scale factors
+    float _accelScale = 1.0f / 2048.0f;
+    float _gyroScale = 1.0f / 16.4f;
+    float _accelScale16 = 1.0f / 2048.0f;
+    float _gyroScale16 = 1.0f / 16.4f;
+    // configuration shadows
+    uint8_t _gyroConfig0 = 0x06;
+    uint8_t _accelConfig0 = 0x06;
+    uint8_t _bank = 0;
+    bool _fifoEnabled = false;
+    bool _fifoHires = false;
+    // timestamp unwrapping
+    bool _timestampInitialized = false;
+    uint16_t _lastTimestamp = 0;
+    uint64_t _chipTimeUs = 0;
+
+    // bank 0 registers
+    const uint8_t DEVICE_CONFIG = 0x11;
+    const uint8_t DEVICE_RESET = 0x01;
+    const uint8_t FIFO_CONFIG = 0x16;
+    const uint8_t FIFO_MODE_BYPASS = 0x00;
+    const uint8_t FIFO_MODE_STREAM = 0x40;
+    const uint8_t TEMP_DATA1 = 0x1D;
+    const uint8_t FIFO_COUNTH = 0x2E;
+    const uint8_t FIFO_DATA = 0x30;
+    const uint8_t SIGNAL_PATH_RESET = 0x4B;
+    const uint8_t FIFO_FLUSH = 0x02;
+    const uint8_t INTF_CONFIG0 = 0x4C;
+    const uint8_t INTF_CONFIG0_SPI_ONLY = 0x33; // big endian data and count, count in bytes, i2c disabled
+    const uint8_t PWR_MGMT0 = 0x4E;
+    const uint8_t PWR_GYRO_ACCEL_LN = 0x0F;
+    const uint8_t GYRO_CONFIG0 = 0x4F;
+    const uint8_t ACCEL_CONFIG0 = 0x50;
+    const uint8_t TMST_CONFIG = 0x54;
+    const uint8_t TMST_EN_1US = 0x21;           // timestamp enabled, 1us resolution, absolute values
+    const uint8_t FIFO_CONFIG1 = 0x5F;
+    const uint8_t FIFO_ACCEL_GYRO_TEMP_EN = 0x07;
+    const uint8_t FIFO_HIRES_EN = 0x10;
+    const uint8_t WHO_AM_I = 0x75;
+    const uint8_t WHO_AM_I_VALUE = 0x47;
+    const uint8_t REG_BANK_SEL = 0x76;
+    // bank 1 registers
+    const uint8_t GYRO_CONFIG_STATIC2 = 0x0B;
+    const uint8_t GYRO_CONFIG_STATIC3 = 0x0C;
+    const uint8_t GYRO_CONFIG_STATIC4 = 0x0D;
+    const uint8_t GYRO_CONFIG_STATIC5 = 0x0E;
+    // bank 2 registers
+    const uint8_t ACCEL_CONFIG_STATIC2 = 0x03;
+    const uint8_t ACCEL_CONFIG_STATIC3 = 0x04;
+    const uint8_t ACCEL_CONFIG_STATIC4 = 0x05;
+    // fifo header bits
+    static constexpr uint8_t HEADER_MSG = 0x80;
+    static constexpr uint8_t HEADER_ACCEL = 0x40;
+    static constexpr uint8_t HEADER_GYRO = 0x20;
+    static constexpr uint8_t HEADER_20 = 0x10;
+
+    int setBank(uint8_t bank);
+    /**
+     * @param verify read the register back and compare
+     * @return 1 on success, -1 if the read back differs
+     */
+    int writeRegister(uint8_t subAddress, uint8_t data, bool verify = true);
+    /**
+     * SPI has no acknowledge, so this always returns 1. A missing chip reads as all ones:
+     * callers detect it from the data (WHO_AM_I, write verification, FIFO count)
+     */
+    int readRegisters(uint8_t subAddress, size_t count, uint8_t* dest);
+    int whoAmI();
+    void updateScales();
+    void unwrapTimestamps(uint64_t readTimeUs);
+    void getAafConfig(AafBandwidth bandwidth, uint8_t& delt, uint16_t& deltSqr, uint8_t& bitshift);
+};
@@ -118,6 +118,13 @@ class MPU9250{
     int getMotion9(float* ax, float* ay, float* az, float* gx, float* gy, float* gz, float* mx, float* my, float* mz);
     void getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz);
     // jihlein additions end
+    // raw counts of the last readSensor() call in sensor axes
+    int16_t getAccelXCounts() { return _axcounts; }
+    int16_t getAccelYCounts() { return _aycounts; }
+    int16_t getAccelZCounts() { return _azcounts; }
+    int16_t getGyroXCounts() { return _gxcounts; }
+    int16_t getGyroYCounts() { return _gycounts; }
+    int16_t getGyroZCounts() { return _gzcounts; }
   protected:
     // i2c
     uint8_t _address;
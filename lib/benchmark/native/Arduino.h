@@ -0,0 +1,120 @@
+/**
+ * @file Arduino.h
+ * @author Timo Lehnertz
+ * @brief Minimal Arduino API for the native benchmark and test builds. Only what lib/maths, lib/filters, lib/pid, lib/crossfire, lib/imu and lib/ICM42688 use
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+
+using std::abs;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define DEC 10
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+// auto decays, decltype(a < b ? a : b) would be a reference to a parameter for equal types
+template<class A, class B> constexpr auto min(A a, B b) { return a < b ? a : b; }
+template<class A, class B> constexpr auto max(A a, B b) { return a > b ? a : b; }
+template<class A, class B, class C> constexpr A constrain(A a, B low, C high) { return a < low ? low : (a > high ? high : a); }
+
+template<class T, class A, class B, class C, class D>
+T map(T x, A inMin, B inMax, C outMin, D outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+inline uint32_t micros() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline uint32_t millis() {
+    return micros() / 1000;
+}
+
+inline void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+inline void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void delayNanoseconds(uint32_t) {}
+
+/**
+ * There are no pins. Chip selects are handled by the SPI stand in
+ */
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline void digitalWriteFast(uint8_t, uint8_t) {}
+
+/**
+ * Prints to stdout
+ */
+class Print {
+public:
+    size_t write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t* buf, size_t len) { return fwrite(buf, 1, len, stdout); }
+    size_t print(const char* s) { return fputs(s, stdout) < 0 ? 0 : strlen(s); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(int v, int = DEC) { return printf("%d", v); }
+    size_t print(unsigned int v, int = DEC) { return printf("%u", v); }
+    size_t print(long v, int = DEC) { return printf("%ld", v); }
+    size_t print(unsigned long v, int = DEC) { return printf("%lu", v); }
+    size_t print(long long v, int = DEC) { return printf("%lld", v); }
+    size_t print(unsigned long long v, int = DEC) { return printf("%llu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+    template<class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    size_t println(double v, int digits) { size_t n = print(v, digits); return n + println(); }
+    size_t println() { return print('\n'); }
+};
+
+class Stream : public Print {
+public:
+    int available() { return 0; }
+    int read() { return -1; }
+};
+
+/**
+ * UART stand in. Never receives anything, writes are dropped
+ */
+class HardwareSerial : public Stream {
+public:
+    void begin(uint32_t) {}
+    void end() {}
+    size_t write(const uint8_t*, size_t len) { return len; }
+};
+
+class usb_serial_class : public Stream {
+public:
+    void begin(uint32_t) {}
+    operator bool() { return true; }
+};
+
+inline usb_serial_class Serial;
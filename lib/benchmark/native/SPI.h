@@ -0,0 +1,48 @@
+/**
+ * @file SPI.h
+ * @author Timo Lehnertz
+ * @brief SPI stand in for the native test build. Tests derive from SPIClass to emulate a device
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define SPI_MODE0 0x00
+#define SPI_MODE3 0x0C
+
+struct SPISettings {
+    uint32_t clock;
+
+    SPISettings() : clock(4000000) {}
+    SPISettings(uint32_t clock, uint8_t, uint8_t) : clock(clock) {}
+};
+
+/**
+ * Same calls as the Teensy SPIClass. Every transaction starts with beginTransaction, so a device emulation
+ * can treat the first transferred byte after it as the address. Without a device MISO floats high
+ */
+class SPIClass {
+public:
+    virtual ~SPIClass() {}
+
+    virtual void begin() {}
+    virtual void beginTransaction(SPISettings settings) {}
+    virtual void endTransaction() {}
+    virtual uint8_t transfer(uint8_t data) { return 0xFF; }
+
+    void transfer(const void* buf, void* retbuf, size_t count) {
+        const uint8_t* tx = (const uint8_t*) buf;
+        uint8_t* rx = (uint8_t*) retbuf;
+        for (size_t i = 0; i < count; i++) {
+            uint8_t in = transfer(tx ? tx[i] : (uint8_t) 0);
+            if(rx) rx[i] = in;
+        }
+    }
+};
+
+inline SPIClass SPI;
@@ -0,0 +1,164 @@
+/**
+ * @file benchmark.h
+ * @author Timo Lehnertz
+ * @brief Micro benchmark harness shared by the native and the Teensy runner
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ * Keeps the compiler from removing a computation whose result is otherwise unused
+ */
+template<typename T>
+inline void benchmarkKeep(const T& value) {
+    asm volatile("" : : "g" (&value) : "memory");
+}
+
+/**
+ * One benchmark. run() executes the measured operation iterations times
+ */
+struct Benchmark {
+    const char* suite;
+    const char* name;
+    void (*run)(uint32_t iterations);
+};
+
+/**
+ * Runs benchmarks and prints one JSON object per line:
+ *  {"type":"runner",...}    once, describes the clock
+ *  {"type":"result",...}    per benchmark, time per operation in ticks of the clock
+ *
+ * Every benchmark is first calibrated to an iteration count whose batch takes at least batchTicks.
+ * Then samples batches are timed, the clock overhead is subtracted and min, median, mean and standard deviation
+ * of the time per operation are reported
+ */
+class BenchmarkRunner {
+public:
+    typedef uint32_t (*Clock)();
+    typedef void (*Output)(const char* line);
+
+    static constexpr int maxSamples = 64;
+
+    /**
+     * @param runner name of the runner
+     * @param unit unit of one clock tick ("ns", "cycles")
+     * @param ticksPerSecond to convert ticks to ns in the output
+     * @param clock free running 32 bit counter. Batches have to be shorter than one wrap around
+     * @param output receives every line without line break
+     */
+    BenchmarkRunner(const char* runner, const char* unit, double ticksPerSecond, Clock clock, Output output)
+        : runner(runner), unit(unit), ticksPerSecond(ticksPerSecond), clock(clock), output(output) {}
+
+    int samples = 31;
+    uint32_t batchTicks = 100000;
+
+    /**
+     * @param filter only benchmarks whose "suite/name" contains filter. nullptr or "" runs all
+     */
+    void runAll(const Benchmark* benchmarks, int count, const char* build, const char* filter = nullptr) {
+        if(samples > maxSamples) samples = maxSamples;
+        if(samples < 1) samples = 1;
+        overhead = measureOverhead();
+        snprintf(line, sizeof(line), "{\"type\":\"runner\",\"runner\":\"%s\",\"build\":\"%s\",\"unit\":\"%s\",\"ticksPerSecond\":%.0f,\"clockOverhead\":%lu,\"samples\":%d}",
+            runner, build, unit, ticksPerSecond, (unsigned long) overhead, samples);
+        output(line);
+        for (int i = 0; i < count; i++) {
+            if(!matches(benchmarks[i], filter)) continue;
+            run(benchmarks[i]);
+        }
+        output("{\"type\":\"done\"}");
+    }
+
+    void run(const Benchmark& benchmark) {
+        uint32_t iterations = calibrate(benchmark);
+        float perOp[maxSamples];
+        for (int s = 0; s < samples; s++) {
+            uint32_t ticks = timeBatch(benchmark, iterations);
+            ticks = ticks > overhead ? ticks - overhead : 0;
+            perOp[s] = (float) ticks / iterations;
+        }
+        sort(perOp, samples);
+        float mean = 0;
+        for (int s = 0; s < samples; s++) {
+            mean += perOp[s];
+        }
+        mean /= samples;
+        float variance = 0;
+        for (int s = 0; s < samples; s++) {
+            variance += (perOp[s] - mean) * (perOp[s] - mean);
+        }
+        float stddev = samples > 1 ? sqrtf(variance / (samples - 1)) : 0;
+        float median = perOp[samples / 2];
+        snprintf(line, sizeof(line), "{\"type\":\"result\",\"suite\":\"%s\",\"name\":\"%s\",\"iterations\":%lu,\"min\":%.3f,\"median\":%.3f,\"mean\":%.3f,\"stddev\":%.3f,\"medianNs\":%.3f}",
+            benchmark.suite, benchmark.name, (unsigned long) iterations, perOp[0], median, mean, stddev, median * 1e9 / ticksPerSecond);
+        output(line);
+    }
+
+private:
+    const char* runner;
+    const char* unit;
+    double ticksPerSecond;
+    Clock clock;
+    Output output;
+    uint32_t overhead = 0;
+    char line[320];
+
+    static bool matches(const Benchmark& benchmark, const char* filter) {
+        if(filter == nullptr || filter[0] == 0) return true;
+        char name[128];
+        snprintf(name, sizeof(name), "%s/%s", benchmark.suite, benchmark.name);
+        return strstr(name, filter) != nullptr;
+    }
+
+    uint32_t timeBatch(const Benchmark& benchmark, uint32_t iterations) {
+        uint32_t start = clock();
+        benchmark.run(iterations);
+        return clock() - start;
+    }
+
+    /**
+     * Doubles the iteration count until one batch is long enough
+     */
+    uint32_t calibrate(const Benchmark& benchmark) {
+        uint32_t iterations = 1;
+        benchmark.run(iterations); // warm up caches and lazy init
+        while(iterations < (1UL << 24)) {
+            if(timeBatch(benchmark, iterations) >= batchTicks) break;
+            iterations *= 2;
+        }
+        return iterations;
+    }
+
+    /**
+     * Smallest time between two clock reads
+     */
+    uint32_t measureOverhead() {
+        uint32_t best = 0xFFFFFFFF;
+        for (int i = 0; i < 100; i++) {
+            uint32_t start = clock();
+            uint32_t ticks = clock() - start;
+            if(ticks < best) best = ticks;
+        }
+        return best;
+    }
+
+    static void sort(float* values, int count) {
+        for (int i = 1; i < count; i++) {
+            float v = values[i];
+            int j = i - 1;
+            while(j >= 0 && values[j] > v) {
+                values[j + 1] = values[j];
+                j--;
+            }
+            values[j + 1] = v;
+        }
+    }
+};
@@ -0,0 +1,606 @@
+/**
+ * @file benchmarks.cpp
+ * @author Timo Lehnertz
+ * @brief Benchmarks of the flight loop hot paths. Inputs cycle through small tables so nothing folds to a constant
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "benchmarks.h"
+#include <maths.h>
+#include <matrix.h>
+#include <fastMath.h>
+#include <lpf.h>
+#include <pid.h>
+#include <crossfire.h>
+#include <gyroFixed.h>
+#include <gyroLowPass.h>
+#include <rateCurve.h>
+#include <mixer.h>
+#include <thrustCurve.h>
+#include <rcSmoothing.h>
+#include <Mahony.h>
+#include <Magdwick.h>
+#include <ComplementaryFilter.h>
+#include <ErrorStateEKF.h>
+#include <ICM42688.h>
+
+#define BENCHMARK_STR2(x) #x
+#define BENCHMARK_STR(x) BENCHMARK_STR2(x)
+
+const char* benchmarkBuild = "FAST_MATH=" BENCHMARK_STR(FAST_MATH);
+
+namespace {
+
+constexpr int inputCount = 16;
+constexpr int inputMask = inputCount - 1;
+
+/**
+ * Deterministic pseudo random value in -1 - 1
+ */
+float input(int i, int salt) {
+    uint32_t x = (uint32_t) (i * 2654435761UL) ^ (uint32_t) (salt * 40503UL);
+    x ^= x >> 13;
+    x *= 0x5bd1e995;
+    x ^= x >> 15;
+    return (float) (x & 0xFFFF) / 32768.0f - 1.0f;
+}
+
+struct Inputs {
+    Vec3 vec[inputCount];
+    Quaternion quat[inputCount];
+    Vector3<float> vecf[inputCount];
+    QuaternionT<float> quatf[inputCount];
+    float angle[inputCount];
+    float value[inputCount];
+    int32_t counts[inputCount][3];
+    CRSF_Frame_t frame[inputCount];
+
+    Inputs() {
+        for (int i = 0; i < inputCount; i++) {
+            vec[i] = Vec3(input(i, 1) * 10, input(i, 2) * 10, input(i, 3) * 10);
+            quat[i] = Quaternion(QuaternionT<double>::fromEulerZYX(input(i, 4) * 3, input(i, 5) * 1.5, input(i, 6) * 3));
+            vecf[i] = vec[i].toVector3<float>();
+            quatf[i] = quat[i].toQuaternionT<float>();
+            angle[i] = input(i, 7) * 50;
+            value[i] = input(i, 8);
+            for (int axis = 0; axis < 3; axis++) {
+                counts[i][axis] = (int32_t) (input(i, 9 + axis) * 30000);
+            }
+            for (size_t b = 0; b < sizeof(frame[i].bytes); b++) {
+                frame[i].bytes[b] = (uint8_t) (input(i * 64 + b, 12) * 127 + 128);
+            }
+        }
+    }
+};
+
+Inputs& inputs() {
+    static Inputs in;
+    return in;
+}
+
+/**
+ * maths
+ */
+void quaternionRotate(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        Vec3 v = in.vec[i & inputMask];
+        in.quat[(i + 3) & inputMask].rotate(v);
+        benchmarkKeep(v);
+    }
+}
+
+void quaternionRotateReverse(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        Vec3 v = in.vec[i & inputMask];
+        in.quat[(i + 3) & inputMask].rotateReverse(v);
+        benchmarkKeep(v);
+    }
+}
+
+void quaternionToEulerZYX(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        EulerRotation e = in.quat[i & inputMask].toEulerZYX();
+        benchmarkKeep(e);
+    }
+}
+
+void quaternionIntegrateSecondOrder(uint32_t n) {
+    Inputs& in = inputs();
+    Quaternion q;
+    for (uint32_t i = 0; i < n; i++) {
+        q.integrateSecondOrder(in.vec[i & inputMask], 0.001);
+    }
+    benchmarkKeep(q);
+}
+
+void quaternionfRotate(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        Vector3<float> v = in.quatf[(i + 3) & inputMask].rotated(in.vecf[i & inputMask]);
+        benchmarkKeep(v);
+    }
+}
+
+void quaternionfToEulerZYX(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        Vector3<float> e = in.quatf[i & inputMask].toEulerZYX();
+        benchmarkKeep(e);
+    }
+}
+
+void matrix3Product(uint32_t n) {
+    Inputs& in = inputs();
+    Matrix3T<float> a = Matrix3T<float>::rotationZYX(in.value[0], in.value[1], in.value[2]);
+    Matrix3T<float> b = Matrix3T<float>::rotationZYX(in.value[3], in.value[4], in.value[5]);
+    for (uint32_t i = 0; i < n; i++) {
+        Matrix3T<float> c = a * b;
+        benchmarkKeep(c);
+        benchmarkKeep(a);
+    }
+}
+
+void matrix3RotationZYX(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        Matrix3T<float> m = Matrix3T<float>::rotationZYX(in.value[i & inputMask], in.value[(i + 1) & inputMask], in.value[(i + 2) & inputMask]);
+        benchmarkKeep(m);
+    }
+}
+
+/**
+ * Covariance propagation size of the error state EKF
+ */
+void matrix15Product(uint32_t n) {
+    Inputs& in = inputs();
+    static Matrix<15, 15> a, b, c;
+    for (int r = 0; r < 15; r++) {
+        for (int col = 0; col < 15; col++) {
+            a.m[r][col] = in.value[(r + col) & inputMask];
+            b.m[r][col] = in.value[(r * 3 + col) & inputMask];
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        c = a * b;
+        benchmarkKeep(c);
+        benchmarkKeep(a);
+    }
+}
+
+/**
+ * Baseline for the two above: plain triple loop over float arrays, no Matrix class
+ */
+void matrix15Naive(uint32_t n) {
+    Inputs& in = inputs();
+    static float a[15][15], b[15][15], c[15][15];
+    for (int r = 0; r < 15; r++) {
+        for (int col = 0; col < 15; col++) {
+            a[r][col] = in.value[(r + col) & inputMask];
+            b[r][col] = in.value[(r * 3 + col) & inputMask];
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        for (int r = 0; r < 15; r++) {
+            for (int col = 0; col < 15; col++) {
+                float sum = 0;
+                for (int k = 0; k < 15; k++) {
+                    sum += a[r][k] * b[k][col];
+                }
+                c[r][col] = sum;
+            }
+        }
+        benchmarkKeep(c);
+        benchmarkKeep(a);
+    }
+}
+
+void matrix15TimesTranspose(uint32_t n) {
+    Inputs& in = inputs();
+    static Matrix<15, 15> a, b, c;
+    for (int r = 0; r < 15; r++) {
+        for (int col = 0; col < 15; col++) {
+            a.m[r][col] = in.value[(r + col) & inputMask];
+            b.m[r][col] = in.value[(r * 3 + col) & inputMask];
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        c = a.timesTranspose(b);
+        benchmarkKeep(c);
+        benchmarkKeep(a);
+    }
+}
+
+/**
+ * Trig: FastMath against libm
+ */
+template<bool FAST>
+void trigAtan2(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        float r = Trig<FAST>::atan2(in.value[i & inputMask], in.value[(i + 5) & inputMask]);
+        benchmarkKeep(r);
+    }
+}
+
+template<bool FAST>
+void trigAsin(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        float r = Trig<FAST>::asin(in.value[i & inputMask]);
+        benchmarkKeep(r);
+    }
+}
+
+template<bool FAST>
+void trigSincos(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        float s, c;
+        Trig<FAST>::sincos(in.angle[i & inputMask], s, c);
+        benchmarkKeep(s);
+        benchmarkKeep(c);
+    }
+}
+
+template<bool FAST>
+void trigExp(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        float r = Trig<FAST>::exp(in.value[i & inputMask] * 10);
+        benchmarkKeep(r);
+    }
+}
+
+/**
+ * filters
+ */
+void lowPassUpdate(uint32_t n) {
+    Inputs& in = inputs();
+    static LowPassFilter lpf(100, 0.001f);
+    for (uint32_t i = 0; i < n; i++) {
+        float r = lpf.update(in.value[i & inputMask]);
+        benchmarkKeep(r);
+    }
+}
+
+void lowPassUpdateReconfigure(uint32_t n) {
+    Inputs& in = inputs();
+    static LowPassFilter lpf(100, 0.001f);
+    for (uint32_t i = 0; i < n; i++) {
+        float r = lpf.update(in.value[i & inputMask], 0.001f, 100);
+        benchmarkKeep(r);
+    }
+}
+
+void lowPassVec3Update(uint32_t n) {
+    Inputs& in = inputs();
+    static LowPassFilterVec3 lpf(100, 0.001f);
+    for (uint32_t i = 0; i < n; i++) {
+        Vec3 r = lpf.update(in.vec[i & inputMask]);
+        benchmarkKeep(r);
+    }
+}
+
+/**
+ * pid
+ */
+void pidCompute(uint32_t n) {
+    Inputs& in = inputs();
+    static PID pid(0.1f, 0.2f, 0.01f, 0.5f, 1.0f);
+    static uint64_t timeUs = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        timeUs += 1000;
+        float r = pid.compute(in.angle[i & inputMask], in.angle[(i + 7) & inputMask], PID::noGyro, timeUs);
+        benchmarkKeep(r);
+    }
+}
+
+/**
+ * crossfire
+ */
+void crossfireFrameToChanels(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        CRSF_TxChanels c = Crossfire::frameToChanels(in.frame[i & inputMask], 22);
+        benchmarkKeep(c);
+    }
+}
+
+void crossfireConvertChanels(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        CRSF_TxChanels chanels = Crossfire::frameToChanels(in.frame[i & inputMask], 22);
+        CRSF_TxChanels_Converted c = Crossfire::convertChanels(chanels);
+        benchmarkKeep(c);
+    }
+}
+
+/**
+ * Gyro counts to calibrated rate, float path as in the ICM-42688-P sensor against the fixed point path.
+ * LPF adds the 100 Hz low pass at 4 kHz to both
+ */
+template<bool LPF>
+void gyroFloatPath(uint32_t n) {
+    Inputs& in = inputs();
+    static GyroLowPass lpf;
+    lpf.configure(LPF ? 100 : 0, 4000);
+    const float scale = 2000.0f / 32768.0f;
+    const Vec3 offset(0.3, -1.2, 0.05);
+    const Vec3 gyroScale(1.01, 0.99, 1.0);
+    for (uint32_t i = 0; i < n; i++) {
+        const int32_t* counts = in.counts[i & inputMask];
+        Vec3 rate = (Vec3(counts[0] * scale, counts[1] * scale, -counts[2] * scale) - offset) * gyroScale;
+        if(LPF) rate = lpf.update(rate);
+        benchmarkKeep(rate);
+    }
+}
+
+template<bool LPF>
+void gyroFixedPath(uint32_t n) {
+    Inputs& in = inputs();
+    static GyroRateFixed gyro;
+    const int sign[3] = {1, 1, -1};
+    const float offset[3] = {0.3f, -1.2f, 0.05f};
+    const float gyroScale[3] = {1.01f, 0.99f, 1.0f};
+    gyro.configure(2000.0f / 32768.0f, sign, offset, gyroScale, GyroLowPass::factor(LPF ? 100 : 0, 4000));
+    for (uint32_t i = 0; i < n; i++) {
+        gyro.update(in.counts[i & inputMask]);
+        benchmarkKeep(gyro);
+    }
+}
+
+/**
+ * Stick to rate, exact curve against the compiled table
+ */
+void rateCurveEvaluate(uint32_t n) {
+    Inputs& in = inputs();
+    for (uint32_t i = 0; i < n; i++) {
+        float r = RateCurve::evaluate(in.value[i & inputMask], 1.0f, 0.7f, 0.3f);
+        benchmarkKeep(r);
+    }
+}
+
+void rateCurveRate(uint32_t n) {
+    Inputs& in = inputs();
+    static RateCurve curve;
+    curve.configure(1.0f, 0.7f, 0.3f);
+    for (uint32_t i = 0; i < n; i++) {
+        float r = curve.rate(in.value[i & inputMask]);
+        benchmarkKeep(r);
+    }
+}
+
+/**
+ * Mixer including saturation. Inputs are large enough to saturate part of the time
+ */
+void mixerMix(Mixer& mixer, uint32_t n) {
+    Inputs& in = inputs();
+    float out[Mixer::maxMotors];
+    for (uint32_t i = 0; i < n; i++) {
+        mixer.mix(in.value[i & inputMask] * 0.5f + 0.5f, in.value[(i + 1) & inputMask], in.value[(i + 2) & inputMask], in.value[(i + 3) & inputMask], out);
+        benchmarkKeep(out);
+    }
+}
+
+/**
+ * Input in 0 - 1
+ */
+void thrustCurveEvaluate(uint32_t n) {
+    Inputs& in = inputs();
+    MotorCalibration cal;
+    for (uint32_t i = 0; i < n; i++) {
+        float c = ThrustCurve::evaluate(in.value[i & inputMask] * 0.5f + 0.5f, 0.5f, cal);
+        benchmarkKeep(c);
+    }
+}
+
+void thrustCurveLookup(uint32_t n) {
+    Inputs& in = inputs();
+    static ThrustCurve curve;
+    curve.compile(0.5f, MotorCalibration());
+    for (uint32_t i = 0; i < n; i++) {
+        float c = curve.lookup(in.value[i & inputMask] * 0.5f + 0.5f);
+        benchmarkKeep(c);
+    }
+}
+
+/**
+ * One loop of rc smoothing at 4 kHz with a new 150 Hz frame every 27th loop
+ */
+void rcSmoothingUpdate(uint32_t n) {
+    Inputs& in = inputs();
+    static RcSmoothing smoothing;
+    float out[RcSmoothing::MAX_CHANELS];
+    for (uint32_t i = 0; i < n; i++) {
+        if(i % 27 == 0) {
+            smoothing.newFrame(&in.value[i & (inputMask - 3)], 6667, 700);
+        }
+        smoothing.update(0.00025f, out);
+        benchmarkKeep(out);
+    }
+}
+
+void mixerQuadX(uint32_t n) {
+    static Mixer mixer = Mixer::quadX();
+    mixerMix(mixer, n);
+}
+
+void mixerOctoX(uint32_t n) {
+    static Mixer mixer = Mixer::octoX();
+    mixerMix(mixer, n);
+}
+
+/**
+ * Sensor fusion. Sensors without hardware behind them, fed with a 4 kHz gyro and a resting accelerometer
+ */
+class BenchmarkSensors : public SensorInterface {
+public:
+    uint64_t time = 0;
+
+    BenchmarkSensors(bool withMag = false) {
+        useMag = withMag;
+    }
+
+    /**
+     * Next gyro sample, accelerometer only if withAcc. With useMag every 40th call brings a 100 Hz magnetometer sample
+     */
+    void step(uint32_t i, bool withAcc) {
+        Inputs& in = inputs();
+        time += 250;
+        const Vec3& g = in.vec[i & inputMask];
+        gyro.update(g.x, g.y, g.z, time);
+        float v = in.value[i & inputMask] * 0.05f;
+        if(withAcc) {
+            acc.update(v, -v, 1.0f + v, time);
+        }
+        if(useMag && i % 40 == 0) {
+            mag.update(0.4f + v, 0.1f - v, -0.3f, time);
+        }
+    }
+
+    void begin() {}
+    void handle() {}
+    void setAccCal(Vec3, Vec3) {}
+    void setGyroCal(Vec3, Vec3) {}
+    void setMagCal(Vec3, Vec3) {}
+    void calibrateAcc() {}
+    void calibrateGyroOffset() {}
+    void calibrateGyroScale() {}
+    void calibrateMag() {}
+    Vec3 getAccOffset() { return Vec3(); }
+    Vec3 getAccScale() { return Vec3(1, 1, 1); }
+    Vec3 getGyroOffset() { return Vec3(); }
+    Vec3 getGyroScale() { return Vec3(1, 1, 1); }
+    Vec3 getMagOffset() { return Vec3(); }
+    Vec3 getMagScale() { return Vec3(1, 1, 1); }
+    void calibrateBat(float) {}
+};
+
+/**
+ * One gyro and accelerometer sample per call. Timing includes feeding the sensors
+ */
+template<class Fusion, bool MAG = false>
+void fusionHandle(uint32_t n) {
+    static BenchmarkSensors sensors(MAG);
+    static Fusion fusion(&sensors);
+    for (uint32_t i = 0; i < n; i++) {
+        sensors.step(i, true);
+        fusion.handle();
+    }
+    benchmarkKeep(fusion.getAttitude());
+}
+
+/**
+ * Gyro only: EKF prediction without measurement update
+ */
+void ekfPredict(uint32_t n) {
+    static BenchmarkSensors sensors;
+    static ErrorStateEKF ekf(&sensors);
+    for (uint32_t i = 0; i < n; i++) {
+        sensors.step(i, false);
+        ekf.handle();
+    }
+    benchmarkKeep(ekf.getAttitude());
+}
+
+/**
+ * A full FIFO of packet 3 (16 bit) or packet 4 (20 bit) frames as the burst read delivers it
+ */
+struct FifoBuffer {
+    uint8_t data[ICM42688::FIFO_SIZE];
+    size_t length = 0;
+
+    FifoBuffer(bool hires) {
+        size_t size = hires ? ICM42688::PACKET_SIZE_20 : ICM42688::PACKET_SIZE_16;
+        for (int i = 0; length + size <= ICM42688::FIFO_SIZE; i++) {
+            uint8_t* packet = data + length;
+            packet[0] = hires ? 0x78 : 0x68; // accel, gyro, timestamp (and 20 bit)
+            for (int j = 1; j < 13; j++) {
+                packet[j] = (uint8_t) (input(i, j) * 127); // never 0x80 0x00, which marks an invalid sample
+            }
+            packet[13] = 0x10;
+            uint16_t timestamp = i * 31;
+            packet[hires ? 15 : 14] = timestamp >> 8;
+            packet[hires ? 16 : 15] = timestamp & 0xFF;
+            if(hires) {
+                packet[14] = 0x20;
+                packet[17] = 0x5A;
+                packet[18] = 0xA5;
+                packet[19] = 0x3C;
+            }
+            length += size;
+        }
+    }
+};
+
+/**
+ * One call decodes a full 2 kB FIFO in 16 bit and one in 20 bit mode (128 + 102 samples)
+ */
+void icmDecodeFifo(uint32_t n) {
+    static const FifoBuffer fifo16(false);
+    static const FifoBuffer fifo20(true);
+    static ICM42688::FifoSample samples[ICM42688::MAX_FIFO_SAMPLES];
+    for (uint32_t i = 0; i < n; i++) {
+        size_t count = ICM42688::decodeFifo(fifo16.data, fifo16.length, samples, ICM42688::MAX_FIFO_SAMPLES);
+        benchmarkKeep(samples[count - 1]);
+        count = ICM42688::decodeFifo(fifo20.data, fifo20.length, samples, ICM42688::MAX_FIFO_SAMPLES);
+        benchmarkKeep(samples[count - 1]);
+    }
+}
+
+} // namespace
+
+const Benchmark benchmarks[] = {
+    {"maths", "Quaternion::rotate",                 quaternionRotate},
+    {"maths", "Quaternion::rotateReverse",          quaternionRotateReverse},
+    {"maths", "Quaternion::toEulerZYX",             quaternionToEulerZYX},
+    {"maths", "Quaternion::integrateSecondOrder",   quaternionIntegrateSecondOrder},
+    {"maths", "Quaternionf::rotate",                quaternionfRotate},
+    {"maths", "Quaternionf::toEulerZYX",            quaternionfToEulerZYX},
+    {"maths", "Matrix3f::operator*",                matrix3Product},
+    {"maths", "Matrix3f::rotationZYX",              matrix3RotationZYX},
+    {"maths", "Matrix15f::operator*",               matrix15Product},
+    {"maths", "Matrix15f::timesTranspose",          matrix15TimesTranspose},
+    {"maths", "naive 15x15 float loop",             matrix15Naive},
+    {"trig",  "FastMath::atan2",                    trigAtan2<true>},
+    {"trig",  "atan2f",                             trigAtan2<false>},
+    {"trig",  "FastMath::asin",                     trigAsin<true>},
+    {"trig",  "asinf",                              trigAsin<false>},
+    {"trig",  "FastMath::sincos",                   trigSincos<true>},
+    {"trig",  "sinf+cosf",                          trigSincos<false>},
+    {"trig",  "FastMath::exp",                      trigExp<true>},
+    {"trig",  "expf",                               trigExp<false>},
+    {"filters", "LowPassFilter::update",            lowPassUpdate},
+    {"filters", "LowPassFilter::update(dt,fc)",     lowPassUpdateReconfigure},
+    {"filters", "LowPassFilterVec3::update",        lowPassVec3Update},
+    {"pid",   "PID::compute",                       pidCompute},
+    {"crossfire", "Crossfire::frameToChanels",      crossfireFrameToChanels},
+    {"crossfire", "Crossfire::convertChanels",      crossfireConvertChanels},
+    {"gyro",  "float counts to rate",               gyroFloatPath<false>},
+    {"gyro",  "GyroRateFixed::update",              gyroFixedPath<false>},
+    {"gyro",  "float counts to rate + lpf",         gyroFloatPath<true>},
+    {"gyro",  "GyroRateFixed::update + lpf",        gyroFixedPath<true>},
+    {"fc",    "RateCurve::evaluate",                rateCurveEvaluate},
+    {"fc",    "RateCurve::rate",                    rateCurveRate},
+    {"fc",    "Mixer::mix quadX",                   mixerQuadX},
+    {"fc",    "Mixer::mix octoX",                   mixerOctoX},
+    {"fc",    "ThrustCurve::evaluate",              thrustCurveEvaluate},
+    {"fc",    "ThrustCurve::lookup",                thrustCurveLookup},
+    {"fc",    "RcSmoothing::update",                rcSmoothingUpdate},
+    {"imu",   "ComplementaryFilter::handle",        fusionHandle<ComplementaryFilter>},
+    {"imu",   "MagdwickFilter::handle",             fusionHandle<MagdwickFilter>},
+    {"imu",   "MahonyFilter::handle",               fusionHandle<MahonyFilter>},
+    {"imu",   "ComplementaryFilter::handle +mag",   fusionHandle<ComplementaryFilter, true>},
+    {"imu",   "MahonyFilter::handle +mag",          fusionHandle<MahonyFilter, true>},
+    {"imu",   "ErrorStateEKF::handle predict",      ekfPredict},
+    {"imu",   "ErrorStateEKF::handle predict+acc",  fusionHandle<ErrorStateEKF>},
+    {"imu",   "ICM42688::decodeFifo 16/20 bit",     icmDecodeFifo},
+};
+
+const int benchmarkCount = sizeof(benchmarks) / sizeof(benchmarks[0]);
@@ -0,0 +1,20 @@
+/**
+ * @file benchmarks.h
+ * @author Timo Lehnertz
+ * @brief Benchmark definitions shared by all runners
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include "benchmark.h"
+
+extern const Benchmark benchmarks[];
+extern const int benchmarkCount;
+
+/**
+ * Describes the build in the runner line, for example "FAST_MATH=1"
+ */
+extern const char* benchmarkBuild;
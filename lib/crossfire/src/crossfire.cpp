@@ -61,9 +61,19 @@ bool Crossfire::isFailsafe() {
 }
 
 void Crossfire::handleCrsfFrame(CRSF_Frame_t& frame, int payloadLength) {
-    lastRcFrame = micros();
+    timeUs_t now = micros();
+    if(firstFrameReceived) {
+        timeDelta_t interval = cmpTimeUs(now, lastRcFrame);
+        if(interval > CRSF_FRAME_INTERVAL_MIN_US && interval < CRSF_FRAME_INTERVAL_MAX_US) { // lost links are no intervals
+            frameIntervalUs += (interval - frameIntervalUs) * CRSF_TIMING_LPF;
+        }
+    }
+    frameLatencyUs += (cmpTimeUs(now, crsfFrameStartAtUs) - frameLatencyUs) * CRSF_TIMING_LPF;
+    lastRcFrame = now;
     firstFrameReceived = true;
+    rcFrameCount++;
     chanels = frameToChanels(frame, payloadLength);
+    chanelsConverted = convertChanels(chanels);
 
     #ifdef CRSF_DEBUG //print out each frame
     Serial.print("received frame of type: "); Serial.print(frame.frame.type);
@@ -354,34 +364,25 @@ CRSF_TxChanels Crossfire::getChanels() {
 }
 
 CRSF_TxChanels_Converted Crossfire::getChanelsCoverted() {
+    return chanelsConverted;
+}
+
+CRSF_TxChanels_Converted Crossfire::convertChanels(const CRSF_TxChanels& chanels) {
+    const float scale = 1.0f / (CRSF_CHANEL_MAX - CRSF_CHANEL_MIN);
+    const float scale2 = 2.0f * scale;
     CRSF_TxChanels_Converted conv;
-    if(!firstFrameReceived) { //default values
-        conv.roll     = 0;
-        conv.pitch    = 0;
-        conv.throttle = 0;
-        conv.yaw      = 0;
-        conv.aux1     = 0;
-        conv.aux2     = 0;
-        conv.aux3     = 0;
-        conv.aux4     = 0;
-        conv.aux5     = 0;
-        conv.aux6     = 0;
-        conv.aux7     = 0;
-        conv.aux8     = 0;
-    } else {
-        conv.roll     = map(chanels.labels.roll, 172.0, 1809.0, -1.0, 1.0);
-        conv.pitch    = map(chanels.labels.pitch, 172.0, 1809.0, -1.0, 1.0);
-        conv.throttle = map(chanels.labels.throttle, 172.0, 1809.0, 0.0, 1.0);
-        conv.yaw      = map(chanels.labels.yaw,  172.0, 1809.0, -1.0, 1.0);
-        conv.aux1     = map(chanels.labels.aux1, 172.0, 1809.0, -1.0, 1.0);
-        conv.aux2     = map(chanels.labels.aux2, 172.0, 1809.0, -1.0, 1.0);
-        conv.aux3     = map(chanels.labels.aux3, 172.0, 1809.0, -1.0, 1.0);
-        conv.aux4     = map(chanels.labels.aux4, 172.0, 1809.0, -1.0, 1.0);
-        conv.aux5     = map(chanels.labels.aux5, 172.0, 1809.0, -1.0, 1.0);
-        conv.aux6     = map(chanels.labels.aux6, 172.0, 1809.0, -1.0, 1.0);
-        conv.aux7     = map(chanels.labels.aux7, 172.0, 1809.0, -1.0, 1.0);
-        conv.aux8     = map(chanels.labels.aux8, 172.0, 1809.0, -1.0, 1.0);
-    }
+    conv.roll     = (chanels.labels.roll     - CRSF_CHANEL_MIN) * scale2 - 1.0f;
+    conv.pitch    = (chanels.labels.pitch    - CRSF_CHANEL_MIN) * scale2 - 1.0f;
+    conv.throttle = (chanels.labels.throttle - CRSF_CHANEL_MIN) * scale;
+    conv.yaw      = (chanels.labels.yaw      - CRSF_CHANEL_MIN) * scale2 - 1.0f;
+    conv.aux1     = (chanels.labels.aux1     - CRSF_CHANEL_MIN) * scale2 - 1.0f;
+    conv.aux2     = (chanels.labels.aux2     - CRSF_CHANEL_MIN) * scale2 - 1.0f;
+    conv.aux3     = (chanels.labels.aux3     - CRSF_CHANEL_MIN) * scale2 - 1.0f;
+    conv.aux4     = (chanels.labels.aux4     - CRSF_CHANEL_MIN) * scale2 - 1.0f;
+    conv.aux5     = (chanels.labels.aux5     - CRSF_CHANEL_MIN) * scale2 - 1.0f;
+    conv.aux6     = (chanels.labels.aux6     - CRSF_CHANEL_MIN) * scale2 - 1.0f;
+    conv.aux7     = (chanels.labels.aux7     - CRSF_CHANEL_MIN) * scale2 - 1.0f;
+    conv.aux8     = (chanels.labels.aux8     - CRSF_CHANEL_MIN) * scale2 - 1.0f;
     return conv;
 }
 
@@ -61,6 +61,13 @@ typedef int32_t timeDelta_t;
 
 #define CRSF_FAILSAFE_TIMEOUT_US 1000000 //1sek
 
+#define CRSF_CHANEL_MIN 172.0f
+#define CRSF_CHANEL_MAX 1809.0f
+
+#define CRSF_FRAME_INTERVAL_MIN_US  1000  // 1000 Hz
+#define CRSF_FRAME_INTERVAL_MAX_US  50000 // 20 Hz
+#define CRSF_TIMING_LPF             0.05f // frame interval and latency averaging per frame
+
 static inline timeDelta_t cmpTimeUs(timeUs_t a, timeUs_t b) { return (timeDelta_t)(a - b); }
 
 struct CRSF_TxChanels_Labels {
@@ -123,9 +130,16 @@ public:
     void handle();
     void end();
 
-    CRSF_TxChanels_Converted getChanelsCoverted();
+    CRSF_TxChanels_Converted getChanelsCoverted(); // converted once per frame
     CRSF_TxChanels getChanels();
 
+    /**
+     * Frame timing
+     **/
+    uint32_t getRcFrameCount() { return rcFrameCount; } // changes with every received RC frame
+    float getFrameIntervalUs() { return frameIntervalUs; } // averaged time between RC frames
+    float getFrameLatencyUs() { return frameLatencyUs; } // averaged time from the first byte of a frame until it is decoded
+
     /**
      * Failsafe
      **/
@@ -143,6 +157,16 @@ public:
     void updateTelemetryBattery(float vBat, float batCurrent, uint32_t mahDraw, int remainingPercent);
     
     double map(double x, double in_min, double in_max, double out_min, double out_max);
+
+    /**
+     * Unpacks the 11 bit chanels of an RC frame. Pure function, public for benchmarks
+     */
+    static CRSF_TxChanels frameToChanels(CRSF_Frame_t& frame, int payloadLength);
+
+    /**
+     * Sticks and aux to -1 - 1, throttle to 0 - 1. Pure function, public for benchmarks
+     */
+    static CRSF_TxChanels_Converted convertChanels(const CRSF_TxChanels& chanels);
 private:
     HardwareSerial* uart;
     CRSF_Frame_t crsfFrame;
@@ -156,9 +180,6 @@ private:
 
     void handleCrsfFrame(CRSF_Frame_t&, int);
 
-    CRSF_TxChanels frameToChanels(CRSF_Frame_t& frame, int payloadLength);
-
-
 
     void writeU32BigEndian(uint8_t *dst, uint32_t val);
     void writeU16BigEndian(uint8_t *dst, uint16_t val);
@@ -171,6 +192,11 @@ private:
      **/
     timeUs_t lastRcFrame = 0;
 
+    CRSF_TxChanels_Converted chanelsConverted = {};
+    uint32_t rcFrameCount = 0;
+    float frameIntervalUs = CRSF_TIME_BETWEEN_FRAMES_US;
+    float frameLatencyUs = 0;
+
     bool rcConnected = false;
     uint64_t rcConnectedTime = 0;
 
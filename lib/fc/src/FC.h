@@ -16,6 +16,11 @@
 #include "../../pid/pid.h"
 #include "flightModes.h"
 #include "error.h"
+#include "rateCurve.h"
+#include "mixer.h"
+#include "thrustCurve.h"
+#include "rcSmoothing.h"
+#include <fastMath.h>
 #include <DShot.h>
 // #include <DMAChannel.h>
 
@@ -87,6 +92,15 @@
 #define LAUNCH_I_BOOST_LEVEL        5// multiplies the i term from level pids
 #define LAUNCH_I_BOOST_ALTITUDE     1// multiplies the i term from altitude pid
 
+#define THRUST_LINEARIZATION        0.0// 0 = linear, see ThrustCurve
+
+#define RC_SMOOTHING_FACTOR         0.25// rc smoothing cutoff as a fraction of the frame rate
+
+#define FEEDFORWARD_GAIN_RP         0.00001// output per deg/s^2 of setpoint change
+#define FEEDFORWARD_GAIN_Y          0.0
+#define FEEDFORWARD_STATIC          0.0// output per deg/s of setpoint
+#define FEEDFORWARD_DEADBAND        2.0// deg/s of setpoint jitter ignored by the derivative
+
 #define RATE_RC                     1.0
 #define RATE_SUPER                  0.7
 #define RATE_RC_EXPO                0.0
@@ -162,6 +176,19 @@ public:
     double throttleMul4S = 1.0;
     double throttleMul6S = 1.0;
 
+    /**
+     * Rate loop feedforward per axis, roll pitch yaw
+     */
+    Vec3 feedforwardGain = Vec3(FEEDFORWARD_GAIN_RP, FEEDFORWARD_GAIN_RP, FEEDFORWARD_GAIN_Y);
+    Vec3 feedforwardStatic = Vec3(FEEDFORWARD_STATIC, FEEDFORWARD_STATIC, FEEDFORWARD_STATIC);
+    float feedforwardDeadband = FEEDFORWARD_DEADBAND;
+
+    bool useRcSmoothing = true; // loop rate smoothing of roll, pitch, yaw and throttle
+    RcSmoothing rcSmoothing;
+
+    float thrustLinearization = THRUST_LINEARIZATION; // call compileThrustCurves() after changing
+    MotorCalibration motorCalibrations[Mixer::maxMotors]; // call compileThrustCurves() after changing
+
     boolean levelInfluencingRate = false;
 
     INS* ins;
@@ -195,11 +222,17 @@ public:
     float maxGForce = 1.0f;
 
     Quaternion gyroRot;
+    DeltaAngleAccumulator gyroDeltaAngle;
     Quaternion pilotRot;
 
     uint64_t lastLoop = 0;
+    uint32_t sampleAgeUs = 0; // age of the gyro sample when its motor command got written
 
-    FC(INS* ins, Motor* mFL, Motor* mFR, Motor* mBL, Motor* mBR, Crossfire* crsf) :
+    /**
+     * @param motors in the order of the mixer table
+     * @param motorCount up to Mixer::maxMotors
+     */
+    FC(INS* ins, Motor** motors, int motorCount, Crossfire* crsf) :
         ins(ins),
         rateRollPID     (RATE_PID_RP,       RATE_PID_RI,    RATE_PID_RD,    RATE_PID_RD_LPF,    RATE_PID_R_MAX),
         ratePitchPID    (RATE_PID_PP,       RATE_PID_PI,    RATE_PID_PD,    RATE_PID_PD_LPF,    RATE_PID_P_MAX),
@@ -212,7 +245,16 @@ public:
         velPIDy         (VEL_PID_P,         VEL_PID_I,      VEL_PID_D,      VEL_PID_D_LPF,      VEL_PID_MAX),
         crsf(crsf),
         gyroRot(), pilotRot(),
-        mFL(mFL), mFR(mFR), mBL(mBL), mBR(mBR) {}
+        motorCount(motorCount < Mixer::maxMotors ? motorCount : Mixer::maxMotors) {
+        for (int i = 0; i < this->motorCount; i++) {
+            this->motors[i] = motors[i];
+        }
+        mixer = defaultMixer(this->motorCount);
+        rcSmoothing.setRange(3, 0, 1); // throttle
+        rcSmoothing.setCutoffFactor(RC_SMOOTHING_FACTOR);
+        compileRates();
+        compileThrustCurves();
+    }
 
     void begin() {
         
@@ -244,8 +286,7 @@ public:
 
         // Headfree
         if(chanels.aux3 < -0.5) {
-            EulerRotation yawRot = EulerRotation(0, 0, ins->getYaw());
-            yawRot.rotateReverse(rightStick);
+            ins->rotateYawReverse(rightStick);
             // if(millis() % 100 == 0) {
             //     rightStick.println();
             // }
@@ -254,39 +295,41 @@ public:
         /**
          * save desired states
          */
-        float desYawRate = stickToRate(chanels.yaw, yawRate.getRC(), yawRate.getSuper(), yawRate.getRCExpo());
+        float desYawRate = pilotRate.z;
         float throttle = chanels.throttle;
         float desRollAngle = rightStick.x * angleModeMaxAngle;
         float desPitchAngle = rightStick.y * angleModeMaxAngle;
 
         Vec3 velLocalDes = Vec3(map(chanels.pitch, -1, 1, -gpsMaxSpeedHorizontal, gpsMaxSpeedHorizontal), map(chanels.roll, -1, 1, -gpsMaxSpeedHorizontal, gpsMaxSpeedHorizontal), map(throttle, 0.0, 1.0, -gpsMaxSpeedVertical, gpsMaxSpeedVertical));
         Vec3 velGlobalDes = velLocalDes.clone();
-        ins->getQuaternionRotation().rotateZ(velGlobalDes);//rotate from local to Global
+        const SensorFusion::AttitudeCache& attitude = ins->getAttitudeCache();
+        Quaternion::rotateZ(velGlobalDes, attitude.sinYaw, attitude.cosYaw);//rotate from local to Global
+
+        // Gyro sample timing. Integration and rate PIDs use the time between gyro samples instead of loop time
+        uint64_t gyroSampleUs = ins->sensors->gyro.lastChange;
 
         // Quaternion stuff
-        // Gyro Rotation
-        Vec3 gyro = ins->sensors->gyro.getVec3();
-        gyro.x *= -1; //align with sticks
-        EulerRotation localGyroRotEuler((gyro * elapsedS).toRad(), ZYX_EULER);
-        Quaternion localGyroRotQ(localGyroRotEuler);
-        gyroRot *= localGyroRotQ;
-        gyroRot.normalize();
+        // Gyro Rotation. All samples since the last loop with coning correction
+        Vec3f gyroRotation;
+        float gyroRotationS;
+        gyroDeltaAngle.collect(ins->sensors->gyro.history);
+        if(gyroDeltaAngle.get(gyroRotation, gyroRotationS)) {
+            DeltaAngleAccumulator::rotate(gyroRot, gyroRotation);
+        }
 
         // Pilot Rotation
-        Vec3 pilot = pilotRateFromChanels(chanels);
+        Vec3 pilot = pilotRate.clone();
         pilot.y *= -1;
         pilot *= -1;
-        EulerRotation localPilotRotEuler((pilot * elapsedS).toRad(), ZYX_EULER);
-        Quaternion localPilotRotQ(localPilotRotEuler);
-        pilotRot *= localPilotRotQ;
-        pilotRot.normalize();
+        pilotRot.integrateSecondOrder(pilot.toRad(), elapsedS);
 
         switch(flightMode) {
             // case FlightMode::wayPoint: {
             //     Vec3 vecToPoint = wayPoint - ins->getLocation();
             //     double yaw = ins->getYaw();
 
-            //     double desYaw = angleFromCoordinate(ins->sensors->gps.lat, ins->sensors->gps.lng, ins->complementaryFilter.centerLat, ins->complementaryFilter.centerLng);
+            //     float desYaw;
+            //     ins->complementaryFilter.origin.toOrigin(ins->sensors->gps.lat, ins->sensors->gps.lng, desYaw);
 
             //     // adjust altitude if no pilot input
             //     if(chanels.throttle > 0.1 && chanels.throttle < 0.9) {
@@ -324,17 +367,16 @@ public:
                 }
             }
             case FlightMode::level: {
-                rollRateAdjust  = levelRollPID.compute(-ins->getRoll() * RAD_TO_DEG, desRollAngle, ins->getRollRate());
-                pitchRateAdjust = levelPitchPID.compute(-ins->getPitch() * RAD_TO_DEG, desPitchAngle, ins->getPitchRate());
-                yawRateAdjust   = rateYawPID.compute(ins->getYawRate(), desYawRate);
+                rollRateAdjust  = levelRollPID.compute(-ins->getRoll() * RAD_TO_DEG, desRollAngle, ins->getRollRate(), gyroSampleUs);
+                pitchRateAdjust = levelPitchPID.compute(-ins->getPitch() * RAD_TO_DEG, desPitchAngle, ins->getPitchRate(), gyroSampleUs);
+                yawRateAdjust   = rateYawPID.compute(ins->getYawRate(), desYawRate, PID::noGyro, gyroSampleUs);
                 break;
             }
             case FlightMode::turtle: {
                 // Serial.println(-chanels.roll - chanels.pitch);
-                mFL->write(-chanels.roll - chanels.pitch);
-                mFR->write(+chanels.roll - chanels.pitch);
-                mBL->write(-chanels.roll + chanels.pitch);
-                mBR->write(+chanels.roll + chanels.pitch);
+                for (int i = 0; i < motorCount; i++) {
+                    motors[i]->write(mixer.turtle(i, chanels.roll, chanels.pitch));
+                }
                 break;
             }
             case FlightMode::rate: {
@@ -359,11 +401,16 @@ public:
                 // rateRollPID.integrator  = levelRollPID.compute (euler.getRoll()  * RAD_TO_DEG, 0, ins->getRollRate())  * levelInfluence + rateRollPID.integrator * (1 - levelInfluence);
                 // ratePitchPID.integrator = levelPitchPID.compute(euler.getPitch() * RAD_TO_DEG, 0, ins->getPitchRate()) * levelInfluence + rateRollPID.integrator * (1 - levelInfluence);
 
-                desRollRate  = stickToRate(rightStick.x,  rollRate.getRC(),  rollRate.getSuper(),  rollRate.getRCExpo());
-                desPitchRate = stickToRate(rightStick.y, pitchRate.getRC(), pitchRate.getSuper(), pitchRate.getRCExpo());
-                rollRateAdjust  = rateRollPID.compute (ins->getRollRate(),  desRollRate) ;// * (1 - levelInfluence);
-                pitchRateAdjust = ratePitchPID.compute(ins->getPitchRate(), desPitchRate);// * (1 - levelInfluence);
-                yawRateAdjust   = rateYawPID.compute  (ins->getYawRate(),   desYawRate);
+                if(chanels.aux3 < -0.5) { // headfree rotated the sticks
+                    desRollRate  = rollCurve.rate(rightStick.x);
+                    desPitchRate = pitchCurve.rate(rightStick.y);
+                } else {
+                    desRollRate  = pilotRate.x;
+                    desPitchRate = pilotRate.y;
+                }
+                rollRateAdjust  = rateRollPID.compute (pidGyroRate(0),  desRollRate,  PID::noGyro, gyroSampleUs, feedforward(0, desRollRate));// * (1 - levelInfluence);
+                pitchRateAdjust = ratePitchPID.compute(pidGyroRate(1), desPitchRate, PID::noGyro, gyroSampleUs, feedforward(1, desPitchRate));// * (1 - levelInfluence);
+                yawRateAdjust   = rateYawPID.compute  (pidGyroRate(2),   desYawRate,   PID::noGyro, gyroSampleUs, feedforward(2, desYawRate));
 
                 
 
@@ -381,10 +428,10 @@ public:
             controllMotors(throttle, rollRateAdjust, pitchRateAdjust, yawRateAdjust);
         }
 
-        mFL->handle();
-        mFR->handle();
-        mBL->handle();
-        mBR->handle();
+        for (int i = 0; i < motorCount; i++) {
+            motors[i]->handle();
+        }
+        sampleAgeUs = micros() - gyroSampleUs;
 
         lastDesYawRate = desYawRate;
     }
@@ -423,31 +470,45 @@ public:
     /**
      * @brief Set the digital Motor Pin
      * 
-     * @param motor Motor from 1 to 4
+     * @param motor Motor from 1 to motorCount
      * @param pin digital pin
      */
     void setMotorPin(int motor, int pin) {
-        switch(motor) {
-            case 1: mFL->setPin(pin); break;
-            case 2: mFR->setPin(pin); break;
-            case 3: mBL->setPin(pin); break;
-            case 4: mBR->setPin(pin); break;
-        }
+        if(motor < 1 || motor > motorCount) return;
+        motors[motor - 1]->setPin(pin);
     }
 
     /**
      * @brief Get the digital Motor Pin
      * 
-     * @param motor Motor from 1 to 4
+     * @param motor Motor from 1 to motorCount
      */
     int getMotorPin(int motor) {
-        switch(motor) {
-            case 1: return mFL->getPin();
-            case 2: return mFR->getPin();
-            case 3: return mBL->getPin();
-            case 4: return mBR->getPin();
-            default: return -1;
-        }
+        if(motor < 1 || motor > motorCount) return -1;
+        return motors[motor - 1]->getPin();
+    }
+
+    /**
+     * @brief Replaces the mixer table
+     * 
+     * Ignored while armed, for invalid tables and for tables whose motor count differs from the wired motors
+     * 
+     * @return true if applied
+     */
+    bool setMixer(const Mixer& mixer) {
+        if(isArmed()) return false;
+        if(!mixer.isValid()) return false;
+        if(mixer.motorCount != motorCount) return false;
+        this->mixer = mixer;
+        return true;
+    }
+
+    const Mixer& getMixer() {
+        return mixer;
+    }
+
+    int getMotorCount() {
+        return motorCount;
     }
 
     /**
@@ -456,10 +517,9 @@ public:
     void arm() {
         armTime = millis();
         reset();
-        mFL->arm();
-        mFR->arm();
-        mBL->arm();
-        mBR->arm();
+        for (int i = 0; i < motorCount; i++) {
+            motors[i]->arm();
+        }
         armed = true;
         autoLiftoff = false;
         launched = false;
@@ -472,10 +532,9 @@ public:
      */
     void disarm() {
         if(isArmed()) {
-            mFL->disarm();
-            mFR->disarm();
-            mBL->disarm();
-            mBR->disarm();
+            for (int i = 0; i < motorCount; i++) {
+                motors[i]->disarm();
+            }
             armed = false;
             autoLiftoff = false;
             lastDisarmMs = millis();
@@ -503,7 +562,10 @@ public:
      * @return false if no motor is armed
      */
     bool isArmed() {
-        return mFL->isArmed() || mFR->isArmed() || mBL->isArmed() || mBR->isArmed();
+        for (int i = 0; i < motorCount; i++) {
+            if(motors[i]->isArmed()) return true;
+        }
+        return false;
     }
 
     /**
@@ -513,14 +575,119 @@ public:
      * @param chanelsRaw 
      */
     void updateRcChanels(CRSF_TxChanels_Converted& chanels, CRSF_TxChanels& chanelsRaw) {
+        uint32_t now = micros();
+        float dt = (now - lastRcUpdate) / 1000000.0f;
+        lastRcUpdate = now;
+        uint32_t frameCount = crsf->getRcFrameCount();
+        bool newFrame = frameCount != rcFrameCount;
+        rcFrameCount = frameCount;
         this->chanels = chanels;
         this->chanelsRaw = chanelsRaw;
+
+        if(!useRcSmoothing) {
+            rcSmoothingActive = false;
+            if(newFrame || pilotRateDirty) {
+                pilotRate = Vec3(rollCurve.rate(chanels.roll), pitchCurve.rate(chanels.pitch), yawCurve.rate(chanels.yaw));
+                pilotRateDirty = false;
+            }
+            return;
+        }
+
+        // Smoothing. Roll, pitch, yaw and throttle follow the frames at loop rate, setpoints are recomputed every loop
+        if(!rcSmoothingActive) {
+            rcSmoothing.reset();
+            newFrame = true;
+            rcSmoothingActive = true;
+        }
+        if(newFrame) {
+            float sample[RcSmoothing::MAX_CHANELS] = {chanels.roll, chanels.pitch, chanels.yaw, chanels.throttle};
+            rcSmoothing.newFrame(sample, crsf->getFrameIntervalUs(), crsf->getFrameLatencyUs());
+        }
+        float smoothed[RcSmoothing::MAX_CHANELS];
+        rcSmoothing.update(dt, smoothed);
+        this->chanels.roll     = smoothed[0];
+        this->chanels.pitch    = smoothed[1];
+        this->chanels.yaw      = smoothed[2];
+        this->chanels.throttle = smoothed[3];
+        pilotRate = Vec3(rollCurve.rate(smoothed[0]), pitchCurve.rate(smoothed[1]), yawCurve.rate(smoothed[2]));
+    }
+
+    /**
+     * Applies rollRate, pitchRate and yawRate to the rate curves. Has to be called after changing them
+     */
+    void compileRates() {
+        rollCurve.configure (rollRate.getRC(),  rollRate.getSuper(),  rollRate.getRCExpo());
+        pitchCurve.configure(pitchRate.getRC(), pitchRate.getSuper(), pitchRate.getRCExpo());
+        yawCurve.configure  (yawRate.getRC(),   yawRate.getSuper(),   yawRate.getRCExpo());
+        pilotRateDirty = true;
+    }
+
+    /**
+     * Rebuilds the per motor thrust curves from thrustLinearization and motorCalibrations. Has to be called after changing them
+     */
+    void compileThrustCurves() {
+        for (int i = 0; i < Mixer::maxMotors; i++) {
+            thrustCurves[i].compile(thrustLinearization, motorCalibrations[i]);
+        }
     }
 
 private:
     float desRollRate = 0;
     float desPitchRate = 0;
 
+    RateCurve rollCurve;
+    RateCurve pitchCurve;
+    RateCurve yawCurve;
+    Vec3 pilotRate; // deg/s from the sticks. Updated once per new RC frame or every loop with rc smoothing
+    bool pilotRateDirty = true;
+
+    uint32_t rcFrameCount = 0;
+    uint32_t lastRcUpdate = 0;
+    bool rcSmoothingActive = false;
+
+    float feedforwardSetpoint[3] = {0, 0, 0}; // setpoint with the jitter deadband applied
+    uint32_t feedforwardLastUs[3] = {0, 0, 0};
+    bool feedforwardSeeded[3] = {false, false, false};
+
+    /**
+     * @brief Rate loop feedforward, gain * setpoint derivative + static * setpoint
+     * 
+     * The derivative is taken from a copy of the setpoint that only follows once it moved more than feedforwardDeadband away,
+     * so RC jitter does not reach the motors. Meant for the smoothed setpoints, unsmoothed frames give one spike per frame.
+     * 
+     * dt is the time since the last call for this axis. The first call after resetFeedforward() or after a gap of more than 10ms
+     * only seeds the held setpoint, so entering rate mode with the stick deflected gives no derivative spike.
+     * 
+     * @param axis 0 roll, 1 pitch, 2 yaw
+     * @param setpoint deg/s
+     */
+    float feedforward(int axis, float setpoint) {
+        uint32_t now = micros();
+        float dt = (now - feedforwardLastUs[axis]) / 1000000.0f;
+        feedforwardLastUs[axis] = now;
+        float& held = feedforwardSetpoint[axis];
+        float derivative = 0;
+        if(!feedforwardSeeded[axis] || dt <= 0 || dt > 0.01f) {
+            held = setpoint;
+            feedforwardSeeded[axis] = true;
+        } else {
+            float prev = held;
+            if(setpoint > held + feedforwardDeadband) held = setpoint - feedforwardDeadband;
+            if(setpoint < held - feedforwardDeadband) held = setpoint + feedforwardDeadband;
+            derivative = (held - prev) / dt;
+        }
+        return (float) feedforwardGain.getAxis(axis) * derivative + (float) feedforwardStatic.getAxis(axis) * setpoint;
+    }
+
+    /**
+     * Next feedforward() call per axis reseeds from its setpoint
+     */
+    void resetFeedforward() {
+        for (int i = 0; i < 3; i++) {
+            feedforwardSeeded[i] = false;
+        }
+    }
+
     bool launched = false;
 
     bool autoLiftoff = false;
@@ -534,10 +701,26 @@ private:
     float lastThrottle = 0;
     float lastBoost = 0;
 
-    Motor* mFL; // front left:  motor1
-    Motor* mFR; // front rigt:  motor2
-    Motor* mBL; // back left:   motor3
-    Motor* mBR; // back right:  motor4
+    Motor* motors[Mixer::maxMotors]; // quad: front left, front right, back left, back right
+    int motorCount;
+    Mixer mixer; // always has motorCount rules, see setMixer()
+    float motorOutputs[Mixer::maxMotors];
+    ThrustCurve thrustCurves[Mixer::maxMotors];
+
+    /**
+     * Preset for the wired motor count. Other counts start with an all zero table, so the motors idle until setMixer() provides one
+     */
+    static Mixer defaultMixer(int motorCount) {
+        if(motorCount == 4) return Mixer::quadX();
+        if(motorCount == 6) return Mixer::hexX();
+        if(motorCount == 8) return Mixer::octoX();
+        Mixer mixer;
+        mixer.motorCount = 0;
+        for (int i = 0; i < motorCount; i++) {
+            mixer.add(0, 0, 0, 0);
+        }
+        return mixer;
+    }
 
     long imuReadingVerions = -1;
     long count = 0;
@@ -554,23 +737,6 @@ private:
     uint32_t lastArmedMs = 0;
     uint32_t lastDisarmMs = 0;
 
-    /**
-     * @brief Get the angle from one coordinate to another
-     * 
-     * @return double degrees
-     */
-    double angleFromCoordinate(double lat1, double long1, double lat2, double long2) {
-        double dLon = (long2 - long1);
-        double y = sin(dLon) * cos(lat2);
-        double x = cos(lat1) * sin(lat2) - sin(lat1)
-                * cos(lat2) * cos(dLon);
-        double brng = atan2(y, x);
-        brng = brng * RAD_TO_DEG;
-        brng = (int) (brng + 360) % 360;
-        brng = 360 - brng; // count degrees counter-clockwise
-        return brng;
-    }
-
     void crop(float& val, float lim) {
         crop(val, -lim, lim);
     }
@@ -581,22 +747,18 @@ private:
     }
 
     /**
-     * Betaflight rates
-     * r = RC_RATE
-     * b = s_Rate
-     * c = expo
-     * Desmos.com: f\left(x\right)=\left(200\cdot\ \left(\left(x^{4}\ \cdot\ c\right)\ +\ x\ \cdot\ \left(1-c\right)\right)\ \cdot\ a\right)\cdot\left(\frac{1}{\left(1-\left(x\cdot b\right)\right)}\right)\left\{-1<x<1\right\}
+     * Gyro rate fed into the rate PIDs. Built with FIXED_POINT_GYRO this comes from the fixed point path once the sensor feeds it
+     * @param axis 0 = roll, 1 = pitch, 2 = yaw
      */
-    float stickToRate(float x, float rc, float super, float expo) {
-        float mul = x > 0.0 ? 1.0 : -1.0;
-        if(x < 0) {
-            x = -x;
+    double pidGyroRate(int axis) {
+#ifdef FIXED_POINT_GYRO
+        if(ins->sensors->gyroFixed.isActive()) return ins->sensors->gyroFixed.getRate(axis);
+#endif
+        switch(axis) {
+            case 0: return ins->getRollRate();
+            case 1: return ins->getPitchRate();
+            default: return ins->getYawRate();
         }
-        return (200.0f * ((pow(x, 4.0f) * expo) + x * (1.0f - expo)) * rc) * (1.0f / (1.0f - (x * super))) * mul;
-    }
-
-    float stickToRate(float x, Vec3& rates) {
-        return stickToRate(x, rates.x, rates.y, rates.z);
     }
 
     /**
@@ -652,6 +814,7 @@ private:
      * @param fm flight mode to be initialized
      */
     void initFlightMode(FlightMode::FlightMode_t prevFm, FlightMode::FlightMode_t newFm) {
+        resetFeedforward();
         if(newFm >= FlightMode::altitudeHold) {
             if(altitudePID.integrator == 0 && airborne) {
                 altitudePID.integrator = hoverThrottle;
@@ -664,7 +827,7 @@ private:
         }
         if(newFm == FlightMode::turtle) {
             Serial.println("Entering turtle mode");
-            mFL->sendComand(DIGITAL_CMD_BEEP1, 1);
+            motors[0]->sendComand(DIGITAL_CMD_BEEP1, 1);
             // mFL->sendComand(DIGITAL_CMD_SPIN_DIRECTION_2, 100);
             // mFR->sendComand(DIGITAL_CMD_SPIN_DIRECTION_2, 100);
             // mBL->sendComand(DIGITAL_CMD_SPIN_DIRECTION_2, 100);
@@ -672,11 +835,10 @@ private:
         }
         if(prevFm == FlightMode::turtle) {
             Serial.println("Exiting turtle mode");
-            mFL->sendComand(DIGITAL_CMD_BEEP1, 1);
-            mFL->sendComand(DIGITAL_CMD_SPIN_DIRECTION_NORMAL, 10);
-            mFR->sendComand(DIGITAL_CMD_SPIN_DIRECTION_NORMAL, 10);
-            mBL->sendComand(DIGITAL_CMD_SPIN_DIRECTION_NORMAL, 10);
-            mBR->sendComand(DIGITAL_CMD_SPIN_DIRECTION_NORMAL, 10);
+            motors[0]->sendComand(DIGITAL_CMD_BEEP1, 1);
+            for (int i = 0; i < motorCount; i++) {
+                motors[i]->sendComand(DIGITAL_CMD_SPIN_DIRECTION_NORMAL, 10);
+            }
         }
     }
 
@@ -744,34 +906,19 @@ private:
         crop(rollRateAdjust, maxRateChange);
         crop(pitchRateAdjust, maxRateChange);
 
-        // Mixer
-        float mFLThrottle = throttle + rollRateAdjust - pitchRateAdjust + (propsIn ? -yawRateAdjust : +yawRateAdjust);
-        float mFRThrottle = throttle - rollRateAdjust - pitchRateAdjust + (propsIn ? +yawRateAdjust : -yawRateAdjust);
-        float mBLThrottle = throttle + rollRateAdjust + pitchRateAdjust + (propsIn ? +yawRateAdjust : -yawRateAdjust);
-        float mBRThrottle = throttle - rollRateAdjust + pitchRateAdjust + (propsIn ? -yawRateAdjust : +yawRateAdjust);
+        // Mixer, the table is for props in
+        mixer.mix(throttle, rollRateAdjust, pitchRateAdjust, propsIn ? yawRateAdjust : -yawRateAdjust, motorOutputs);
 
-        // Keeping controll authority
-        float minThrottle = min(mFLThrottle, min(mFRThrottle, min(mBLThrottle, mBRThrottle)));
-        if(minThrottle < 0) {
-            mFLThrottle -= minThrottle;
-            mFRThrottle -= minThrottle;
-            mBLThrottle -= minThrottle;
-            mBRThrottle -= minThrottle;
-        }
-        float maxThrottle = max(mFLThrottle, max(mFRThrottle, max(mBLThrottle, mBRThrottle)));
-        if(maxThrottle > 1) {
-            mFLThrottle += 1 - maxThrottle;
-            mFRThrottle += 1 - maxThrottle;
-            mBLThrottle += 1 - maxThrottle;
-            mBRThrottle += 1 - maxThrottle;
+        // Thrust to motor command
+        float throttleMul = getThrottleMul();
+        for (int i = 0; i < motorCount; i++) {
+            motorOutputs[i] = thrustCurves[i].lookup(motorOutputs[i] * throttleMul);
         }
 
         // Write
-        double throttleMul = getThrottleMul();
-        mFL->write(mFLThrottle * throttleMul);
-        mFR->write(mFRThrottle * throttleMul);
-        mBL->write(mBLThrottle * throttleMul);
-        mBR->write(mBRThrottle * throttleMul);
+        for (int i = 0; i < motorCount; i++) {
+            motors[i]->write(motorOutputs[i]);
+        }
     }
 
     uint32_t lastRollIReset = 0;
@@ -795,11 +942,10 @@ private:
         }
         // airborne = true;
         // I term relax
-        Vec3 pilot = pilotRateFromChanels(chanels);
         if(flightMode == FlightMode::rate) {
-            rateRollPID.lockI   = abs(pilot.x) > iRelaxMinRate;
-            ratePitchPID.lockI  = abs(pilot.y) > iRelaxMinRate;
-            rateYawPID.lockI    = abs(pilot.z) > iRelaxMinRate;
+            rateRollPID.lockI   = abs(pilotRate.x) > iRelaxMinRate;
+            ratePitchPID.lockI  = abs(pilotRate.y) > iRelaxMinRate;
+            rateYawPID.lockI    = abs(pilotRate.z) > iRelaxMinRate;
             // rateRollPID.lockI   = abs(ins->getRollRate())  > iRelaxMinRate || abs(pilot.x) > iRelaxMinRate;
             // ratePitchPID.lockI  = abs(ins->getPitchRate()) > iRelaxMinRate || abs(pilot.y) > iRelaxMinRate;
             // rateYawPID.lockI    = abs(ins->getYawRate())   > iRelaxMinRate || abs(pilot.z) > iRelaxMinRate;
@@ -807,7 +953,7 @@ private:
 
         levelRollPID.lockI   = abs(ins->getRollRate())  > iRelaxMinRate;
         levelPitchPID.lockI  = abs(ins->getPitchRate()) > iRelaxMinRate;
-        levelYawPID.lockI    = abs(ins->getYawRate())   > iRelaxMinRate || abs(pilot.z) > iRelaxMinRate;
+        levelYawPID.lockI    = abs(ins->getYawRate())   > iRelaxMinRate || abs(pilotRate.z) > iRelaxMinRate;
 
         rateRollPID.iEnabled   = airborne;
         ratePitchPID.iEnabled  = airborne;
@@ -861,6 +1007,7 @@ private:
         ins->resetYaw();
         gyroRot = Quaternion();
         pilotRot = Quaternion();
+        resetFeedforward();
     }
 
     /**
@@ -891,13 +1038,6 @@ private:
         lastAntiGravityUs = micros();
     }
 
-    Vec3 pilotRateFromChanels(CRSF_TxChanels_Converted chanels) {
-        return Vec3(
-            stickToRate(chanels.roll, yawRate),
-            stickToRate(chanels.pitch, pitchRate),
-            stickToRate(chanels.yaw, yawRate));
-    }
-
     /**
      * @brief Statistics
      * 
@@ -921,6 +1061,8 @@ private:
     double angleFromTo(double xDeg, double yDeg) {
         double x = xDeg * DEG_TO_RAD;
         double y = yDeg * DEG_TO_RAD;
-        return atan2(sin(x-y), cos(x-y)) * RAD_TO_DEG;
+        float s, c;
+        FastTrig::sincos(x - y, s, c);
+        return FastTrig::atan2(s, c) * RAD_TO_DEG;
     }
 };
\ No newline at end of file
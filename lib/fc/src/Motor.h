@@ -34,7 +34,7 @@ public:
     void write(float percentage) {
         if(percentage < 0) percentage = 0;
         if(percentage > 1) percentage = 1;
-        writeRaw(map(percentage, 0.0f, 1.0f, minThrottle, maxThrottle));
+        writeRaw(minThrottle + percentage * (maxThrottle - minThrottle));
     }
 
     virtual bool isArmed() = 0;
@@ -48,8 +48,4 @@ public:
 protected:
     float minThrottle = 0.001; //mapping values
     float maxThrottle = 1;
-
-    double map(double x, double in_min, double in_max, double out_min, double out_max) {
-        return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
-    }
 };
\ No newline at end of file
@@ -0,0 +1,384 @@
+/**
+ * @file SensorImpICM-42688.h
+ * @author Timo Lehnertz
+ * @brief SensorInterface implementation for the ICM-42688-P
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <Arduino.h>
+#include "sensorInterface.h"
+#include <ICM42688.h>
+#include <error.h>
+#include <maths.h>
+#include <SPI.h>
+#include <decimator.h>
+
+/**
+ * VIN ICM42688                 : 3.3V
+ * GND ICM42688                 : GND
+ * SCLK ICM42688                : Pin 13
+ * SDI ICM42688                 : Pin 11
+ * SDO ICM42688                 : Pin 12
+ * CS ICM42688                  : Pin 10
+ *
+ * Bat (voltage divider)        : Pin 22  680k Ohm | 5.6m Ohm
+ **/
+
+#define ICM42688_CS 10
+
+class ICM42688Sensor : public SensorInterface {
+public:
+
+    ICM42688 icm;
+
+    ICM42688::Odr odr = ICM42688::ODR_32KHZ;
+    ICM42688::AafBandwidth gyroAaf = ICM42688::AAF_BANDWIDTH_258HZ;
+    ICM42688::AafBandwidth accAaf = ICM42688::AAF_BANDWIDTH_258HZ;
+    bool highResolution = true; // 20 bit fifo packets
+    bool decimate = true; // anti alias decimation from the output data rate down to the loop rate
+    bool decimationCompensation = false; // flatten the passband droop of the CIC stages
+
+    ICM42688Sensor() : icm(SPI, ICM42688_CS) {}
+
+    /**
+     * Begin function can becalled as many times as wanted
+     */
+    void begin() {
+        initICM42688();
+        Serial.println("ICM42688 started");
+        Serial.print("(");
+        Serial.print(millis());
+        Serial.println(")");
+
+        initBattery();
+        Serial.println("Battery sensor started");
+        Serial.print("(");
+        Serial.print(millis());
+        Serial.println(")");
+    }
+
+    void initBattery() {
+        pinMode(22, INPUT);
+    }
+
+    void initICM42688() {
+        int status = icm.begin();
+        if(status > 0) status = icm.setGyroAaf(gyroAaf);
+        if(status > 0) status = icm.setAccelAaf(accAaf);
+        if(status > 0) status = icm.setOdr(odr);
+        if(status > 0) status = icm.enableFifo(highResolution);
+        if (status < 0) {
+            if(!icmErrorPrinted) {
+                Serial.println("ICM42688 initialization unsuccessful");
+                Serial.println("Check ICM42688 wiring");
+                Serial.print("Status: ");
+                Serial.println(status);
+                icmErrorPrinted = true;
+            }
+            acc.error  = Error::CRITICAL_ERROR;
+            gyro.error = Error::CRITICAL_ERROR;
+        } else {
+            acc.error  = Error::NO_ERROR;
+            gyro.error = Error::NO_ERROR;
+            // in 20 bit mode the 16 bit part saturates
+            int32_t clipLimit = highResolution ? 32767 * 16 : 32767;
+            gyroVibration.configure(clipLimit, icm.getGyroScale(), icm.getOdrHz());
+            accVibration.configure(clipLimit, icm.getAccelScale(), icm.getOdrHz());
+            configureDecimation();
+            configureGyroFixed();
+            Serial.print("Succsessfully initiated ICM42688 at ");
+            Serial.print(icm.getOdrHz());
+            Serial.println("Hz");
+        }
+    }
+
+    void setAccCal(Vec3 gVecOffset, Vec3 scale) {
+        accOffset = gVecOffset.clone();
+    }
+
+    void setGyroCal(Vec3 degVecOffset, Vec3 gyroScale) {
+        gyroOffset = degVecOffset.clone();
+        this->gyroScale = gyroScale.clone();
+        configureGyroFixed();
+    }
+
+    void setMagCal(Vec3 offset, Vec3 scale) {
+        magOffset = offset;
+        magScale = scale;
+    }
+
+    Vec3 getAccOffset() {
+        return accOffset;
+    }
+
+    Vec3 getAccScale() {
+        return Vec3();
+    }
+
+    Vec3 getGyroOffset() {
+        return gyroOffset;
+    }
+
+    Vec3 getGyroScale() {
+        return gyroScale;
+    }
+
+    Vec3 getMagOffset() {
+        return magOffset;
+    }
+
+    Vec3 getMagScale() {
+        return magScale;
+    }
+
+    /**
+     * Axes are mapped the same way as for the MPU9250 so both boards share one orientation
+     */
+    Vec3 getAccRaw() {
+        return Vec3(icm.getAccelX_G(), -icm.getAccelY_G(), icm.getAccelZ_G());
+    }
+
+    /**
+     * in deg/s
+     */
+    Vec3 getGyroRaw() {
+        return Vec3(icm.getGyroX_dps(), icm.getGyroY_dps(), -icm.getGyroZ_dps());
+    }
+
+    /**
+     * Decimation ratio is the output data rate divided by the loop rate, rounded down
+     */
+    void setLoopFreq(int hz) {
+        loopFreq = max(1, hz);
+        configureDecimation();
+    }
+
+    uint32_t getDecimationRatio() {
+        return gyroDecimator.getRatio();
+    }
+
+    void handle() {
+        uint64_t timeTmp = micros();
+        /**
+         * ICM42688
+         * Every FIFO sample runs through the decimators. Without decimation only the newest sample of a batch is used
+         */
+        int samples = icm.readFifo();
+        if(!gyroLpf.isConfigured(gyroLpfHz, getGyroOutputHz())) configureGyroLpf();
+        if(samples > 0) {
+            int newest = -1;
+            for (int i = 0; i < samples; i++) {
+                const ICM42688::FifoSample& sample = icm.getFifoSample(i);
+                if(!sample.gyroValid || !sample.accelValid) continue;
+                gyroVibration.update(sample.gyro[0], sample.gyro[1], sample.gyro[2]);
+                accVibration.update(sample.accel[0], sample.accel[1], sample.accel[2]);
+                newest = i;
+                if(!decimate) continue;
+                int32_t accCounts[3];
+                int32_t gyroCounts[3];
+                accDecimator.push(sample.accel, accCounts);
+                if(gyroDecimator.push(sample.gyro, gyroCounts)) {
+#ifdef FIXED_POINT_GYRO
+                    gyroFixed.update(gyroCounts);
+#endif
+                    uint64_t sampleTime = icm.getFifoSampleTimeUs(i) - decimationDelayUs;
+                    acc.update(accFromCounts(accCounts) - accOffset, sampleTime);
+                    gyro.update(gyroLpf.update((gyroFromCounts(gyroCounts) - gyroOffset) * gyroScale), sampleTime);
+                }
+            }
+            if(!decimate && newest >= 0) {
+#ifdef FIXED_POINT_GYRO
+                gyroFixed.update(icm.getFifoSample(newest).gyro);
+#endif
+                uint64_t sampleTime = icm.getSampleTimeUs();
+                acc.update(getAccRaw() - accOffset, sampleTime);
+                gyro.update(gyroLpf.update((getGyroRaw() - gyroOffset) * gyroScale), sampleTime);
+            }
+            acc.lastPollTime = micros() - timeTmp;
+            gyro.lastPollTime = acc.lastPollTime;
+        } else if(samples < 0) {
+            initICM42688();
+        }
+
+        /**
+         * vBat
+         * Resolution 10 Bit(0 to 1023)
+         * Range 0 to 3.3 Volts
+         */
+        int analog = analogRead(22);
+        vMeasured = (analog * 3.3) / 1023.0;
+        float vConverted = (batOffset + vMeasured) * vBatMul;
+
+        bat.vBat = bat.vBat * (1 - batLpf) + batLpf * vConverted; // lpf
+
+        bat.cellCount = max(bat.cellCount, (int) ceil((bat.vBat - 0.2) / 4.2));
+        if(bat.cellCount == 5) bat.cellCount = 6; // skip 5s
+
+        bat.vCell = bat.vBat / bat.cellCount;
+        bat.lastChange = micros();
+
+        /**
+         * Error handling
+         */
+        acc.checkError();
+        gyro.checkError();
+        mag.checkError();
+        baro.checkError();
+        gps.checkError();
+    }
+
+    /**
+     * System has to be perfectly level!
+     * Sets the acc scale to one and only calibrates the offset to level
+     */
+    void calibrateAcc() {
+        Vec3 avg = Vec3();
+        const int sampleCount = 100;
+        for (size_t i = 0; i < sampleCount; i++) {
+            icm.readSensor();
+            avg += getAccRaw() / (double) sampleCount;
+            delay(20);
+        }
+        accOffset = (avg - Vec3(0, 0, 1));
+    }
+
+    /**
+     * Blocks for 2 seconds
+     */
+    void calibrateGyroOffset() {
+        Vec3 avg = Vec3();
+        const int sampleCount = 100;
+        for (size_t i = 0; i < sampleCount; i++) {
+            icm.readSensor();
+            avg += getGyroRaw();
+            delay(20);
+        }
+        gyroOffset = (avg / (double) sampleCount);
+        configureGyroFixed();
+    }
+
+    double getGyroSum(uint32_t time, int axis) {
+        uint32_t start = millis();
+        boolean printed = false;
+        double sum = 0;
+        uint64_t last = micros();
+        while(millis() - start < time) {
+            if(!printed && ((millis() - start) % 1000 == 0)) {
+                Serial.println((time - (millis() - start)) / 1000);
+                printed = true;
+            }
+            if(((millis() - start) % 1000 != 0)) {
+                printed = false;
+            }
+            icm.readSensor();
+            Vec3 gyro = getGyroRaw() - gyroOffset;
+            uint64_t now = micros();
+            double t = (now - last) / 1000000.0;
+            sum += gyro.getAxis(axis) * t;
+            last = now;
+            delayMicroseconds(200);
+        }
+        return sum;
+    }
+
+    void calibrateGyroScale() {
+        delay(1000);
+        Serial.println("Calibrating Gyro scale");
+        Serial.println("Lay drone on a flat surface");
+        Serial.println("3");
+        delay(1000);
+        Serial.println("2");
+        delay(1000);
+        Serial.println("1");
+        delay(1000);
+        for (size_t axis = 0; axis < 3; axis++) {
+            switch(axis) {
+                case 0: {Serial.println("Roll 360deg and lay back"); break;}
+                case 1: {Serial.println("Pitch 360deg and lay back"); break;}
+                case 2: {Serial.println("Yaw 360deg and lay back"); break;}
+            }
+            double sum = getGyroSum(7000, axis);
+            Serial.print("sum: ");
+            Serial.println(sum);
+            gyroScale.setAxis(axis, 360.0 / abs(sum));
+            Serial.print("Axis done! Scale: ");
+            Serial.println(gyroScale.getAxis(axis));
+            delay(2000);
+        }
+        configureGyroFixed();
+    }
+
+    /**
+     * No magnetometer on this board
+     */
+    void calibrateMag() {}
+
+    void calibrateBat(float actualVoltage) {
+        vBatMul = actualVoltage / vMeasured;
+        Serial.print("Calibrated vBat. Multiplier: ");
+        Serial.println(vBatMul);
+    }
+
+private:
+
+    Vec3 accOffset = Vec3();//in G
+    Vec3 gyroOffset = Vec3();//in degrees
+    Vec3 gyroScale = Vec3(1,1,1);
+
+    Vec3 magOffset = Vec3();
+    Vec3 magScale = Vec3();
+
+    bool icmErrorPrinted = false;
+    float vMeasured = 1;
+
+    int loopFreq = 1000;
+    CicDecimatorVec3<2> accDecimator;
+    CicDecimatorVec3<2> gyroDecimator;
+    uint32_t decimationDelayUs = 0; // decimated samples are stamped with the center of their input window
+
+    void configureDecimation() {
+        uint32_t ratio = max(1, (int) (icm.getOdrHz() / loopFreq));
+        accDecimator.configure(ratio, decimationCompensation);
+        gyroDecimator.configure(ratio, decimationCompensation);
+        decimationDelayUs = gyroDecimator.getGroupDelay() * 1000000.0f / icm.getOdrHz();
+    }
+
+    /**
+     * One gyro sample per decimator output, otherwise one per handle()
+     */
+    float getGyroOutputHz() {
+        return decimate ? icm.getOdrHz() / (float) gyroDecimator.getRatio() : (float) loopFreq;
+    }
+
+    /**
+     * The float and the fixed point low pass share one factor
+     */
+    void configureGyroLpf() {
+        gyroLpf.configure(gyroLpfHz, getGyroOutputHz());
+        configureGyroFixed();
+    }
+
+    /**
+     * Folds scale, axis signs (same as gyroFromCounts) and calibration into the fixed point gyro path
+     */
+    void configureGyroFixed() {
+        const int sign[3] = {1, 1, -1};
+        const float offset[3] = {(float) gyroOffset.x, (float) gyroOffset.y, (float) gyroOffset.z};
+        const float scale[3] = {(float) gyroScale.x, (float) gyroScale.y, (float) gyroScale.z};
+        gyroFixed.configure(icm.getGyroScale(), sign, offset, scale, gyroLpf.getFactor());
+    }
+
+    Vec3 accFromCounts(const int32_t counts[3]) {
+        float scale = icm.getAccelScale();
+        return Vec3(counts[0] * scale, -counts[1] * scale, counts[2] * scale);
+    }
+
+    Vec3 gyroFromCounts(const int32_t counts[3]) {
+        float scale = icm.getGyroScale();
+        return Vec3(counts[0] * scale, counts[1] * scale, -counts[2] * scale);
+    }
+};
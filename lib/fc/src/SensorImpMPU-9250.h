@@ -92,8 +92,9 @@ public:
     float magHz = 100;
     uint32_t lastMag = 0;
 
-    double ultraSonicHz = 100;
+    double ultraSonicHz = 100; // 0 disables the ultrasonic sensor
     uint64_t lastUltraSonic = 0;
+    double ultrasonicFiltered = 0; // m, only for the speed
 
     MPU9250 mpu9250;
     // Adafruit_MPU6050 mpu6050;
@@ -231,6 +232,9 @@ public:
             Serial.println("Succsessfully initiated MPU9250");
         }
         mpu9250.setDlpfBandwidth(MPU9250::DLPF_BANDWIDTH_184HZ);
+        // 1000dps and 8g ranges at 1kHz
+        gyroVibration.configure(32767, 1000.0f / 32768.0f, 1000);
+        accVibration.configure(32767, 8.0f / 32768.0f, 1000);
         // mag.lpf = 0.1;
     }
 
@@ -295,11 +299,33 @@ public:
         return Vec3(x, y, z);
     }
 
+    /**
+     * One gyro sample per handle(), so the gyro low pass runs at the loop rate
+     */
+    void setLoopFreq(int hz) {
+        loopFreq = max(1, hz);
+    }
+
     Vec3 getGyrocRaw() {
         return Vec3(mpu9250.getGyroY_rads(), mpu9250.getGyroX_rads(), mpu9250.getGyroZ_rads());
         // return Vec3(g.gyro.x, g.gyro.y, -g.gyro.z);
     }
 
+    /**
+     * Feeds the vibration stats with every new sample. Sensor axes match the flight controller axes up to the sign
+     */
+    void updateVibration() {
+        int16_t gx = mpu9250.getGyroXCounts();
+        int16_t gy = mpu9250.getGyroYCounts();
+        int16_t gz = mpu9250.getGyroZCounts();
+        if(gx == lastGyroCounts[0] && gy == lastGyroCounts[1] && gz == lastGyroCounts[2]) return; // no new sample
+        lastGyroCounts[0] = gx;
+        lastGyroCounts[1] = gy;
+        lastGyroCounts[2] = gz;
+        gyroVibration.update(gx, gy, gz);
+        accVibration.update(mpu9250.getAccelXCounts(), mpu9250.getAccelYCounts(), mpu9250.getAccelZCounts());
+    }
+
     double lastX, lastY, lastZ;
     int i;
     uint32_t lastPrint = 0;
@@ -325,6 +351,7 @@ public:
          */
         // readMpu6050();
         mpu9250.readSensor();
+        updateVibration();
         Vec3 accRaw = getAccRaw();
         if(accRaw.getLength() != 0) {
             acc.update (accRaw - accOffset);
@@ -333,7 +360,8 @@ public:
         timeTmp = micros();
         Vec3 gyroRaw = getGyrocRaw();
         if(gyroRaw.x != 0) {
-            gyro.update((gyroRaw.toDeg() - gyroOffset) * gyroScale);
+            if(!gyroLpf.isConfigured(gyroLpfHz, loopFreq)) gyroLpf.configure(gyroLpfHz, loopFreq);
+            gyro.update(gyroLpf.update((gyroRaw.toDeg() - gyroOffset) * gyroScale));
             gyro.lastPollTime = micros() - timeTmp;
         }
         timeTmp = micros();
@@ -361,31 +389,33 @@ public:
 
         /**
          * Ultra sonic
+         * The echo of the previous trigger is read right before the next one. Without an echo the sensor counts as disconnected
          */
-        // if(ultraSonicHz > 0 && micros() > lastUltraSonic + (1000000.0f / ultraSonicHz)) {
-        //     /**
-        //      * Save last
-        //      */
-        //     noInterrupts();
-        //     double distanceM = ultrasonicDuration * 0.00034 / 2;
-        //     bool received = ultrasonicReceived;
-        //     ultrasonicReceived = false;
-        //     interrupts();
-
-        //     double deltaT = (micros() - lastUltraSonic) / 1000000.0;
-        //     double lpf = 0.1;
-        //     double distanceFiltered = distanceM * lpf + (1 - lpf) * ultrasonic.distance;
-        //     double speed = (distanceFiltered - ultrasonic.distance) / deltaT;
-
-        //     ultrasonic.update(distanceFiltered, speed, distanceM > 3);
-        //     ultrasonic.connected = received;
-        //     digitalWrite(ULTRA_SONIC_TRIG, HIGH);
-        //     delayMicroseconds(10);
-        //     digitalWrite(ULTRA_SONIC_TRIG, LOW);
-        //     ultrasonicStart = micros();
-        //     // Serial.println(ultrasonic.distance);
-        //     lastUltraSonic = micros();
-        // }
+        if(ultraSonicHz > 0 && micros() > lastUltraSonic + (1000000.0f / ultraSonicHz)) {
+            /**
+             * Save last
+             */
+            noInterrupts();
+            double distanceM = ultrasonicDuration * 0.00034 / 2;
+            bool received = ultrasonicReceived;
+            ultrasonicReceived = false;
+            interrupts();
+
+            double deltaT = (micros() - lastUltraSonic) / 1000000.0;
+            double lpf = 0.1;
+            double lastFiltered = ultrasonicFiltered;
+            ultrasonicFiltered = distanceM * lpf + (1 - lpf) * ultrasonicFiltered;
+            double speed = (ultrasonicFiltered - lastFiltered) / deltaT;
+
+            // the fusion filters the raw distance itself
+            ultrasonic.connected = received;
+            ultrasonic.update(distanceM, speed, distanceM > 3);
+            digitalWrite(ULTRA_SONIC_TRIG, HIGH);
+            delayMicroseconds(10);
+            digitalWrite(ULTRA_SONIC_TRIG, LOW);
+            ultrasonicStart = micros();
+            lastUltraSonic = micros();
+        }
 
         /**
          * GPS
@@ -597,7 +627,9 @@ private:
     Vec3 magScale = Vec3();
 
     bool mpuErrorPrinted = false;
+    int16_t lastGyroCounts[3] = {0, 0, 0};
     float vMeasured = 1;
+    int loopFreq = 1000;
 
     Vec3 accSideAvgs[6];
     int sideCals = 0;
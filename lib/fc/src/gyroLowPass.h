@@ -0,0 +1,73 @@
+/**
+ * @file gyroLowPass.h
+ * @author Timo Lehnertz
+ * @brief First order low pass on calibrated gyro rates, float twin of the GyroRateFixed low pass
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <math.h>
+#include <maths.h>
+
+/**
+ * Runs at the gyro output rate of the sensor (the decimated rate or the loop rate), not at the FIFO rate.
+ * Recursion and factor match GyroRateFixed so the float and the fixed point path feed the rate PIDs the same signal
+ */
+class GyroLowPass {
+public:
+    /**
+     * Per sample factor, same formula as LowPassFilter
+     * @param cutoffHz 0 or less passes the rate through
+     * @param sampleHz gyro output rate
+     * @return 0 - 1, 1 passes the rate through
+     */
+    static float factor(float cutoffHz, float sampleHz) {
+        if(cutoffHz <= 0 || sampleHz <= 0) return 1;
+        return 1 - expf(-2 * (float) M_PI * cutoffHz / sampleHz);
+    }
+
+    void configure(float cutoffHz, float sampleHz) {
+        this->cutoffHz = cutoffHz;
+        this->sampleHz = sampleHz;
+        alpha = factor(cutoffHz, sampleHz);
+    }
+
+    /**
+     * @return true if configure() was called with these values
+     */
+    bool isConfigured(float cutoffHz, float sampleHz) const {
+        return this->cutoffHz == cutoffHz && this->sampleHz == sampleHz;
+    }
+
+    float getFactor() const {
+        return alpha;
+    }
+
+    void reset() {
+        primed = false;
+    }
+
+    /**
+     * @param rate calibrated rate in deg/s
+     * @return filtered rate in deg/s
+     */
+    Vec3 update(const Vec3& rate) {
+        if(!primed || alpha >= 1) {
+            state = rate;
+        } else {
+            state += (rate - state) * alpha;
+        }
+        primed = true;
+        return state;
+    }
+
+private:
+    float cutoffHz = -1;
+    float sampleHz = -1;
+    float alpha = 1;
+    Vec3 state;
+    bool primed = false;
+};
@@ -0,0 +1,177 @@
+/**
+ * @file mixer.h
+ * @author Timo Lehnertz
+ * @brief Table driven motor mixer
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+/**
+ * Contribution of each axis to one motor
+ */
+struct MixerRule {
+    float throttle;
+    float roll;
+    float pitch;
+    float yaw;
+};
+
+/**
+ * Motor outputs as a matrix vector product of the rule table and (throttle, roll, pitch, yaw).
+ *
+ * Yaw coefficients are for props in. Props out is handled by negating the yaw input.
+ *
+ * Saturation keeps roll / pitch before yaw before throttle:
+ *  1. roll / pitch are scaled down if their spread over the motors exceeds 1
+ *  2. yaw is scaled down until roll / pitch / yaw fit into the remaining spread
+ *  3. throttle is shifted so every output lands in 0 - 1
+ * The steps are a fixed number of passes over the table, so the cost only depends on motorCount
+ */
+class Mixer {
+public:
+    static constexpr int maxMotors = 8;
+
+    int motorCount = 0;
+    MixerRule rules[maxMotors];
+
+    Mixer() {
+        *this = quadX();
+    }
+
+    /**
+     * Motor order: front left, front right, back left, back right
+     */
+    static Mixer quadX() {
+        Mixer mixer(0);
+        mixer.add(1,  1, -1, -1);
+        mixer.add(1, -1, -1,  1);
+        mixer.add(1,  1,  1,  1);
+        mixer.add(1, -1,  1, -1);
+        return mixer;
+    }
+
+    /**
+     * Motor order clockwise starting front right, first motor spinning props in
+     */
+    static Mixer hexX() {
+        Mixer mixer(0);
+        mixer.add(1, -0.5f, -0.866f,  1);
+        mixer.add(1, -1.0f,  0.0f,   -1);
+        mixer.add(1, -0.5f,  0.866f,  1);
+        mixer.add(1,  0.5f,  0.866f, -1);
+        mixer.add(1,  1.0f,  0.0f,    1);
+        mixer.add(1,  0.5f, -0.866f, -1);
+        return mixer;
+    }
+
+    /**
+     * Motor order clockwise starting front right, first motor spinning props in
+     */
+    static Mixer octoX() {
+        Mixer mixer(0);
+        mixer.add(1, -0.383f, -0.924f,  1);
+        mixer.add(1, -0.924f, -0.383f, -1);
+        mixer.add(1, -0.924f,  0.383f,  1);
+        mixer.add(1, -0.383f,  0.924f, -1);
+        mixer.add(1,  0.383f,  0.924f,  1);
+        mixer.add(1,  0.924f,  0.383f, -1);
+        mixer.add(1,  0.924f, -0.383f,  1);
+        mixer.add(1,  0.383f, -0.924f, -1);
+        return mixer;
+    }
+
+    /**
+     * @return false if the table is full
+     */
+    bool add(float throttle, float roll, float pitch, float yaw) {
+        if(motorCount >= maxMotors) return false;
+        rules[motorCount++] = {throttle, roll, pitch, yaw};
+        return true;
+    }
+
+    /**
+     * @return true if motorCount is in range and no coefficient is NaN
+     */
+    bool isValid() const {
+        if(motorCount < 1 || motorCount > maxMotors) return false;
+        for (int i = 0; i < motorCount; i++) {
+            const MixerRule& r = rules[i];
+            if(r.throttle != r.throttle || r.roll != r.roll || r.pitch != r.pitch || r.yaw != r.yaw) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @param out motorCount outputs in 0 - 1
+     */
+    void mix(float throttle, float roll, float pitch, float yaw, float* out) {
+        // roll / pitch
+        float min = 1e9f, max = -1e9f;
+        for (int i = 0; i < motorCount; i++) {
+            out[i] = rules[i].roll * roll + rules[i].pitch * pitch;
+            if(out[i] < min) min = out[i];
+            if(out[i] > max) max = out[i];
+        }
+        float rpRange = max - min;
+        rpScale = 1;
+        if(rpRange > 1) {
+            rpScale = 1 / rpRange;
+            rpRange = 1;
+        }
+
+        // yaw. The spread is convex in the yaw scale, so scaling linearly between no yaw and full yaw stays in range
+        min = 1e9f;
+        max = -1e9f;
+        for (int i = 0; i < motorCount; i++) {
+            out[i] = out[i] * rpScale + rules[i].yaw * yaw;
+            if(out[i] < min) min = out[i];
+            if(out[i] > max) max = out[i];
+        }
+        float range = max - min;
+        yawScale = 1;
+        if(range > 1) {
+            yawScale = (1 - rpRange) / (range - rpRange);
+            float yawCut = yaw * (1 - yawScale);
+            for (int i = 0; i < motorCount; i++) {
+                out[i] -= rules[i].yaw * yawCut;
+            }
+        }
+
+        // throttle. Raise out of the bottom first, the top wins if both clip
+        min = 1e9f;
+        max = -1e9f;
+        for (int i = 0; i < motorCount; i++) {
+            out[i] += rules[i].throttle * throttle;
+            if(out[i] < min) min = out[i];
+            if(out[i] > max) max = out[i];
+        }
+        float shift = min < 0 ? -min : 0;
+        if(max + shift > 1) shift = 1 - max;
+        for (int i = 0; i < motorCount; i++) {
+            out[i] += shift;
+        }
+    }
+
+    /**
+     * Turtle mode output of one motor, flips towards the sticks
+     */
+    float turtle(int motor, float roll, float pitch) const {
+        return -rules[motor].roll * roll + rules[motor].pitch * pitch;
+    }
+
+    /**
+     * Scales applied by the last mix(), 1 means unsaturated
+     */
+    float getRollPitchScale() const { return rpScale; }
+    float getYawScale() const { return yawScale; }
+
+private:
+    float rpScale = 1;
+    float yawScale = 1;
+
+    explicit Mixer(int motorCount) : motorCount(motorCount) {}
+};
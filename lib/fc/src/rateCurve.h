@@ -0,0 +1,64 @@
+/**
+ * @file rateCurve.h
+ * @author Timo Lehnertz
+ * @brief Betaflight style stick to rate curve
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+/**
+ * Betaflight style rates. The curve is point symmetric, negative sticks mirror it.
+ *
+ * Evaluated directly instead of through a lookup table: without pow() the exact curve is as fast as an interpolated table
+ * and has no interpolation error
+ */
+class RateCurve {
+public:
+    RateCurve() {
+        configure(1, 0, 0);
+    }
+
+    /**
+     * Exact curve
+     * r = RC_RATE
+     * b = s_Rate
+     * c = expo
+     * Desmos.com: f\left(x\right)=\left(200\cdot\ \left(\left(x^{4}\ \cdot\ c\right)\ +\ x\ \cdot\ \left(1-c\right)\right)\ \cdot\ a\right)\cdot\left(\frac{1}{\left(1-\left(x\cdot b\right)\right)}\right)\left\{-1<x<1\right\}
+     */
+    static float evaluate(float x, float rc, float super, float expo) {
+        float mul = x > 0.0f ? 1.0f : -1.0f;
+        if(x < 0) {
+            x = -x;
+        }
+        float x2 = x * x;
+        return (200.0f * ((x2 * x2 * expo) + x * (1.0f - expo)) * rc) * (1.0f / (1.0f - (x * super))) * mul;
+    }
+
+    /**
+     * Call whenever the rates change
+     */
+    void configure(float rc, float super, float expo) {
+        this->rc = rc;
+        this->super = super;
+        this->expo = expo;
+    }
+
+    /**
+     * @param x stick -1 - 1, clamped
+     * @return rate in deg/s
+     */
+    float rate(float x) const {
+        if(x > 1) x = 1;
+        if(x < -1) x = -1;
+        return evaluate(x, rc, super, expo);
+    }
+
+private:
+    float rc;
+    float super;
+    float expo;
+};
@@ -0,0 +1,137 @@
+/**
+ * @file rcSmoothing.h
+ * @author Timo Lehnertz
+ * @brief Loop rate smoothing of RC setpoints arriving at frame rate
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <math.h>
+
+/**
+ * RC frames arrive at 50 - 500 Hz while the loop runs at several kHz. Without smoothing the setpoint is a staircase
+ * and every step shows up in the D term and the motors.
+ *
+ * Every channel runs through a PT2 low pass updated each loop. The cutoff is chosen from the measured frame rate:
+ *  cutoff = frame rate * cutoffFactor, clamped to minCutoff - maxCutoff
+ * With extrapolate the filter target is advanced along the slope of the last two frames by the measured latency
+ */
+class RcSmoothing {
+public:
+    static constexpr int MAX_CHANELS = 4;
+
+    static constexpr float minCutoff = 5.0f;   // Hz
+    static constexpr float maxCutoff = 150.0f; // Hz
+
+    bool extrapolate = false;
+
+    RcSmoothing() {
+        for (int i = 0; i < MAX_CHANELS; i++) {
+            setRange(i, -1, 1);
+        }
+    }
+
+    /**
+     * Extrapolated targets are clamped into lower - upper. Default is -1 - 1
+     */
+    void setRange(int chanel, float lower, float upper) {
+        this->lower[chanel] = lower;
+        this->upper[chanel] = upper;
+    }
+
+    /**
+     * Jumps to the next sample without smoothing
+     */
+    void reset() {
+        initialized = false;
+    }
+
+    /**
+     * Call once per received frame
+     *
+     * @param sample MAX_CHANELS values
+     * @param intervalUs measured time between frames
+     * @param latencyUs measured age of the sample
+     */
+    void newFrame(const float* sample, float intervalUs, float latencyUs) {
+        setInterval(intervalUs);
+        float lead = intervalUs > 0 ? latencyUs / intervalUs : 0;
+        if(lead > 1) lead = 1;
+        for (int i = 0; i < MAX_CHANELS; i++) {
+            float t = sample[i];
+            if(extrapolate && initialized) {
+                t += (sample[i] - last[i]) * lead;
+                if(t < lower[i]) t = lower[i];
+                if(t > upper[i]) t = upper[i];
+            }
+            last[i] = sample[i];
+            target[i] = t;
+            if(!initialized) {
+                stage1[i] = t;
+                stage2[i] = t;
+            }
+        }
+        initialized = true;
+    }
+
+    /**
+     * Advances the filter, call every loop
+     *
+     * @param dt seconds since the last call
+     * @param out MAX_CHANELS values
+     */
+    void update(float dt, float* out) {
+        if(dt <= 0 || tau <= 0) { // no frame yet or no time passed
+            for (int i = 0; i < MAX_CHANELS; i++) out[i] = stage2[i];
+            return;
+        }
+        float alpha = dt / (dt + tau);
+        for (int i = 0; i < MAX_CHANELS; i++) {
+            stage1[i] += (target[i] - stage1[i]) * alpha;
+            stage2[i] += (stage1[i] - stage2[i]) * alpha;
+            out[i] = stage2[i];
+        }
+    }
+
+    /**
+     * @param factor cutoff as a fraction of the frame rate
+     */
+    void setCutoffFactor(float factor) {
+        cutoffFactor = factor;
+        cutoff = 0; // recompute on the next frame
+    }
+
+    float getCutoffFactor() const { return cutoffFactor; }
+    float getCutoff() const { return cutoff; }
+
+private:
+    float lower[MAX_CHANELS];
+    float upper[MAX_CHANELS];
+    float last[MAX_CHANELS] = {};
+    float target[MAX_CHANELS] = {};
+    float stage1[MAX_CHANELS] = {};
+    float stage2[MAX_CHANELS] = {};
+    bool initialized = false;
+
+    float cutoffFactor = 0.25f;
+    float intervalUs = 0;
+    float cutoff = 0;
+    float tau = 0;
+
+    /**
+     * Recomputes the cutoff only if the frame interval changed by more than 10%
+     */
+    void setInterval(float intervalUs) {
+        if(intervalUs <= 0) return;
+        if(cutoff > 0 && fabsf(intervalUs - this->intervalUs) < this->intervalUs * 0.1f) return;
+        this->intervalUs = intervalUs;
+        cutoff = 1000000.0f / intervalUs * cutoffFactor;
+        if(cutoff < minCutoff) cutoff = minCutoff;
+        if(cutoff > maxCutoff) cutoff = maxCutoff;
+        // Two cascaded PT1 reach -3 dB at 1 / 1.554 of their own cutoff
+        tau = 1.0f / (2.0f * (float) M_PI * cutoff * 1.554f);
+    }
+};
@@ -0,0 +1,177 @@
+/**
+ * @file sampleRing.h
+ * @author Timo Lehnertz
+ * @brief Fixed size history of timestamped Vec3 sensor samples
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <Arduino.h>
+
+/**
+ * Read only view over a window of the ring.
+ * Because the window can wrap around the end of the buffer it consists of up to two contiguous segments
+ * Index 0 is the oldest sample of the window
+ */
+template<typename T>
+struct SampleSpan {
+    const T* first = nullptr;
+    size_t firstLength = 0;
+    const T* second = nullptr;
+    size_t secondLength = 0;
+
+    size_t length() const {
+        return firstLength + secondLength;
+    }
+
+    const T& operator[](size_t i) const {
+        return i < firstLength ? first[i] : second[i - firstLength];
+    }
+};
+
+/**
+ * Ring buffer of timestamped samples with one array per axis (SoA)
+ *
+ * Single writer (the sensor implementation), any number of readers.
+ * The writer only publishes the head index after the sample is written, so readers never see half written samples.
+ * Readers that fall more than N samples behind lose the oldest samples, the writer never blocks.
+ *
+ * @tparam N capacity. Has to be a power of two so indices can be masked instead of using modulo
+ */
+template<size_t N>
+class SampleRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SampleRing capacity has to be a power of two");
+public:
+    static constexpr size_t capacity = N;
+    static constexpr uint32_t mask = N - 1;
+
+    /**
+     * Reader position in the stream of samples. Each consumer keeps its own cursor
+     */
+    class Cursor {
+    public:
+        Cursor() : ring(nullptr), position(0) {}
+        Cursor(const SampleRing* ring, uint32_t position) : ring(ring), position(position) {}
+
+        /**
+         * @return number of unread samples. Samples that got overwritten are skipped
+         */
+        size_t available() {
+            uint32_t head = ring->getHead();
+            if(head - position > N) {
+                position = head - N; // overrun
+            }
+            return head - position;
+        }
+
+        /**
+         * Read the next unread sample
+         * @return false if there is no unread sample
+         */
+        bool read(float& x, float& y, float& z, uint64_t& timeUs) {
+            if(available() == 0) return false;
+            uint32_t i = position & mask;
+            x = ring->x[i];
+            y = ring->y[i];
+            z = ring->z[i];
+            timeUs = ring->t[i];
+            position++;
+            return true;
+        }
+
+        /**
+         * Marks all samples as read
+         */
+        void skip() {
+            position = ring->getHead();
+        }
+
+    private:
+        const SampleRing* ring;
+        uint32_t position;
+    };
+
+    void push(float x1, float y1, float z1, uint64_t timeUs) {
+        uint32_t i = head & mask;
+        x[i] = x1;
+        y[i] = y1;
+        z[i] = z1;
+        t[i] = timeUs;
+        __atomic_store_n(&head, head + 1, __ATOMIC_RELEASE); // publish after the data is written
+    }
+
+    /**
+     * @return total number of samples ever pushed (wraps at 2^32)
+     */
+    uint32_t getHead() const {
+        return __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    }
+
+    /**
+     * @return number of valid samples in the ring
+     */
+    size_t getCount() const {
+        uint32_t h = getHead();
+        return h < N ? h : N;
+    }
+
+    /**
+     * Cursor that only sees samples pushed after its creation
+     */
+    Cursor createCursor() const {
+        return Cursor(this, getHead());
+    }
+
+    /**
+     * @param age 0 for the newest sample
+     */
+    float getX(size_t age) const { return x[(getHead() - 1 - age) & mask]; }
+    float getY(size_t age) const { return y[(getHead() - 1 - age) & mask]; }
+    float getZ(size_t age) const { return z[(getHead() - 1 - age) & mask]; }
+    uint64_t getTime(size_t age) const { return t[(getHead() - 1 - age) & mask]; }
+
+    /**
+     * Views over the newest count samples of one axis. No copies are made
+     * @param axis 0 = x, 1 = y, 2 = z
+     */
+    SampleSpan<float> getAxis(int axis, size_t count) const {
+        switch(axis) {
+            case 0: return window(x, count);
+            case 1: return window(y, count);
+            default: return window(z, count);
+        }
+    }
+
+    SampleSpan<uint64_t> getTimes(size_t count) const {
+        return window(t, count);
+    }
+
+private:
+    float x[N];
+    float y[N];
+    float z[N];
+    uint64_t t[N];
+    uint32_t head = 0;
+
+    template<typename T>
+    SampleSpan<T> window(const T* data, size_t count) const {
+        uint32_t h = getHead();
+        size_t valid = h < N ? h : N;
+        if(count > valid) count = valid;
+        SampleSpan<T> span;
+        uint32_t start = (h - count) & mask;
+        if(start + count <= N) {
+            span.first = data + start;
+            span.firstLength = count;
+        } else {
+            span.first = data + start;
+            span.firstLength = N - start;
+            span.second = data;
+            span.secondLength = count - span.firstLength;
+        }
+        return span;
+    }
+};
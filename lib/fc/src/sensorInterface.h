@@ -13,6 +13,12 @@
 #include <flightModes.h>
 #include <maths.h>
 #include <lpf.h>
+#include "sampleRing.h"
+#include "vibrationStats.h"
+#include "gyroFixed.h"
+#include "gyroLowPass.h"
+
+#define VEC3_SENSOR_HISTORY 128 // samples kept per Vec3Sensor. Has to be a power of two
 
 /**
  * General data type for all sensors on board
@@ -20,7 +26,7 @@
  *      error: 0 => OK, 1 => Warning(typically missing calibration but should be possible to fly), 2 => Critical error
  */
 struct Sensor {
-    uint64_t lastChange;
+    uint64_t lastChange; // For timestamped sensors this is the acquisition time of the latest sample
     uint64_t lastPollTime; // Supposed to be measured and set By SensorInterface implementation
     Error::Error_t error;
     FlightMode::FlightMode_t minFlightMode;
@@ -39,6 +45,7 @@ public:
     float x, y, z, lastX, lastY, lastZ;
     int similarCount;
     Vec3 last;
+    SampleRing<VEC3_SENSOR_HISTORY> history; // every accepted sample with its timestamp. Shared by all consumers
     // float lpf = 1.0f;
     
 
@@ -48,10 +55,29 @@ public:
         update(vec.x, vec.y, vec.z);
     }
 
+    void update(Vec3 vec, uint64_t sampleTimeUs) {
+        update(vec.x, vec.y, vec.z, sampleTimeUs);
+    }
+
+    /**
+     * Update without hardware timestamp
+     * The sample is only taken if it differs from the last one and gets stamped with the current time
+     */
     void update(float x1, float y1, float z1) {
-        Vec3 vec(x1, y1, z1);
         if(x1 != x || y1 != y || z1 != z) {
-            lastChange = micros();
+            update(x1, y1, z1, micros());
+        }
+    }
+
+    /**
+     * Update with the acquisition time of the sample (data ready edge or FIFO timestamp) in the micros() time base
+     * Consumers integrate over the difference of these timestamps instead of their own micros() calls
+     */
+    void update(float x1, float y1, float z1, uint64_t sampleTimeUs) {
+        Vec3 vec(x1, y1, z1);
+        if(sampleTimeUs != lastChange) {
+            lastChange = sampleTimeUs;
+            history.push(x1, y1, z1, sampleTimeUs);
             // for (size_t i = 0; i < 1; i++) {
             //     last = lpfs[i].update(vec);
             // }
@@ -203,6 +229,7 @@ struct Ultrasonic : public Sensor {
         this->distance = distance;
         this->speed = speed;
         this->outOfRange = outOfRange;
+        lastChange = micros();
     }
 
     void checkError() {}
@@ -255,12 +282,32 @@ public:
 
     Battery bat;
 
+    /**
+     * Vibration and clipping statistics on raw counts. Axes match acc and gyro
+     */
+    VibrationStats accVibration;
+    VibrationStats gyroVibration;
+
+    /**
+     * Fixed point gyro rates from raw counts. Only fed by sensors that provide counts and only when built with FIXED_POINT_GYRO
+     */
+    GyroRateFixed gyroFixed;
+
+    /**
+     * Low pass on the calibrated float gyro rates. Sensors configure it and gyroFixed from gyroLpfHz at their gyro output rate
+     */
+    GyroLowPass gyroLpf;
+
     float batLpf = 0.0001;
     float batOffset = -0.105;
     float vBatMul = 9.85000;
 
     float accLpf = 1.0f;
-    float gyroLpf = 1.0f;
+
+    /**
+     * Gyro low pass cutoff in Hz, 0 = off. Set over GYRO_LPF and stored
+     */
+    float gyroLpfHz = 0;
 
     SensorInterface() {
         sensors[0] = &acc;
@@ -292,6 +339,11 @@ public:
 
     virtual void calibrateBat(float actualVoltage) = 0;
 
+    /**
+     * Rate at which handle() gets called. Sensors sampling faster than the loop use it to decimate their output
+     */
+    virtual void setLoopFreq(int /*hz*/) {}
+
     /**
      * Find the highest Flight mode that is possible to achieve with the sensors with an equal or lower error that maxError
      */
@@ -0,0 +1,87 @@
+/**
+ * @file thrustCurve.h
+ * @author Timo Lehnertz
+ * @brief Thrust linearisation and per motor calibration compiled into a lookup table
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <math.h>
+
+/**
+ * Per motor correction applied after linearisation.
+ * Motor command at the inputs 0, 0.25, 0.5, 0.75 and 1, linearly interpolated in between.
+ * A weak motor gets values above the identity, a strong one below
+ */
+struct MotorCalibration {
+    static constexpr int POINTS = 5;
+
+    float points[POINTS] = {0.0f, 0.25f, 0.5f, 0.75f, 1.0f};
+};
+
+/**
+ * Maps a thrust fraction 0 - 1 from the mixer to a motor command 0 - 1.
+ *
+ * Props are modelled as thrust = (1 - k) * command + k * command^2 with k = linearization.
+ * k = 0 is a straight line, larger k boosts low commands and keeps PID authority constant over the throttle range.
+ * The inverse followed by the motor calibration is sampled at SIZE points and linearly interpolated.
+ *
+ * Interpolation error against evaluate() with 65 points:
+ *  k 0.5: < 0.0003
+ *  k 0.8: < 0.004 (only near idle)
+ */
+class ThrustCurve {
+public:
+    static constexpr int SIZE = 65;
+    static constexpr float maxLinearization = 0.8f;
+
+    ThrustCurve() {
+        compile(0, MotorCalibration());
+    }
+
+    /**
+     * Exact curve. linearization is clamped to 0 - maxLinearization
+     */
+    static float evaluate(float thrust, float linearization, const MotorCalibration& calibration) {
+        if(linearization < 0) linearization = 0;
+        if(linearization > maxLinearization) linearization = maxLinearization;
+        if(thrust < 0) thrust = 0;
+        if(thrust > 1) thrust = 1;
+        // Solves k * c^2 + (1 - k) * c - thrust = 0 without cancelation, also valid for k = 0
+        float linear = 1.0f - linearization;
+        float command = 2.0f * thrust / (linear + sqrtf(linear * linear + 4.0f * linearization * thrust));
+
+        float pos = command * (MotorCalibration::POINTS - 1);
+        int i = (int) pos;
+        if(i > MotorCalibration::POINTS - 2) i = MotorCalibration::POINTS - 2;
+        return calibration.points[i] + (calibration.points[i + 1] - calibration.points[i]) * (pos - i);
+    }
+
+    /**
+     * Rebuilds the table. Call whenever linearization or calibration change
+     */
+    void compile(float linearization, const MotorCalibration& calibration) {
+        for (int i = 0; i < SIZE; i++) {
+            table[i] = evaluate((float) i / (SIZE - 1), linearization, calibration);
+        }
+    }
+
+    /**
+     * @param thrust 0 - 1, clamped
+     * @return motor command
+     */
+    float lookup(float thrust) const {
+        if(thrust < 0) thrust = 0;
+        if(thrust > 1) thrust = 1;
+        float pos = thrust * (SIZE - 1);
+        int i = (int) pos;
+        if(i > SIZE - 2) i = SIZE - 2;
+        return table[i] + (table[i + 1] - table[i]) * (pos - i);
+    }
+
+private:
+    float table[SIZE];
+};
@@ -0,0 +1,104 @@
+/**
+ * @file vibrationStats.h
+ * @author Timo Lehnertz
+ * @brief Streaming vibration and clipping statistics on raw IMU counts
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <Arduino.h>
+#include <math.h>
+
+/**
+ * Per axis statistics updated with every raw sample:
+ *      rms:            exponential moving RMS of the deviation from the moving mean (vibration level)
+ *      decaying max:   largest deviation from the mean, decaying with a time constant of one second
+ *      peak:           largest absolute raw reading since the last resetPeaks() (headroom to the sensor range)
+ *      clip count:     samples at or beyond the configured range
+ *
+ * update() costs a few multiply adds per axis. Square roots and scaling to units only happen in the getters
+ */
+class VibrationStats {
+public:
+
+    /**
+     * @param clipLimit absolute count at which a reading is considered clipped
+     * @param unitsPerCount deg/s or G per count
+     * @param sampleRateHz rate at which update() gets called. Used for the time constants
+     */
+    void configure(int32_t clipLimit, float unitsPerCount, float sampleRateHz) {
+        this->clipLimit = clipLimit;
+        this->unitsPerCount = unitsPerCount;
+        alpha = 1.0f / (rmsTimeConstantS * sampleRateHz);
+        if(alpha > 1.0f) alpha = 1.0f;
+        decay = 1.0f - 1.0f / (maxTimeConstantS * sampleRateHz);
+        if(decay < 0.0f) decay = 0.0f;
+    }
+
+    void update(int32_t x, int32_t y, int32_t z) {
+        updateAxis(axes[0], x);
+        updateAxis(axes[1], y);
+        updateAxis(axes[2], z);
+    }
+
+    float getRms(int axis) const { return sqrtf(axes[axis].meanSquare) * unitsPerCount; }
+    float getDecayingMax(int axis) const { return axes[axis].decayingMax * unitsPerCount; }
+    float getPeak(int axis) const { return axes[axis].peak * unitsPerCount; }
+    uint32_t getClipCount(int axis) const { return axes[axis].clipCount; }
+
+    float getMaxRms() const { return max(getRms(0), max(getRms(1), getRms(2))); }
+    float getMaxDecayingMax() const { return max(getDecayingMax(0), max(getDecayingMax(1), getDecayingMax(2))); }
+    float getMaxPeak() const { return max(getPeak(0), max(getPeak(1), getPeak(2))); }
+    uint32_t getTotalClipCount() const { return axes[0].clipCount + axes[1].clipCount + axes[2].clipCount; }
+
+    void resetPeaks() {
+        for (size_t i = 0; i < 3; i++) {
+            axes[i].peak = 0;
+        }
+    }
+
+    void reset() {
+        for (size_t i = 0; i < 3; i++) {
+            axes[i] = Axis();
+        }
+    }
+
+private:
+    struct Axis {
+        bool initialized = false;
+        float mean = 0;
+        float meanSquare = 0;
+        float decayingMax = 0;
+        float peak = 0;
+        uint32_t clipCount = 0;
+    };
+
+    static constexpr float rmsTimeConstantS = 0.1f;
+    static constexpr float maxTimeConstantS = 1.0f;
+
+    Axis axes[3];
+    int32_t clipLimit = 32767;
+    float unitsPerCount = 1.0f;
+    float alpha = 0.01f;
+    float decay = 0.999f;
+
+    void updateAxis(Axis& a, int32_t counts) {
+        if(counts >= clipLimit || counts <= -clipLimit) a.clipCount++;
+        float value = counts;
+        if(!a.initialized) {
+            a.mean = value; // no startup transient from gravity or gyro offset
+            a.initialized = true;
+        }
+        float absValue = fabsf(value);
+        if(absValue > a.peak) a.peak = absValue;
+        a.mean += alpha * (value - a.mean);
+        float deviation = value - a.mean;
+        a.meanSquare += alpha * (deviation * deviation - a.meanSquare);
+        float absDeviation = fabsf(deviation);
+        a.decayingMax *= decay;
+        if(absDeviation > a.decayingMax) a.decayingMax = absDeviation;
+    }
+};
@@ -0,0 +1,157 @@
+/**
+ * @file decimator.h
+ * @author Timo Lehnertz
+ * @brief CIC / boxcar decimation of integer sensor counts
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <Arduino.h>
+
+/**
+ * Cascaded integrator comb decimator for one channel of integer counts
+ *
+ * ORDER 1 is a plain boxcar average over ratio samples. Higher orders give more alias rejection
+ * at the cost of passband droop, which can be flattened with the optional 3 tap compensation filter.
+ * The output is normalized to the input units, so the decimator can be dropped in front of any count based scaling.
+ *
+ * Integrators and combs use wrapping 64 bit arithmetic so the register growth of ORDER * log2(ratio) bits never overflows
+ * for 20 bit inputs.
+ *
+ * @tparam ORDER number of integrator and comb stages (1 to 4)
+ */
+template<int ORDER>
+class CicDecimator {
+    static_assert(ORDER >= 1 && ORDER <= 4, "CicDecimator order has to be between 1 and 4");
+public:
+
+    /**
+     * @param ratio input samples per output sample. 1 passes every sample through
+     * @param compensate enable the droop compensation filter. Adds one output sample of delay
+     */
+    void configure(uint32_t ratio, bool compensate) {
+        if(ratio < 1) ratio = 1;
+        this->ratio = ratio;
+        this->compensate = compensate;
+        gain = 1;
+        for (int i = 0; i < ORDER; i++) {
+            gain *= ratio;
+        }
+        reset();
+    }
+
+    void reset() {
+        for (int i = 0; i < ORDER; i++) {
+            integrators[i] = 0;
+            combs[i] = 0;
+        }
+        phase = 0;
+        history[0] = 0;
+        history[1] = 0;
+        primed = 0;
+    }
+
+    /**
+     * Push one input sample
+     * @param out gets the decimated value when true is returned
+     * @return true every ratio samples
+     */
+    bool push(int32_t in, int32_t& out) {
+        int64_t value = in;
+        for (int i = 0; i < ORDER; i++) {
+            integrators[i] += value;
+            value = integrators[i];
+        }
+        if(++phase < ratio) return false;
+        phase = 0;
+        for (int i = 0; i < ORDER; i++) {
+            int64_t delayed = combs[i];
+            combs[i] = value;
+            value -= delayed;
+        }
+        int32_t decimated = value / gain;
+        if(primed < ORDER) {
+            primed++; // the combs still contain the start of the integration
+            decimated = in;
+            history[0] = in;
+            history[1] = in;
+        }
+        out = compensate ? compensation(decimated) : decimated;
+        return true;
+    }
+
+    uint32_t getRatio() const {
+        return ratio;
+    }
+
+    /**
+     * Group delay in input sample periods, measured from the input sample that completes an output.
+     * Every stage is a boxcar of ratio samples with (ratio - 1) / 2 delay, the compensation filter adds one output sample
+     */
+    float getGroupDelay() const {
+        return ORDER * (ratio - 1) * 0.5f + (compensate ? ratio : 0);
+    }
+
+private:
+    int64_t integrators[ORDER];
+    int64_t combs[ORDER];
+    int64_t gain = 1;
+    uint32_t ratio = 1;
+    uint32_t phase = 0;
+    int primed = 0;
+    bool compensate = false;
+    int32_t history[2];
+
+    /**
+     * Inverse sinc approximation [-1, 18, -1] / 16 running at the output rate
+     */
+    int32_t compensation(int32_t in) {
+        int32_t out = (18 * (int64_t) history[0] - history[1] - in) / 16;
+        history[1] = history[0];
+        history[0] = in;
+        return out;
+    }
+};
+
+/**
+ * Decimator for the three axes of an imu sensor. All axes share the same phase
+ */
+template<int ORDER>
+class CicDecimatorVec3 {
+public:
+    void configure(uint32_t ratio, bool compensate) {
+        for (int i = 0; i < 3; i++) {
+            axes[i].configure(ratio, compensate);
+        }
+    }
+
+    void reset() {
+        for (int i = 0; i < 3; i++) {
+            axes[i].reset();
+        }
+    }
+
+    /**
+     * @return true if out holds a new decimated sample
+     */
+    bool push(const int32_t in[3], int32_t out[3]) {
+        bool ready = axes[0].push(in[0], out[0]);
+        axes[1].push(in[1], out[1]);
+        axes[2].push(in[2], out[2]);
+        return ready;
+    }
+
+    uint32_t getRatio() const {
+        return axes[0].getRatio();
+    }
+
+    float getGroupDelay() const {
+        return axes[0].getGroupDelay();
+    }
+
+private:
+    CicDecimator<ORDER> axes[3];
+};
@@ -1,4 +1,5 @@
 #include "lpf.h"
+#include <fastMath.h>
 
 LowPassFilter::LowPassFilter():
 	output(0),
@@ -6,7 +7,7 @@ LowPassFilter::LowPassFilter():
 
 LowPassFilter::LowPassFilter(float iCutOffFrequency, float iDeltaTime):
 	output(0),
-	ePow(1-exp(-iDeltaTime * 2 * PI * iCutOffFrequency)),
+	ePow(1-FastTrig::exp(-iDeltaTime * 2 * PI * iCutOffFrequency)),
 	freq(iCutOffFrequency)
 {}
 
@@ -20,7 +21,7 @@ float LowPassFilter::update(float input, float deltaTime, float cutoffFrequency)
 }
 
 void LowPassFilter::reconfigureFilter(float deltaTime, float cutoffFrequency){
-	ePow = 1-exp(-deltaTime * 2 * PI * cutoffFrequency);
+	ePow = 1-FastTrig::exp(-deltaTime * 2 * PI * cutoffFrequency);
 	freq = cutoffFrequency;
 }
 
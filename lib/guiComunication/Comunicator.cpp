@@ -82,7 +82,9 @@ void Comunicator::handleLED() {
     return;
     // if(fc->isArmed()) {
       // double angle = min(ins->getMaxAngleDeg(), 5);
-      double angle = angleFromCoordinate(ins->sensors->gps.lat, ins->sensors->gps.lng, ins->complementaryFilter.centerLat, ins->complementaryFilter.centerLng);
+      float homeBearing;
+      ins->complementaryFilter.origin.toOrigin(ins->sensors->gps.lat, ins->sensors->gps.lng, homeBearing);
+      double angle = 360 - homeBearing; // counter-clockwise like yaw
       // Serial.println(ins->getYaw() * RAD_TO_DEG);
       // Serial.println(angleFromTo(360, 0));
       // Serial.println(angle);
@@ -337,6 +339,8 @@ void Comunicator::handleMsp() {
           fc->rateRollPID.dlpf  = mspBuff[32] / 100.0;
           fc->ratePitchPID.dlpf = mspBuff[34] / 100.0;
           fc->rateYawPID.dlpf   = mspBuff[36] / 100.0;
+          // Feedforward in the d_min slots, the F slots are taken by dlpf
+          fc->feedforwardGain = Vec3(mspBuff[39] / 100000.0, mspBuff[40] / 100000.0, mspBuff[41] / 100000.0);
         } else if(fc->flightMode == FlightMode::level) {
           fc->levelRollPID.dlpf  = mspBuff[32] / 100.0;
           fc->levelPitchPID.dlpf = mspBuff[34] / 100.0;
@@ -359,6 +363,9 @@ void Comunicator::handleMsp() {
           payload[32] = fc->rateRollPID.dlpf * 100.0;
           payload[34] = fc->ratePitchPID.dlpf * 100.0;
           payload[36] = fc->rateYawPID.dlpf * 100.0;
+          payload[39] = constrain(round(fc->feedforwardGain.x * 100000.0), 0, 255);
+          payload[40] = constrain(round(fc->feedforwardGain.y * 100000.0), 0, 255);
+          payload[41] = constrain(round(fc->feedforwardGain.z * 100000.0), 0, 255);
         } else if(fc->flightMode == FlightMode::level) {
           payload[32] = fc->levelRollPID.dlpf * 100.0;
           payload[34] = fc->levelPitchPID.dlpf * 100.0;
@@ -416,6 +423,7 @@ void Comunicator::handleMsp() {
         fc->yawRate.setRc (mspBuff[11] / 100.0);
         fc->yawRate.setRCExpo(mspBuff[10] / 100.0);
         fc->yawRate.setSuper(mspBuff[4] / 100.0);
+        fc->compileRates();
         break;
       }
       case MSP_STATUS: {
@@ -519,12 +527,14 @@ void Comunicator::postTelemetry() {
     postSensorDataInt("TIME", "FC Us", fcTime - chanelsTime);
     postSensorData("CPU Load", "", cpuLoad);
     postSensorDataInt("Loop time Us", "", loopTimeUs);
+    postSensorDataInt("Sample age Us", "Gyro", fc->sampleAgeUs);
     postSensorDataInt("Sensor Poll Us", "Acc", sensors->acc.lastPollTime);
     postSensorDataInt("Sensor Poll Us", "Gyro", sensors->gyro.lastPollTime);
     postSensorDataInt("Sensor Poll Us", "Mag", sensors->mag.lastPollTime);
     postSensorDataInt("Sensor Poll Us", "Baro", sensors->baro.lastPollTime);
     postSensorDataInt("Sensor Poll Us", "GPS", sensors->gps.lastPollTime);
     postSensorDataInt("Max Loop Time", "Us", maxLoopTime);
+    postSensorDataInt("TIME", "Shadow Us", shadowTime);
     postSensorDataInt("Min Freq", "Hz", 1000000.0f / maxLoopTime);
   }
   if(useRCTelem) {
@@ -566,6 +576,35 @@ void Comunicator::postTelemetry() {
     postSensorData("Ultrasonic", "distance", sensors->ultrasonic.distance);
     postSensorData("Ultrasonic", "speed(ms)", sensors->ultrasonic.speed);
   }
+  if(useVibTelem) {
+    postSensorData("VIB Gyro RMS", "X", sensors->gyroVibration.getRms(0));
+    postSensorData("VIB Gyro RMS", "Y", sensors->gyroVibration.getRms(1));
+    postSensorData("VIB Gyro RMS", "Z", sensors->gyroVibration.getRms(2));
+    postSensorData("VIB Gyro", "Max", sensors->gyroVibration.getMaxDecayingMax());
+    postSensorData("VIB Gyro", "Peak", sensors->gyroVibration.getMaxPeak());
+    postSensorDataInt("VIB Gyro", "Clip", sensors->gyroVibration.getTotalClipCount());
+    postSensorData("VIB Acc RMS", "X", sensors->accVibration.getRms(0));
+    postSensorData("VIB Acc RMS", "Y", sensors->accVibration.getRms(1));
+    postSensorData("VIB Acc RMS", "Z", sensors->accVibration.getRms(2));
+    postSensorData("VIB Acc", "Max", sensors->accVibration.getMaxDecayingMax());
+    postSensorData("VIB Acc", "Peak", sensors->accVibration.getMaxPeak());
+    postSensorDataInt("VIB Acc", "Clip", sensors->accVibration.getTotalClipCount());
+  }
+  if(useShadowTelem && ins->isShadowActive()) {
+    const FusionComparator& shadow = ins->shadowComparator;
+    postSensorData("SHADOW Diff", "Roll", shadow.getLast(0));
+    postSensorData("SHADOW Diff", "Pitch", shadow.getLast(1));
+    postSensorData("SHADOW Diff", "Yaw", shadow.getLast(2));
+    postSensorData("SHADOW RMS", "Roll", shadow.getRms(0));
+    postSensorData("SHADOW RMS", "Pitch", shadow.getRms(1));
+    postSensorData("SHADOW RMS", "Yaw", shadow.getRms(2));
+    postSensorData("SHADOW Max", "Roll", shadow.getMax(0));
+    postSensorData("SHADOW Max", "Pitch", shadow.getMax(1));
+    postSensorData("SHADOW Max", "Yaw", shadow.getMax(2));
+    postSensorDataInt("SHADOW", "Samples", shadow.getSamples());
+    postSensorDataInt("SHADOW", "Skipped", shadow.getSkipped());
+    postSensorDataInt("SHADOW", "Worst Us", shadow.getWorstUs());
+  }
 }
 
 void Comunicator::end() {
@@ -681,11 +720,17 @@ void Comunicator::processSerialLine() {
       postResponse(uid, sensors->acc.getLpfFreq(0));
     }
     if(strncmp("GYRO_LPF", command,7) == 0) {
-      postResponse(uid, sensors->gyro.getLpfFreq(0));
+      postResponse(uid, sensors->gyroLpfHz);
     }
     if(strncmp("COMPLEMENTARY_ACC_INF", command, 21) == 0) {
       postResponse(uid, ins->complementaryFilter.accInfluence);
     }
+    if(strncmp("COMPLEMENTARY_ACC_HZ", command, 20) == 0) {
+      postResponse(uid, ins->complementaryFilter.accCorrectionHz);
+    }
+    if(strncmp("COMPLEMENTARY_MAG_HZ", command, 20) == 0) {
+      postResponse(uid, ins->complementaryFilter.magCorrectionHz);
+    }
     if(strncmp("USE_ACC_TELEM", command, 13) == 0) {
       postResponse(uid, useAccTelem);
     }
@@ -728,17 +773,8 @@ void Comunicator::processSerialLine() {
     if(strncmp("OVERWRITE_MOTORS", command, 16) == 0) {
       postResponse(uid, motorOverwrite);
     }
-    if(strncmp("M1_OVERWRITE", command, 12) == 0) {
-      postResponse(uid, motorFL);
-    }
-    if(strncmp("M2_OVERWRITE", command, 12) == 0) {
-      postResponse(uid, motorFR);
-    }
-    if(strncmp("M3_OVERWRITE", command, 12) == 0) {
-      postResponse(uid, motorBL);
-    }
-    if(strncmp("M4_OVERWRITE", command, 12) == 0) {
-      postResponse(uid, motorBR);
+    if(isMotorOverwriteCommand(command)) { // M1_OVERWRITE - M8_OVERWRITE
+      postResponse(uid, motorOverwriteValues[command[1] - '1']);
     }
     if(strncmp("PROPS_IN", command, 8) == 0) {
       postResponse(uid, fc->propsIn);
@@ -797,6 +833,34 @@ void Comunicator::processSerialLine() {
     if(strncmp("I_RELAX_MIN_RATE", command, 16) == 0) {
       postResponse(uid, fc->iRelaxMinRate);
     }
+    if(strncmp("FEEDFORWARD_GAIN", command, 16) == 0) { // ,roll,pitch,yaw,
+      postResponse(uid, fc->feedforwardGain);
+    }
+    if(strncmp("FEEDFORWARD_STATIC", command, 18) == 0) { // ,roll,pitch,yaw,
+      postResponse(uid, fc->feedforwardStatic);
+    }
+    if(strncmp("FEEDFORWARD_DEADBAND", command, 20) == 0) {
+      postResponse(uid, fc->feedforwardDeadband);
+    }
+
+    if(strncmp("USE_RC_SMOOTHING", command, 16) == 0) {
+      postResponse(uid, fc->useRcSmoothing);
+    }
+    if(strncmp("USE_RC_EXTRAPOLATION", command, 20) == 0) {
+      postResponse(uid, fc->rcSmoothing.extrapolate);
+    }
+    if(strncmp("RC_SMOOTHING_FACTOR", command, 19) == 0) {
+      postResponse(uid, fc->rcSmoothing.getCutoffFactor());
+    }
+    if(strncmp("RC_SMOOTHING_CUTOFF", command, 19) == 0) { // Hz, read only
+      postResponse(uid, fc->rcSmoothing.getCutoff());
+    }
+    if(strncmp("RC_FRAME_INTERVAL", command, 17) == 0) { // us, read only
+      postResponse(uid, crsf->getFrameIntervalUs());
+    }
+    if(strncmp("RC_LATENCY", command, 10) == 0) { // us, read only
+      postResponse(uid, crsf->getFrameLatencyUs());
+    }
 
     if(strncmp("USE_ANTI_GRAVITY", command, 16) == 0) {
       postResponse(uid, fc->useAntiGravity);
@@ -828,6 +892,9 @@ void Comunicator::processSerialLine() {
     if(strncmp("SENSOR_FUSION", command, 13) == 0) {
       postResponse(uid, ins->getFusionAlgorythm());
     }
+    if(strncmp("SHADOW_FUSION", command, 13) == 0) {
+      postResponse(uid, ins->getShadowAlgorythm());
+    }
     if(strncmp("ANGLE_MODE_MAX_ANGLE", command, 20) == 0) {
       postResponse(uid, fc->angleModeMaxAngle);
     }
@@ -867,6 +934,15 @@ void Comunicator::processSerialLine() {
     if(strncmp("USE_ULTRASONIC_TELEM", command, 20) == 0) {
       postResponse(uid, useUltrasonicTelem);
     }
+    if(strncmp("USE_VIB_TELEM", command, 13) == 0) {
+      postResponse(uid, useVibTelem);
+    }
+    if(strncmp("USE_SHADOW_TELEM", command, 16) == 0) {
+      postResponse(uid, useShadowTelem);
+    }
+    if(strncmp("USE_CRSF_VIB_TELEM", command, 18) == 0) {
+      postResponse(uid, useCrsfVibTelem);
+    }
     if(strncmp("M1_PIN", command, 6) == 0) {
       postResponse(uid, fc->getMotorPin(1));
     }
@@ -885,6 +961,24 @@ void Comunicator::processSerialLine() {
     if(strncmp("THROTTLE_MUL_6S", command,15) == 0) {
       postResponse(uid, fc->throttleMul6S);
     }
+    if(strncmp("MIXER_MOTOR_COUNT", command, 17) == 0) {
+      postResponse(uid, fc->getMixer().motorCount);
+    }
+    if(strncmp("MIXER_RULE_", command, 11) == 0) { // MIXER_RULE_1 - MIXER_RULE_8
+      int motor = command[11] - '1';
+      if(motor >= 0 && motor < Mixer::maxMotors) {
+        postResponse(uid, fc->getMixer().rules[motor]);
+      }
+    }
+    if(strncmp("THRUST_LINEARIZATION", command, 20) == 0) {
+      postResponse(uid, fc->thrustLinearization);
+    }
+    if(strncmp("MOTOR_CALIBRATION_", command, 18) == 0) { // MOTOR_CALIBRATION_1 - MOTOR_CALIBRATION_8
+      int motor = command[18] - '1';
+      if(motor >= 0 && motor < Mixer::maxMotors) {
+        postResponse(uid, fc->motorCalibrations[motor]);
+      }
+    }
   }
 
   // FC_DO
@@ -990,12 +1084,20 @@ void Comunicator::processSerialLine() {
     }
     if(strncmp("GYRO_LPF", command, 8) == 0) {
       postResponse(uid, value);
-      sensors->gyro.setLpf(0, 1.0 / loopFreqRate, atoi(value));
+      sensors->gyroLpfHz = atof(value); // Hz, 0 = off
     }
     if(strncmp("COMPLEMENTARY_ACC_INF", command, 21) == 0) {
       postResponse(uid, value);
       ins->complementaryFilter.accInfluence = atof(value);
     }
+    if(strncmp("COMPLEMENTARY_ACC_HZ", command, 20) == 0) {
+      postResponse(uid, value);
+      ins->complementaryFilter.accCorrectionHz = max(0.0f, (float) atof(value));
+    }
+    if(strncmp("COMPLEMENTARY_MAG_HZ", command, 20) == 0) {
+      postResponse(uid, value);
+      ins->complementaryFilter.magCorrectionHz = max(0.0f, (float) atof(value));
+    }
     if(strncmp("ACC_TELEM", command, 9) == 0) {
       postResponse(uid, value);
       useAccTelem = value[0] == 't';
@@ -1056,21 +1158,9 @@ void Comunicator::processSerialLine() {
       postResponse(uid, value);
       motorOverwrite = value[0] == 't';
     }
-    if(strncmp("M1_OVERWRITE", command, 12) == 0) {
+    if(isMotorOverwriteCommand(command)) {
       postResponse(uid, value);
-      motorFL = atoi(value);
-    }
-    if(strncmp("M2_OVERWRITE", command, 12) == 0) {
-      postResponse(uid, value);
-      motorFR = atoi(value);
-    }    
-    if(strncmp("M3_OVERWRITE", command, 12) == 0) {
-      postResponse(uid, value);
-      motorBL = atoi(value);
-    }
-    if(strncmp("M4_OVERWRITE", command, 12) == 0) {
-      postResponse(uid, value);
-      motorBR = atoi(value);
+      motorOverwriteValues[command[1] - '1'] = atoi(value);
     }
     if(strncmp("PROPS_IN", command, 8) == 0) {
       postResponse(uid, value);
@@ -1093,6 +1183,7 @@ void Comunicator::processSerialLine() {
       postResponse(uid, value);
       loopFreqRate = atoi(value);
       if(loopFreqRate < 10) loopFreqRate = 10;
+      sensors->setLoopFreq(loopFreqRate);
     }
     if(strncmp("LOOP_FREQ_LEVEL", command, 15) == 0) {
       postResponse(uid, value);
@@ -1150,6 +1241,31 @@ void Comunicator::processSerialLine() {
       postResponse(uid, value);
       fc->iRelaxMinRate = atof(value);
     }
+    if(strncmp("FEEDFORWARD_GAIN", command, 16) == 0) {
+      postResponse(uid, value);
+      fc->feedforwardGain = Vec3(value);
+    }
+    if(strncmp("FEEDFORWARD_STATIC", command, 18) == 0) {
+      postResponse(uid, value);
+      fc->feedforwardStatic = Vec3(value);
+    }
+    if(strncmp("FEEDFORWARD_DEADBAND", command, 20) == 0) {
+      postResponse(uid, value);
+      fc->feedforwardDeadband = atof(value);
+    }
+
+    if(strncmp("USE_RC_SMOOTHING", command, 16) == 0) {
+      postResponse(uid, value);
+      fc->useRcSmoothing = value[0] == 't';
+    }
+    if(strncmp("USE_RC_EXTRAPOLATION", command, 20) == 0) {
+      postResponse(uid, value);
+      fc->rcSmoothing.extrapolate = value[0] == 't';
+    }
+    if(strncmp("RC_SMOOTHING_FACTOR", command, 19) == 0) {
+      postResponse(uid, value);
+      fc->rcSmoothing.setCutoffFactor(atof(value));
+    }
 
     if(strncmp("USE_ANTI_GRAVITY", command, 16) == 0) {
       postResponse(uid, value);
@@ -1202,7 +1318,11 @@ void Comunicator::processSerialLine() {
     }
     if(strncmp("SENSOR_FUSION", command, 13) == 0) {
       postResponse(uid, value);
-      ins->setFusionAlgorythm(SensorFusion::FusionAlgorythm(int(value)));
+      ins->setFusionAlgorythm(SensorFusion::FusionAlgorythm(atoi(value)));
+    }
+    if(strncmp("SHADOW_FUSION", command, 13) == 0) {
+      postResponse(uid, value);
+      ins->setShadowAlgorythm(atoi(value)); // -1 disables. Setting it again restarts the statistics
     }
     if(strncmp("ANGLE_MODE_MAX_ANGLE", command, 20) == 0) {
       postResponse(uid, value);
@@ -1235,14 +1355,17 @@ void Comunicator::processSerialLine() {
     if(strncmp("ROLL_RATES", command, 10) == 0) {
       postResponse(uid, value);
       fc->rollRate = Rates(value);
+      fc->compileRates();
     }
     if(strncmp("PITCH_RATES", command, 11) == 0) {
       postResponse(uid, value);
       fc->pitchRate = Rates(value);
+      fc->compileRates();
     }
     if(strncmp("YAW_RATES", command, 9) == 0) {
       postResponse(uid, value);
       fc->yawRate = Rates(value);
+      fc->compileRates();
     }
     if(strncmp("MAG_Z_OFFSET", command, 12) == 0) {
       postResponse(uid, value);
@@ -1252,6 +1375,18 @@ void Comunicator::processSerialLine() {
       postResponse(uid, value);
       useUltrasonicTelem = value[0] == 't';
     }
+    if(strncmp("USE_VIB_TELEM", command, 13) == 0) {
+      postResponse(uid, value);
+      useVibTelem = value[0] == 't';
+    }
+    if(strncmp("USE_SHADOW_TELEM", command, 16) == 0) {
+      postResponse(uid, value);
+      useShadowTelem = value[0] == 't';
+    }
+    if(strncmp("USE_CRSF_VIB_TELEM", command, 18) == 0) {
+      postResponse(uid, value);
+      useCrsfVibTelem = value[0] == 't';
+    }
     if(strncmp("M1_PIN", command, 6) == 0) {
       postResponse(uid, value);
       fc->setMotorPin(1, atoi(value));
@@ -1276,9 +1411,141 @@ void Comunicator::processSerialLine() {
       postResponse(uid, value);
       fc->throttleMul6S = atof(value);
     }
+    if(strncmp("MIXER_MOTOR_COUNT", command, 17) == 0) {
+      postResponse(uid, value);
+      Mixer mixer = fc->getMixer();
+      mixer.motorCount = atoi(value);
+      if(!fc->setMixer(mixer)) {
+        Serial.println("Mixer rejected: armed, invalid or not matching the wired motor count");
+      }
+    }
+    if(strncmp("MIXER_RULE_", command, 11) == 0) { // ,throttle,roll,pitch,yaw,
+      postResponse(uid, value);
+      int motor = command[11] - '1';
+      Mixer mixer = fc->getMixer();
+      if(motor >= 0 && motor < Mixer::maxMotors && parseMixerRule(value, mixer.rules[motor])) {
+        if(!fc->setMixer(mixer)) {
+          Serial.println("Mixer rejected: armed, invalid or not matching the wired motor count");
+        }
+      }
+    }
+    if(strncmp("MIXER_PRESET", command, 12) == 0) { // QUAD_X, HEX_X, OCTO_X
+      postResponse(uid, value);
+      Mixer mixer = fc->getMixer();
+      if(strncmp("QUAD_X", value, 6) == 0) mixer = Mixer::quadX();
+      if(strncmp("HEX_X", value, 5) == 0)  mixer = Mixer::hexX();
+      if(strncmp("OCTO_X", value, 6) == 0) mixer = Mixer::octoX();
+      if(!fc->setMixer(mixer)) {
+        Serial.println("Mixer rejected: armed, invalid or not matching the wired motor count");
+      }
+    }
+    if(strncmp("THRUST_LINEARIZATION", command, 20) == 0) {
+      postResponse(uid, value);
+      fc->thrustLinearization = constrain((float) atof(value), 0.0f, (float) ThrustCurve::maxLinearization);
+      fc->compileThrustCurves();
+    }
+    if(strncmp("MOTOR_CALIBRATION_", command, 18) == 0) { // ,p0,p1,p2,p3,p4, commands at 0, 25, 50, 75, 100%
+      postResponse(uid, value);
+      int motor = command[18] - '1';
+      MotorCalibration cal;
+      if(motor >= 0 && motor < Mixer::maxMotors && parseMotorCalibration(value, cal)) {
+        fc->motorCalibrations[motor] = cal;
+        fc->compileThrustCurves();
+      }
+    }
   }
 }
 
+/**
+ * M1_OVERWRITE - M8_OVERWRITE, motors in mixer order
+ */
+bool Comunicator::isMotorOverwriteCommand(const char* command) {
+  return command[0] == 'M' && command[1] >= '1' && command[1] < '1' + Mixer::maxMotors && strncmp("_OVERWRITE", command + 2, 10) == 0;
+}
+
+bool Comunicator::parseMixerRule(char* str, MixerRule& rule) {
+  float* values[4] = {&rule.throttle, &rule.roll, &rule.pitch, &rule.yaw};
+  char* pos = str;
+  for (int i = 0; i < 4; i++) {
+    while(*pos == ',' || *pos == ' ') pos++;
+    char* end;
+    float v = strtod(pos, &end);
+    if(end == pos) {
+      Serial.println("Mixer rule was formatted wrongly");
+      return false;
+    }
+    *values[i] = v;
+    pos = end;
+  }
+  return true;
+}
+
+bool Comunicator::parseMotorCalibration(char* str, MotorCalibration& cal) {
+  char* pos = str;
+  for (int i = 0; i < MotorCalibration::POINTS; i++) {
+    while(*pos == ',' || *pos == ' ') pos++;
+    char* end;
+    float v = strtod(pos, &end);
+    if(end == pos || v != v) {
+      Serial.println("Motor calibration was formatted wrongly");
+      return false;
+    }
+    cal.points[i] = v;
+    pos = end;
+  }
+  return true;
+}
+
+void Comunicator::postResponse(char* uid, MotorCalibration cal) {
+  Serial.print("FC_RES ");
+  Serial.print(uid);
+  Serial.print(" ");
+  Serial.print(",");
+  for (int i = 0; i < MotorCalibration::POINTS; i++) {
+    Serial.print(cal.points[i], 5);
+    Serial.print(",");
+  }
+  Serial.println();
+
+  Serial2.print("FC_RES ");
+  Serial2.print(uid);
+  Serial2.print(" ");
+  Serial2.print(",");
+  for (int i = 0; i < MotorCalibration::POINTS; i++) {
+    Serial2.print(cal.points[i], 5);
+    Serial2.print(",");
+  }
+  Serial2.println();
+}
+
+void Comunicator::postResponse(char* uid, MixerRule rule) {
+  Serial.print("FC_RES ");
+  Serial.print(uid);
+  Serial.print(" ");
+  Serial.print(",");
+  Serial.print(rule.throttle, 5);
+  Serial.print(",");
+  Serial.print(rule.roll, 5);
+  Serial.print(",");
+  Serial.print(rule.pitch, 5);
+  Serial.print(",");
+  Serial.print(rule.yaw, 5);
+  Serial.println(",");
+
+  Serial2.print("FC_RES ");
+  Serial2.print(uid);
+  Serial2.print(" ");
+  Serial2.print(",");
+  Serial2.print(rule.throttle, 5);
+  Serial2.print(",");
+  Serial2.print(rule.roll, 5);
+  Serial2.print(",");
+  Serial2.print(rule.pitch, 5);
+  Serial2.print(",");
+  Serial2.print(rule.yaw, 5);
+  Serial2.println(",");
+}
+
 void Comunicator::postResponse(char* uid, Vec3 vec) {
   Serial.print("FC_RES ");
   Serial.print(uid);
@@ -1441,8 +1708,10 @@ void Comunicator::saveEEPROM() {
 
   Storage::write(FloatValues::accInsInf, ins->complementaryFilter.accInfluence);
   Storage::write(FloatValues::magInsInf, ins->complementaryFilter.magInfluence);
+  Storage::write(FloatValues::accCorrectionHz, ins->complementaryFilter.accCorrectionHz);
+  Storage::write(FloatValues::magCorrectionHz, ins->complementaryFilter.magCorrectionHz);
   Storage::write(FloatValues::accLPF, sensors->acc.getLpfFreq(0));
-  Storage::write(FloatValues::gyroLPF, sensors->gyro.getLpfFreq(0));
+  Storage::write(FloatValues::gyroLPF, sensors->gyroLpfHz);
 
   Storage::write(FloatValues::insSensorFusion, ins->getFusionAlgorythm());
   Storage::write(FloatValues::magZOffset, ins->getMagZOffset());
@@ -1455,6 +1724,9 @@ void Comunicator::saveEEPROM() {
   Storage::write(BoolValues::propsIn, fc->propsIn);
   Storage::write(BoolValues::useLeds, useLeds);
   Storage::write(BoolValues::useAntiGravity, fc->useAntiGravity);
+  Storage::write(BoolValues::useRcSmoothing, fc->useRcSmoothing);
+  Storage::write(BoolValues::useRcExtrapolation, fc->rcSmoothing.extrapolate);
+  Storage::write(FloatValues::rcSmoothingFactor, fc->rcSmoothing.getCutoffFactor());
   
   //FC
   Storage::write(FloatValues::angleModeMaxAngle, fc->angleModeMaxAngle);
@@ -1468,6 +1740,14 @@ void Comunicator::saveEEPROM() {
   Storage::write(Vec3Values::rateR, fc->rollRate.toVec3());
   Storage::write(Vec3Values::rateP, fc->pitchRate.toVec3());
   Storage::write(Vec3Values::rateY, fc->yawRate.toVec3());
+  Storage::write(Vec3Values::feedforwardGain, fc->feedforwardGain);
+  Storage::write(Vec3Values::feedforwardStatic, fc->feedforwardStatic);
+  Storage::write(FloatValues::feedforwardDeadband, fc->feedforwardDeadband);
+  Storage::write(MixerValues::motorMixer, fc->getMixer());
+  Storage::write(FloatValues::thrustLinearization, fc->thrustLinearization);
+  for (int i = 0; i < Mixer::maxMotors; i++) {
+    Storage::write((MotorCalibrationValues) i, fc->motorCalibrations[i]);
+  }
 
  //PIDs
   Storage::write(PidValues::ratePidR,   fc->rateRollPID);
@@ -1496,6 +1776,7 @@ void Comunicator::readEEPROM() {
 
   loopFreqRate = Storage::read(FloatValues::loopFreqRate);
   loopFreqLevel = Storage::read(FloatValues::loopFreqLevel);
+  sensors->setLoopFreq(loopFreqRate);
 
   // Sensor Interface calibration
   sensors->setAccCal (Storage::read(Vec3Values::accOffset), Storage::read(Vec3Values::accScale));
@@ -1504,11 +1785,13 @@ void Comunicator::readEEPROM() {
 
   ins->complementaryFilter.accInfluence = Storage::read(FloatValues::accInsInf);
   ins->complementaryFilter.magInfluence = Storage::read(FloatValues::magInsInf);
+  ins->complementaryFilter.accCorrectionHz = Storage::read(FloatValues::accCorrectionHz);
+  ins->complementaryFilter.magCorrectionHz = Storage::read(FloatValues::magCorrectionHz);
   // sensors->acc.lpf = Storage::read(FloatValues::accLPF);
   // sensors->gyro.lpf = Storage::read(FloatValues::gyroLPF);
 
   sensors->acc.setLpf(0, 1.0 / loopFreqRate,  Storage::read(FloatValues::accLPF));
-  sensors->gyro.setLpf(0, 1.0 / loopFreqRate, Storage::read(FloatValues::gyroLPF));
+  sensors->gyroLpfHz = Storage::read(FloatValues::gyroLPF);
 
   ins->setFusionAlgorythm(SensorFusion::FusionAlgorythm(Storage::read(FloatValues::insSensorFusion)));
   ins->setMagZOffset(Storage::read(FloatValues::magZOffset));
@@ -1519,6 +1802,9 @@ void Comunicator::readEEPROM() {
 
   fc->propsIn = Storage::read(BoolValues::propsIn);
   fc->useAntiGravity = Storage::read(BoolValues::useAntiGravity);
+  fc->useRcSmoothing = Storage::read(BoolValues::useRcSmoothing);
+  fc->rcSmoothing.extrapolate = Storage::read(BoolValues::useRcExtrapolation);
+  fc->rcSmoothing.setCutoffFactor(Storage::read(FloatValues::rcSmoothingFactor));
   useLeds = Storage::read(BoolValues::useLeds);
   useCellVoltage = Storage::read(BoolValues::useVCell);
 
@@ -1533,6 +1819,18 @@ void Comunicator::readEEPROM() {
   fc->rollRate            = Rates(Storage::read(Vec3Values::rateR));
   fc->pitchRate           = Rates(Storage::read(Vec3Values::rateP));
   fc->yawRate             = Rates(Storage::read(Vec3Values::rateY));
+  fc->feedforwardGain     = Storage::read(Vec3Values::feedforwardGain);
+  fc->feedforwardStatic   = Storage::read(Vec3Values::feedforwardStatic);
+  fc->feedforwardDeadband = Storage::read(FloatValues::feedforwardDeadband);
+  fc->compileRates();
+  if(!fc->setMixer(Storage::read(MixerValues::motorMixer))) {
+    Serial.println("Stored mixer invalid or not matching the wired motor count, keeping the current mixer");
+  }
+  fc->thrustLinearization = constrain(Storage::read(FloatValues::thrustLinearization), 0.0f, (float) ThrustCurve::maxLinearization);
+  for (int i = 0; i < Mixer::maxMotors; i++) {
+    fc->motorCalibrations[i] = Storage::read((MotorCalibrationValues) i);
+  }
+  fc->compileThrustCurves();
 
   // PIDs
   fc->rateRollPID     = Storage::read(PidValues::ratePidR);
@@ -1569,7 +1867,14 @@ void Comunicator::readEEPROM() {
 void Comunicator::handleCRSFTelem() {
   // vBat, current, mahDraw, remaining Percent
 
-  crsf->updateTelemetryBattery(useCellVoltage ? sensors->bat.vCell : sensors->bat.vBat, fc->gForce, fc->maxGForce, max(0, ((sensors->bat.vCell - 3.3) / 0.9) * 100));
+  float vBat = useCellVoltage ? sensors->bat.vCell : sensors->bat.vBat;
+  int batPercent = max(0, ((sensors->bat.vCell - 3.3) / 0.9) * 100);
+  if(useCrsfVibTelem) {
+    // current: gyro vibration rms in deg/s, fuel: clipped samples
+    crsf->updateTelemetryBattery(vBat, sensors->gyroVibration.getMaxRms(), sensors->gyroVibration.getTotalClipCount() + sensors->accVibration.getTotalClipCount(), batPercent);
+  } else {
+    crsf->updateTelemetryBattery(vBat, fc->gForce, fc->maxGForce, batPercent);
+  }
   crsf->updateTelemetryAttitude(-ins->getRoll(), -ins->getPitch(), ins->getYaw());
   crsf->updateTelemetryGPS(sensors->gps.lat, sensors->gps.lng, ins->getVelocity().getLength2D(), ins->getYaw(), ins->getLocation().getLength2D(), sensors->gps.satelites);
   // crsf->updateTelemetryGPS(sensors->gps.lat, sensors->gps.lng, ins->getVelocity().getLength2D(), ins->getYaw(), ins->getLocation().z, sensors->gps.satelites);
@@ -68,10 +68,7 @@ public:
     void postSensorData(const char* sensorName, PID pid);
 
 	bool motorOverwrite = false;
-	int motorFL = 0;//percentage 0 - 100
-	int motorFR = 0;//percentage 0 - 100
-	int motorBL = 0;//percentage 0 - 100
-	int motorBR = 0;//percentage 0 - 100
+	int motorOverwriteValues[Mixer::maxMotors] = {};//percentage 0 - 100, in mixer order
 
 	uint64_t loopStart = 0;
 	uint64_t crsfTime = 0;
@@ -81,6 +78,7 @@ public:
 	uint64_t chanelsTime = 0;
 	uint64_t fcTime = 0;
 	uint64_t loopEnd = 0;
+	uint64_t shadowTime = 0; // spent on the shadow fusion in idle time, not part of the loop time
 	uint64_t maxLoopTime = 0;
 
 	float cpuLoad = 0;
@@ -99,6 +97,7 @@ public:
 	bool useLeds = false;
 
 	bool useCellVoltage = true;
+	bool useCrsfVibTelem = false; // send gyro vibration and clip count instead of g-force in the crsf battery frame
 
 private:
 
@@ -116,6 +115,8 @@ private:
 	bool useFCTelem = false;
 	bool useBatTelem = false;
 	bool useUltrasonicTelem = false;
+	bool useVibTelem = false;
+	bool useShadowTelem = false;
 
 	uint32_t scMagCalibStart = 0;
 
@@ -145,6 +146,12 @@ private:
     void postResponse(char* uid, bool val);
     void postResponse(char* uid, Matrix3 mat);
     void postResponse(char* uid, PID pid);
+    void postResponse(char* uid, MixerRule rule);
+    void postResponse(char* uid, MotorCalibration cal);
+
+    bool parseMixerRule(char* str, MixerRule& rule);
+    bool isMotorOverwriteCommand(const char* command);
+    bool parseMotorCalibration(char* str, MotorCalibration& cal);
 
     void scheduleTelemetry();
     void postTelemetry();
@@ -157,25 +164,10 @@ private:
 	double angleFromTo(double xDeg, double yDeg) {
 		double x = xDeg * DEG_TO_RAD;
 		double y = yDeg * DEG_TO_RAD;
-		return atan2(sin(y-x), cos(y-x)) * RAD_TO_DEG;
+		float s, c;
+		FastTrig::sincos(y - x, s, c);
+		return FastTrig::atan2(s, c) * RAD_TO_DEG;
 	}
-
-	double angleFromCoordinate(double lat1, double long1, double lat2, double long2) {
-
-        double dLon = (long2 - long1);
-
-        double y = sin(dLon) * cos(lat2);
-        double x = cos(lat1) * sin(lat2) - sin(lat1)
-                * cos(lat2) * cos(dLon);
-
-        double brng = atan2(y, x);
-
-        brng = brng * RAD_TO_DEG;
-        brng = (int) (brng + 360) % 360;
-        brng = 360 - brng; // count degrees counter-clockwise - remove to make clockwise
-
-        return brng;
-    }
 };
 
 #endif
\ No newline at end of file
@@ -12,46 +12,73 @@
 #include "SensorFusion.h"
 #include <sensorInterface.h>
 #include <maths.h>
+#include "VerticalKalman.h"
+#include "DeltaAngle.h"
+#include <geodesy.h>
+#include <fastMath.h>
 
 #define G 9.807
-#define EARTH_CIRCUM 40075000.0 //meters
 
 class ComplementaryFilter : public SensorFusion {
 public:
     ComplementaryFilter(SensorInterface* sensors) : SensorFusion(sensors){}
 
-    float accInfluence = 0.002;
-    float magInfluence = 0.002;
-    double baroAltSpeed = 0;
+    float accInfluence = 0.002; // per accelerometer sample
+    float magInfluence = 0.002; // per magnetometer sample
+    /**
+     * Attitude corrections run at these rates while the gyro is integrated with every sample.
+     * Samples in between get averaged and the influences are compounded over the number of averaged samples,
+     * so the correction per second stays the same. 0 corrects with every sample
+     */
+    float accCorrectionHz = 500;
+    float magCorrectionHz = 50;
+    double baroAltSpeed = 0;    // climb rate of the vertical Kalman filter
     double magZOffsetDeg = 0.0;
-    double baroAltitude = 0;
-    // GPS
-    double centerLat = 0;
-    double centerLng = 0;
+    double baroAltitude = 0;    // baro height since the last altitude reset
+    float baroNoise = 0.5f;             // m
+    float ultrasonicNoise = 0.05f;      // m
+    float ultrasonicMaxDistance = 3.0f; // m
+    // GPS. Origin of the local position, set at the first fix and on every altitude reset (arm)
+    LocalTangentPlane origin;
 
     void begin() {
         // nothing to do
     }
 
     void handle() {
+        // acc and gyro integrate over the time between their sample timestamps
         if(!sensors->acc.isError() && sensors->acc.lastChange != lastAcc) {
-            processAcc(sensors->acc.getVec3(), micros() - lastAccProcessed);
+            processAcc(sensors->acc.getVec3(), getSampleDeltaUs(sensors->acc.lastChange, lastAcc));
             lastAcc = sensors->acc.lastChange;
-            lastAccProcessed = micros();
         }
-        if(!sensors->gyro.isError() && sensors->gyro.lastChange != lastGyro) {
-            processGyro(sensors->gyro.getVec3(), micros() - lastGyroProcessed);
-            lastGyro = sensors->gyro.lastChange;
-            lastGyroProcessed = micros();
+        // every gyro sample since the last update, not only the newest one
+        if(!sensors->gyro.isError() && deltaAngle.collect(sensors->gyro.history) > 0) {
+            processGyro();
+        }
+        if(accSamples > 0 && isCorrectionDue(lastAcc, lastAccCorrection, accCorrectionHz)) {
+            correctAcc(accSum / (double) accSamples, accSamples);
+            accSum = Vec3();
+            accSamples = 0;
+            lastAccCorrection = lastAcc;
         }
         if(!sensors->mag.isError() && sensors->mag.lastChange != lastMag) {
-            processMag(sensors->mag.getVec3());
             lastMag = sensors->mag.lastChange;
+            magSum += sensors->mag.getVec3();
+            magSamples++;
+            if(isCorrectionDue(lastMag, lastMagCorrection, magCorrectionHz)) {
+                processMag(magSum / (double) magSamples, magSamples);
+                magSum = Vec3();
+                magSamples = 0;
+                lastMagCorrection = lastMag;
+            }
         }
         if(!sensors->baro.isError() && sensors->baro.lastChange != lastBaro) {
-            processBaroAltitude(sensors->baro.altitude, micros() - lastBaroProcessed);
+            processBaroAltitude(sensors->baro.altitude);
             lastBaro = sensors->baro.lastChange;
-            lastBaroProcessed = micros();
+        }
+        if(sensors->ultrasonic.lastChange != lastUltrasonic) {
+            processUltrasonic(sensors->ultrasonic);
+            lastUltrasonic = sensors->ultrasonic.lastChange;
         }
         if(!sensors->gps.isError() && sensors->gps.lastChange != lastGPS) {
             processGPS(sensors->gps, micros() - lastGPSProcessed);
@@ -86,22 +113,40 @@ public:
 
 private:
     uint64_t lastAcc = 0;
-    uint64_t lastAccProcessed = 0;
-    uint64_t lastGyro = 0;
-    uint64_t lastGyroProcessed = 0;
+    DeltaAngleAccumulator deltaAngle;
     uint64_t lastMag = 0;
     uint64_t lastMagProcessed = 0;
     uint64_t lastBaro = 0;
-    uint64_t lastBaroProcessed = 0;
+    uint64_t lastUltrasonic = 0;
     uint64_t lastGPS = 0;
     uint64_t lastGPSProcessed = 0;
 
     Vec3 lastMagF = Vec3();
     uint64_t magCounter = 0;
 
+    // samples collected for the next decimated correction
+    Vec3 accSum = Vec3();
+    uint32_t accSamples = 0;
+    uint64_t lastAccCorrection = 0;
+    Vec3 magSum = Vec3();
+    uint32_t magSamples = 0;
+    uint64_t lastMagCorrection = 0;
+
+    // compounded influences for the last sample count. Recomputed only when the count changes
+    uint32_t accInfluenceSamples = 0;
+    float accInfluenceCompounded = 0;
+    float accInfluenceSource = 0;
+    uint32_t magInfluenceSamples = 0;
+    float magInfluenceCompounded = 0;
+    float magInfluenceSource = 0;
+
     double baroOffset = 0;
     double lastRawBaroAltitude = 0;
-    double lastBaroAlt = 0;
+
+    // height, climb rate and accelerometer bias
+    VerticalKalman vertical;
+    bool ultrasonicInRange = false;
+    float groundHeight = 0;
 
     bool useDroneOptimization = true;
     bool headDown = false;
@@ -111,81 +156,86 @@ private:
     double lastLng = 0;
 
 
-    void processAcc(const Vec3 acc, const uint32_t deltaT) {
-        float elapsedSeconds = deltaT / 1000000.0f;
-        //rotation
-        // double limitRad = 70 * DEG_TO_RAD;
+    static bool isCorrectionDue(uint64_t sampleTime, uint64_t lastCorrection, float hz) {
+        return hz <= 0 || lastCorrection == 0 || sampleTime - lastCorrection >= 1000000.0f / hz;
+    }
+
+    /**
+     * Influence of n averaged samples that matches applying the single sample influence n times
+     */
+    static float compoundInfluence(float influence, uint32_t samples, uint32_t& cachedSamples, float& cachedSource, float& cached) {
+        if(samples == 1) return influence;
+        if(samples != cachedSamples || influence != cachedSource) {
+            cached = 1 - pow(1 - influence, samples);
+            cachedSamples = samples;
+            cachedSource = influence;
+        }
+        return cached;
+    }
+
+    /**
+     * Attitude correction from the averaged accelerometer
+     * @param samples number of averaged samples
+     */
+    void correctAcc(const Vec3 acc, uint32_t samples) {
         double g = acc.getLength();
-        // double pitch = rot.toEulerZYX().y;
-        // double roll = rot.toEulerZYX().x;
         float minG = 0.5;
         float maxG = 1.5;
         if(g > minG && g < maxG) { //check if movement is too strong or gimbal lock could interfere
         // if(acc.z > 0 && g > minG && g < maxG) { //check if movement is too strong or gimbal lock could interfere
         // if(pitch > -limitRad && pitch < limitRad && roll > -limitRad && roll < limitRad && g > minG && g < maxG) { //check if movement is too strong or gimbal lock could interfere
+            // Head down
+            Vec3 facing(0,0,1);
+            rot.rotate(facing);
+            headDown = facing.z < 0.1;
+
             Vec3 accCorrected = acc;
             if(useDroneOptimization && !headDown) {
-                accCorrected = Vec3(acc.x, acc.y, sqrt(-pow(acc.x, 2) -pow(acc.y, 2) + 1)); // calculating z assuming that G-Force is equal to 1 => eliminating propeller lift
+                accCorrected = Vec3(acc.x, acc.y, sqrt(1 - acc.x * acc.x - acc.y * acc.y)); // calculating z assuming that G-Force is equal to 1 => eliminating propeller lift
             }
             if(accCorrected.z == accCorrected.z) { // NaN check
-                double accRoll = atan2(accCorrected.y, accCorrected.z); //minus because not beeing aligned with sticks otherwise
-                double accPitch = -atan2(accCorrected.x, sqrt(accCorrected.y*accCorrected.y + accCorrected.z*accCorrected.z));
+                double accRoll = FastTrig::atan2(accCorrected.y, accCorrected.z); //minus because not beeing aligned with sticks otherwise
+                double accPitch = -FastTrig::atan2(accCorrected.x, sqrt(accCorrected.y*accCorrected.y + accCorrected.z*accCorrected.z));
                 Quaternion accRot(EulerRotation(accRoll, accPitch, -rot.toEulerZYX().z));
                 rot.normalize();
                 rot.calibrate();
                 accRot.calibrate();
 
-                rot = Quaternion::lerp(accRot, rot, 1 - accInfluence);
+                float influence = compoundInfluence(accInfluence, samples, accInfluenceSamples, accInfluenceSource, accInfluenceCompounded);
+                rot = Quaternion::lerp(accRot, rot, 1 - influence);
             }
         }
-        //  subtracting gravity
-        Vec3 accel = acc * G;
-        //rotate acceleration
-        rot.rotate(accel);
-        accel -= Vec3(0, 0, G);
-        vel.z += accel.z * elapsedSeconds;
-        
-        // float baroAltitudeInfl = abs(baroAltitude - loc.z) * 0.005;
-
-        // Velocity relaxing
-        // vel.x *= 0.9999;
-        // vel.y *= 0.9999;
-
-        //location
-        // loc += vel * elapsedSeconds;
-
-        // loc.x = 0;
-        // loc.y = 0;
-
-        double baroAltSpdInf = 0.0001;
-        // double baroAltSpdInf = 0.1;
-        double baroAltInf = 0.005;
-
-        loc.z = loc.z * (1 - baroAltInf) + baroAltitude * baroAltInf;
-        vel.z = vel.z * (1 - baroAltSpdInf) + baroAltSpeed * baroAltSpdInf;
     }
 
-    void processGyro(const Vec3 &gyro, uint32_t deltaT) {
-        Vec3 gyroConf = gyro.clone();
-        gyroConf.x *= -1; //align with sticks
+    void processAcc(const Vec3 acc, const uint32_t deltaT) {
         float elapsedSeconds = deltaT / 1000000.0f;
+        accSum += acc;
+        accSamples++;
+        // vertical acceleration in world frame. Only the last row of the rotation matrix is needed
+        double w = rot.w, x = rot.x, y = rot.y, z = rot.z;
+        double accUp = 2.0 * (x * z - w * y) * acc.x + 2.0 * (y * z + w * x) * acc.y + (1.0 - 2.0 * (x * x + y * y)) * acc.z;
+        vertical.predict((accUp - 1.0) * G, elapsedSeconds);
+        loc.z = vertical.getHeight();
+        vel.z = vertical.getClimbRate();
+    }
 
-        //rotation
-        EulerRotation localRotEuler((gyroConf * elapsedSeconds).toRad(), ZYX_EULER);
-        Quaternion localRotQ(localRotEuler);
-        rot.normalize();
-        rot *= localRotQ;
-
-        // Head down
-        Vec3 facing(0,0,1);
-        rot.rotate(facing);
-        headDown = facing.z < 0.1;
+    void processGyro() {
+        Vec3f rotation;
+        float dt;
+        if(deltaAngle.get(rotation, dt)) {
+            DeltaAngleAccumulator::rotate(rot, rotation);
+        }
     }
 
-    void processMag(const Vec3 &mag1) {
+    /**
+     * Heading correction from the averaged magnetometer
+     * @param samples number of averaged samples
+     */
+    void processMag(const Vec3 &mag1, uint32_t samples) {
         Vec3 mag = mag1.clone();
-        float roll = rot.toEulerZYX().x * RAD_TO_DEG;
-        float pitch = rot.toEulerZYX().y * RAD_TO_DEG;
+        EulerRotation attitude = rot.toEulerZYX();
+        float roll = attitude.x * RAD_TO_DEG;
+        float pitch = attitude.y * RAD_TO_DEG;
 
         // @Todo: Tilt compensation
         // Vec3 magFiltered = Vec3();
@@ -195,7 +245,7 @@ private:
         double limDeg = 25;
         if(pitch < limDeg && pitch > -limDeg && roll < limDeg && roll > -limDeg) {
             mag.toUnitLength();
-            EulerRotation euler(rot.toEulerZYX().y, -rot.toEulerZYX().x, 0);
+            EulerRotation euler(attitude.y, -attitude.x, 0);
             euler.rotate(mag);
 
             // Serial.print("FC_S MAG(t);X;");Serial.println(mag.x);
@@ -207,47 +257,57 @@ private:
 
             magRotRad += magZOffsetDeg * DEG_TO_RAD;
 
-            Quaternion magRot(EulerRotation(rot.toEulerZYX().x, -rot.toEulerZYX().y, magRotRad));
-            rot = Quaternion::lerp(magRot, rot, magCounter == 10 ? 0.0 : 1 - magInfluence);
+            Quaternion magRot(EulerRotation(attitude.x, -attitude.y, magRotRad));
+            float influence = compoundInfluence(magInfluence, samples, magInfluenceSamples, magInfluenceSource, magInfluenceCompounded);
+            rot = Quaternion::lerp(magRot, rot, magCounter == 10 ? 0.0 : 1 - influence);
             // magCounter++;
         }
     }
 
-    void processBaroAltitude(const double altitude, const uint32_t deltaT) {
-        float elapsedSeconds = deltaT / 1000000.0f;
+    void processBaroAltitude(const double altitude) {
         lastRawBaroAltitude = altitude;
         if(baroOffset == 0.0) {
             baroOffset = altitude;
         }
-        const double altitudeFiltered = altitude - baroOffset;
-        
-        double lpf = (max(0.1, min(10, abs(baroAltitude - altitudeFiltered))) * 0.04) - 0.001;
-        baroAltitude = lowPassFilter(baroAltitude, altitudeFiltered, lpf);
-        
-        lpf = (max(0.1, min(10, abs(baroAltitude - altitudeFiltered))) * 0.01);
-        baroAltitude = lowPassFilter(baroAltitude, altitudeFiltered, lpf);
-        // baroAltitude = altitudeFiltered;
-
-        if(lastBaroAlt == 0.0) {
-            lastBaroAlt = altitudeFiltered;
+        baroAltitude = altitude - baroOffset;
+        vertical.updateHeight(baroAltitude, baroNoise * baroNoise);
+        baroAltSpeed = vertical.getClimbRate();
+    }
+
+    /**
+     * Ultrasonic measures height above ground. The ground height gets captured when the sensor comes into range,
+     * after that the tilt compensated distance refines the height relative to it
+     */
+    void processUltrasonic(const Ultrasonic& ultrasonic) {
+        if(!ultrasonic.connected || ultrasonic.outOfRange || ultrasonic.distance > ultrasonicMaxDistance) {
+            ultrasonicInRange = false;
+            return;
+        }
+        float cosTilt = attitude.cosRoll * attitude.cosPitch;
+        if(cosTilt < 0.7f) { // more than ~45deg. Echo is unreliable
+            ultrasonicInRange = false;
+            return;
+        }
+        float heightAboveGround = ultrasonic.distance * cosTilt;
+        if(!ultrasonicInRange) {
+            groundHeight = vertical.getHeight() - heightAboveGround;
+            ultrasonicInRange = true;
+            return;
         }
-        double tmpBaroSpd = (baroAltitude - lastBaroAlt) / elapsedSeconds;
-        lpf = (max(0, min(10, abs(baroAltSpeed - tmpBaroSpd))) * 0.001) + 0.01;
-        baroAltSpeed = lowPassFilter(baroAltSpeed, tmpBaroSpd, lpf);
-        // baroAltSpeed = tmpBaroSpd;
-        lastBaroAlt = baroAltitude;
+        vertical.updateHeight(groundHeight + heightAboveGround, ultrasonicNoise * ultrasonicNoise);
     }
 
     void processGPS(GPS gps, uint64_t deltaT) {
         static Vec3 lastGPSloc = Vec3();
         if(gps.locationValid) {
-            if(centerLat == 0) {
-                centerLat = gps.lat;
-                centerLng = gps.lng;
+            if(!origin.hasOrigin()) {
+                origin.setOrigin(gps.lat, gps.lng);
             }
             // double gpsInf = 0.05;
-            loc.y = -(gps.lat - centerLat) * (EARTH_CIRCUM / 360.0);
-            loc.x = (gps.lng - centerLng) * (EARTH_CIRCUM / 360.0) * cos(gps.lng * DEG_TO_RAD);
+            float north, east;
+            origin.toLocal(gps.lat, gps.lng, north, east);
+            loc.y = -north;
+            loc.x = east;
             lastLat = gps.lat;
             lastLng = gps.lng;
             if(lastGPSloc.getLength() != 0) {
@@ -286,7 +346,9 @@ private:
         // from *= DEG_TO_RAD;
         // to *= DEG_TO_RAD;
 
-        double deg = atan2(sin(from-to), cos(from-to)) * RAD_TO_DEG;
+        float s, c;
+        FastTrig::sincos(from - to, s, c);
+        double deg = FastTrig::atan2(s, c) * RAD_TO_DEG;
 
         // Serial.println(deg);
         // return from * RAD_TO_DEG + deg * fact;
@@ -319,10 +381,13 @@ private:
 
     void resetAltitude() {
         baroOffset = lastRawBaroAltitude;
-        lastBaroAlt = baroAltitude;
+        baroAltitude = 0;
         baroAltSpeed = 0;
-        centerLat = lastLat;
-        centerLng = lastLng;
+        vertical.reset(0);
+        ultrasonicInRange = false;
+        if(lastLat != 0 || lastLng != 0) {
+            origin.setOrigin(lastLat, lastLng);
+        }
         loc.z = 0;
         vel.z = 0;
     }
@@ -0,0 +1,123 @@
+/**
+ * @file DeltaAngle.h
+ * @author Timo Lehnertz
+ * @brief Coning compensated integration of all gyro samples between two attitude updates
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <sensorInterface.h>
+
+/**
+ * Delta angle accumulator
+ *
+ * Reads every gyro sample from the sensor history (not only the newest one) and integrates them into a single rotation vector.
+ * Rotations do not commute, so simply adding the angle increments loses the part of the motion where the rotation axis itself rotates
+ * (coning). The second order coning term
+ *      beta += 1/2 * (alpha + dTheta_prev / 6) x dTheta
+ * restores it, so the attitude can be updated once per loop or slower without drifting during fast flips.
+ *
+ * Axes are the ones of the fusion filters: gyro x mirrored to align with the sticks. Angles in rad
+ */
+class DeltaAngleAccumulator {
+public:
+    uint32_t maxGapUs = 100000; // samples further apart are treated as a restart and not integrated
+
+    /**
+     * Integrate all samples that arrived since the last call
+     * @return number of new samples
+     */
+    int collect(const SampleRing<VEC3_SENSOR_HISTORY>& history) {
+        if(!attached) {
+            cursor = history.createCursor();
+            attached = true;
+        }
+        float x, y, z;
+        uint64_t timeUs;
+        int count = 0;
+        while(cursor.read(x, y, z, timeUs)) {
+            count++;
+            uint64_t deltaUs = lastSampleUs == 0 ? 0 : timeUs - lastSampleUs;
+            lastSampleUs = timeUs;
+            if(deltaUs == 0 || deltaUs > maxGapUs) continue;
+            float dt = deltaUs * 0.000001f;
+            add(Vec3f(-x * DEG_TO_RAD * dt, y * DEG_TO_RAD * dt, z * DEG_TO_RAD * dt), dt);
+        }
+        return count;
+    }
+
+    /**
+     * Add one angle increment
+     */
+    void add(const Vec3f& delta, float dt) {
+        // (alpha + last / 6) x dTheta
+        beta += (alpha + lastDelta * (1.0f / 6.0f)).cross(delta) * 0.5f;
+        alpha += delta;
+        lastDelta = delta;
+        duration += dt;
+    }
+
+    /**
+     * Hands out the rotation since the last call and starts a new interval
+     * @param rotation rotation vector in rad
+     * @param dt covered time in seconds
+     * @return false if no samples were integrated
+     */
+    bool get(Vec3f& rotation, float& dt) {
+        if(duration <= 0) return false;
+        rotation = alpha + beta;
+        dt = duration;
+        alpha = Vec3f();
+        beta = Vec3f();
+        duration = 0;
+        return true;
+    }
+
+    /**
+     * Drops everything integrated so far. The next sample starts a new interval
+     */
+    void reset() {
+        alpha = Vec3f();
+        beta = Vec3f();
+        lastDelta = Vec3f();
+        duration = 0;
+        lastSampleUs = 0;
+    }
+
+    /**
+     * exp(rotation / 2), unit length to float precision
+     */
+    static Quaternionf increment(const Vec3f& rotation) {
+        float angle2 = rotation.lengthSquared();
+        float w, s; // cos(angle / 2), sin(angle / 2) / angle
+        if(angle2 < 0.01f) { // below ~6deg the series is exact to float precision
+            w = 1.0f - angle2 * (1.0f / 8.0f) + angle2 * angle2 * (1.0f / 384.0f);
+            s = 0.5f - angle2 * (1.0f / 48.0f) + angle2 * angle2 * (1.0f / 3840.0f);
+        } else {
+            float angle = sqrtf(angle2);
+            w = cosf(angle * 0.5f);
+            s = sinf(angle * 0.5f) / angle;
+        }
+        return Quaternionf(w, rotation.x * s, rotation.y * s, rotation.z * s);
+    }
+
+    /**
+     * q = q * exp(rotation / 2), normalized. The attitude itself stays double
+     */
+    static void rotate(Quaternion& q, const Vec3f& rotation) {
+        q = q.toQuaternionT<double>() * Quaterniond(increment(rotation));
+        q.normalize();
+    }
+
+private:
+    SampleRing<VEC3_SENSOR_HISTORY>::Cursor cursor;
+    bool attached = false;
+    uint64_t lastSampleUs = 0;
+    Vec3f alpha;        // plain sum of the increments
+    Vec3f beta;         // coning correction
+    Vec3f lastDelta;
+    float duration = 0;
+};
@@ -0,0 +1,546 @@
+/**
+ * @file ErrorStateEKF.h
+ * @author Timo Lehnertz
+ * @brief 15 state error state Kalman filter for attitude, velocity, position and imu biases
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include "SensorFusion.h"
+#include <sensorInterface.h>
+#include <error.h>
+#include <matrix.h>
+#include <geodesy.h>
+
+/**
+ * Error state (indirect) extended Kalman filter
+ *
+ * Nominal state: attitude quaternion, velocity, position, gyro bias, accelerometer bias. Integrated at imu rate without covariance.
+ * Error state:   15 small errors [attitude(body frame), velocity, position, gyro bias, acc bias] with covariance P
+ *
+ * Predict:  every gyro sample. The covariance is propagated every covarianceDivider samples with the averaged rates.
+ *           Phi is never built. Its block structure is applied directly and only the upper triangle of P is computed
+ * Update:   gravity direction (accelerometer), baro height, GPS position and velocity, magnetometer heading.
+ *           All measurements are processed as sequential scalar updates with sparse H rows, so there is no matrix inversion.
+ *           Errors are injected into the nominal state after every measurement group
+ *
+ * Frames: internally world x is the heading reference (magnetic north + magZOffset), y is 90deg to the right of x (east), z up.
+ * publish() hands loc and vel out as (east, -north, up) like ComplementaryFilter, so every SensorFusion shares one public frame.
+ * Body axes follow ComplementaryFilter: rot.rotate(acc) points up when resting and the gyro x axis is mirrored.
+ * Memory: two 15x15 float matrices, no heap
+ */
+class ErrorStateEKF : public SensorFusion {
+public:
+    static constexpr int N = 15;
+    enum StateIndex {
+        ATT = 0,
+        VEL = 3,
+        POS = 6,
+        GYRO_BIAS = 9,
+        ACC_BIAS = 12,
+    };
+
+    ErrorStateEKF(SensorInterface* sensors) : SensorFusion(sensors) {
+        reset();
+    }
+
+    // process noise spectral densities
+    float gyroNoise = 0.005f;       // rad/s/sqrt(Hz)
+    float accNoise = 0.35f;         // m/s^2/sqrt(Hz)
+    float gyroBiasNoise = 0.0001f;  // rad/s^2/sqrt(Hz)
+    float accBiasNoise = 0.001f;    // m/s^3/sqrt(Hz)
+
+    // measurement noise standard deviations
+    float tiltNoise = 0.05f;        // normalized accelerometer
+    float maxTiltG = 0.15f;         // gravity is only measured if the acceleration is within 1G +- maxTiltG
+    float baroNoise = 0.5f;         // m
+    float gpsPosNoise = 2.0f;       // m at hdop 1
+    float gpsVelNoise = 0.5f;       // m/s
+    float magNoise = 0.05f;         // rad
+
+    float innovationGate = 5.0f;    // measurements further than this many standard deviations off are rejected
+    int maxGpsRejects = 5;          // gps fixes in a row that may be rejected before position and velocity get reset to the fix
+    int covarianceDivider = 4;      // imu samples per covariance propagation
+
+    void begin() {
+        // nothing to do
+    }
+
+    void handle() {
+        if(!sensors->gyro.isError() && sensors->gyro.lastChange != lastGyro) {
+            uint32_t deltaT = getSampleDeltaUs(sensors->gyro.lastChange, lastGyro);
+            lastGyro = sensors->gyro.lastChange;
+            if(deltaT > 0 && deltaT < 100000) {
+                predict(sensors->gyro.getVec3(), sensors->acc.getVec3(), deltaT * 0.000001f);
+            }
+        }
+        if(!sensors->acc.isError() && sensors->acc.lastChange != lastAcc) {
+            lastAcc = sensors->acc.lastChange;
+            updateGravity(sensors->acc.getVec3());
+        }
+        if(!sensors->baro.isError() && sensors->baro.lastChange != lastBaro) {
+            lastBaro = sensors->baro.lastChange;
+            updateBaro(sensors->baro.altitude);
+        }
+        if(!sensors->gps.isError() && sensors->gps.lastChange != lastGPS) {
+            lastGPS = sensors->gps.lastChange;
+            updateGPS(sensors->gps);
+        }
+        if(sensors->useMag && !sensors->mag.isError() && sensors->mag.lastChange != lastMag) {
+            lastMag = sensors->mag.lastChange;
+            updateMag(sensors->mag.getVec3());
+        }
+        publish();
+    }
+
+    bool isLocationValid() {
+        return origin.hasOrigin() && sensors->gps.error != Error::CRITICAL_ERROR;
+    }
+
+    bool isVelocityValid() {
+        return origin.hasOrigin() && sensors->gps.error != Error::CRITICAL_ERROR;
+    }
+
+    bool isHeightValid() {
+        return baroInitialized && sensors->baro.error != Error::CRITICAL_ERROR;
+    }
+
+    void setMagZOffset(double deg) {
+        magZOffsetDeg = deg;
+        magRefRad = deg * DEG_TO_RAD;
+    }
+
+    double getMagZOffset() {
+        return magZOffsetDeg;
+    }
+
+    Vec3 getGyroBias() {
+        return Vec3(gyroBias[0], gyroBias[1], gyroBias[2]);
+    }
+
+    Vec3 getAccBias() {
+        return Vec3(accBias[0], accBias[1], accBias[2]);
+    }
+
+    /**
+     * Standard deviation of an error state
+     */
+    float getStdDev(int index) {
+        return sqrtf(P(index, index));
+    }
+
+    void reset() {
+        q[0] = 1;
+        q[1] = q[2] = q[3] = 0;
+        for (int i = 0; i < 3; i++) {
+            v[i] = 0;
+            p[i] = 0;
+            gyroBias[i] = 0;
+            accBias[i] = 0;
+        }
+        for (int i = 0; i < N; i++) {
+            dx[i] = 0;
+        }
+        P.setZero();
+        for (int i = 0; i < 3; i++) {
+            P(ATT + i, ATT + i) = 0.5f;         // rad^2
+            P(VEL + i, VEL + i) = 1.0f;         // (m/s)^2
+            P(POS + i, POS + i) = 100.0f;       // m^2
+            P(GYRO_BIAS + i, GYRO_BIAS + i) = 0.0025f;
+            P(ACC_BIAS + i, ACC_BIAS + i) = 0.25f;
+        }
+        clearAccumulators();
+        baroInitialized = false;
+        origin.clearOrigin();
+        gpsRejects = 0;
+        publish();
+    }
+
+    /**
+     * Removes the heading by rotating around the world z axis
+     */
+    void resetYaw() {
+        float w = q[0], z = q[3];
+        float norm2 = w * w + z * z;
+        if(norm2 < 1e-12f) return;
+        float recipNorm = 1.0f / sqrtf(norm2);
+        Quaternion leveled = Quaternion(w * recipNorm, 0, 0, -z * recipNorm) * Quaternion(q[0], q[1], q[2], q[3]);
+        q[0] = leveled.w;
+        q[1] = leveled.x;
+        q[2] = leveled.y;
+        q[3] = leveled.z;
+        publish();
+    }
+
+    void resetAltitude() {
+        baroOffset = lastRawBaroAltitude;
+        p[2] = 0;
+        v[2] = 0;
+        origin.clearOrigin(); // next fix becomes the new origin
+        publish();
+    }
+
+private:
+    static constexpr float G_MS2 = 9.807f;
+    static constexpr float degToRad = 0.0174532925f;
+
+    // nominal state
+    float q[4];
+    float v[3];
+    float p[3];
+    float gyroBias[3];  // rad/s in filter axes (gyro x mirrored)
+    float accBias[3];   // m/s^2
+
+    // error state and covariance
+    float dx[N];
+    Matrix<N, N> P;
+    Matrix<N, N> A; // scratch for Phi * P
+
+    float R[3][3]; // body to world of the nominal attitude. Updated in predict
+
+    // imu averages for the next covariance propagation
+    float accumDt;
+    float accumW[3];
+    float accumF[3];
+    int accumCount;
+
+    uint64_t lastAcc = 0;
+    uint64_t lastGyro = 0;
+    uint64_t lastMag = 0;
+    uint64_t lastBaro = 0;
+    uint64_t lastGPS = 0;
+
+    bool baroInitialized = false;
+    float baroOffset = 0;
+    float lastRawBaroAltitude = 0;
+
+    LocalTangentPlane origin;
+    int gpsRejects = 0;
+
+    double magZOffsetDeg = 0;
+    float magRefRad = 0;
+
+    void clearAccumulators() {
+        accumDt = 0;
+        accumCount = 0;
+        for (int i = 0; i < 3; i++) {
+            accumW[i] = 0;
+            accumF[i] = 0;
+        }
+        updateRotationMatrix();
+    }
+
+    void updateRotationMatrix() {
+        float w = q[0], x = q[1], y = q[2], z = q[3];
+        R[0][0] = 1.0f - 2.0f * (y * y + z * z);
+        R[0][1] = 2.0f * (x * y - w * z);
+        R[0][2] = 2.0f * (x * z + w * y);
+        R[1][0] = 2.0f * (x * y + w * z);
+        R[1][1] = 1.0f - 2.0f * (x * x + z * z);
+        R[1][2] = 2.0f * (y * z - w * x);
+        R[2][0] = 2.0f * (x * z - w * y);
+        R[2][1] = 2.0f * (y * z + w * x);
+        R[2][2] = 1.0f - 2.0f * (x * x + y * y);
+    }
+
+    /**
+     * q = q * (1, theta / 2), normalized
+     */
+    void rotateBody(float tx, float ty, float tz) {
+        float hx = 0.5f * tx, hy = 0.5f * ty, hz = 0.5f * tz;
+        float w = q[0], x = q[1], y = q[2], z = q[3];
+        float w1 = w - x * hx - y * hy - z * hz;
+        float x1 = x + w * hx + y * hz - z * hy;
+        float y1 = y + w * hy - x * hz + z * hx;
+        float z1 = z + w * hz + x * hy - y * hx;
+        float recipNorm = 1.0f / sqrtf(w1 * w1 + x1 * x1 + y1 * y1 + z1 * z1);
+        q[0] = w1 * recipNorm;
+        q[1] = x1 * recipNorm;
+        q[2] = y1 * recipNorm;
+        q[3] = z1 * recipNorm;
+    }
+
+    void predict(const Vec3& gyro, const Vec3& acc, float dt) {
+        float w[3] = {
+            (float) -gyro.x * degToRad - gyroBias[0], // align with sticks, same as ComplementaryFilter
+            (float) gyro.y * degToRad - gyroBias[1],
+            (float) gyro.z * degToRad - gyroBias[2],
+        };
+        float f[3] = {
+            (float) acc.x * G_MS2 - accBias[0],
+            (float) acc.y * G_MS2 - accBias[1],
+            (float) acc.z * G_MS2 - accBias[2],
+        };
+        // velocity and position with the attitude at the start of the step
+        float aw[3];
+        for (int i = 0; i < 3; i++) {
+            aw[i] = R[i][0] * f[0] + R[i][1] * f[1] + R[i][2] * f[2];
+        }
+        aw[2] -= G_MS2;
+        for (int i = 0; i < 3; i++) {
+            p[i] += (v[i] + 0.5f * aw[i] * dt) * dt;
+            v[i] += aw[i] * dt;
+        }
+        rotateBody(w[0] * dt, w[1] * dt, w[2] * dt);
+
+        accumDt += dt;
+        for (int i = 0; i < 3; i++) {
+            accumW[i] += w[i] * dt;
+            accumF[i] += f[i] * dt;
+        }
+        if(++accumCount >= covarianceDivider) {
+            for (int i = 0; i < 3; i++) {
+                accumW[i] /= accumDt;
+                accumF[i] /= accumDt;
+            }
+            propagateCovariance(accumW, accumF, accumDt);
+            clearAccumulators();
+        } else {
+            updateRotationMatrix();
+        }
+    }
+
+    /**
+     * P = Phi P Phi^T + Q with
+     *      Phi = | I-[w]x*dt  0      0  -I*dt   0      |
+     *            | -R[f]x*dt  I      0   0     -R*dt   |
+     *            | 0          I*dt   I   0      0      |
+     *            | 0          0      0   I      0      |
+     *            | 0          0      0   0      I      |
+     */
+    void propagateCovariance(const float w[3], const float f[3], float dt) {
+        const float W[3][3] = {
+            {0, -w[2], w[1]},
+            {w[2], 0, -w[0]},
+            {-w[1], w[0], 0},
+        };
+        const float F[3][3] = {
+            {0, -f[2], f[1]},
+            {f[2], 0, -f[0]},
+            {-f[1], f[0], 0},
+        };
+        float M1[3][3]; // -R[f]x * dt
+        float M2[3][3]; // -R * dt
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                M1[i][j] = -dt * (R[i][0] * F[0][j] + R[i][1] * F[1][j] + R[i][2] * F[2][j]);
+                M2[i][j] = -dt * R[i][j];
+            }
+        }
+        // A = Phi * P. Bias rows are unchanged
+        for (int c = 0; c < N; c++) {
+            float pt0 = P(ATT, c), pt1 = P(ATT + 1, c), pt2 = P(ATT + 2, c);
+            float pa0 = P(ACC_BIAS, c), pa1 = P(ACC_BIAS + 1, c), pa2 = P(ACC_BIAS + 2, c);
+            for (int i = 0; i < 3; i++) {
+                A(ATT + i, c) = P(ATT + i, c) - dt * (W[i][0] * pt0 + W[i][1] * pt1 + W[i][2] * pt2) - dt * P(GYRO_BIAS + i, c);
+                A(VEL + i, c) = P(VEL + i, c) + M1[i][0] * pt0 + M1[i][1] * pt1 + M1[i][2] * pt2 + M2[i][0] * pa0 + M2[i][1] * pa1 + M2[i][2] * pa2;
+                A(POS + i, c) = P(POS + i, c) + dt * P(VEL + i, c);
+                A(GYRO_BIAS + i, c) = P(GYRO_BIAS + i, c);
+                A(ACC_BIAS + i, c) = P(ACC_BIAS + i, c);
+            }
+        }
+        // P = A * Phi^T. Upper triangle only
+        for (int r = 0; r < N; r++) {
+            float at0 = A(r, ATT), at1 = A(r, ATT + 1), at2 = A(r, ATT + 2);
+            float aa0 = A(r, ACC_BIAS), aa1 = A(r, ACC_BIAS + 1), aa2 = A(r, ACC_BIAS + 2);
+            for (int c = r; c < N; c++) {
+                int j = c % 3;
+                switch(c / 3) {
+                    case 0: P(r, c) = A(r, c) - dt * (W[j][0] * at0 + W[j][1] * at1 + W[j][2] * at2) - dt * A(r, GYRO_BIAS + j); break;
+                    case 1: P(r, c) = A(r, c) + M1[j][0] * at0 + M1[j][1] * at1 + M1[j][2] * at2 + M2[j][0] * aa0 + M2[j][1] * aa1 + M2[j][2] * aa2; break;
+                    case 2: P(r, c) = A(r, c) + dt * A(r, VEL + j); break;
+                    default: P(r, c) = A(r, c);
+                }
+            }
+        }
+        P.copyUpperToLower();
+        float qAtt = gyroNoise * gyroNoise * dt;
+        float qVel = accNoise * accNoise * dt;
+        float qGyroBias = gyroBiasNoise * gyroBiasNoise * dt;
+        float qAccBias = accBiasNoise * accBiasNoise * dt;
+        for (int i = 0; i < 3; i++) {
+            P(ATT + i, ATT + i) += qAtt;
+            P(VEL + i, VEL + i) += qVel;
+            P(GYRO_BIAS + i, GYRO_BIAS + i) += qGyroBias;
+            P(ACC_BIAS + i, ACC_BIAS + i) += qAccBias;
+        }
+    }
+
+    /**
+     * Sequential scalar update y = H * dx + noise with a sparse H row
+     * Only writes the upper triangle of P. inject() mirrors it once per measurement group
+     * @param idx state indices of the non zero entries of H
+     * @param h values of the non zero entries
+     * @param count number of non zero entries (max 3)
+     * @return false if the measurement got rejected by the innovation gate
+     */
+    bool scalarUpdate(const int* idx, const float* h, int count, float innovation, float variance) {
+        // P * H^T from the upper triangle: column j above the diagonal, row j below
+        float pht[N] = {};
+        for (int k = 0; k < count; k++) {
+            int j = idx[k];
+            for (int r = 0; r <= j; r++) {
+                pht[r] += P(r, j) * h[k];
+            }
+            for (int r = j + 1; r < N; r++) {
+                pht[r] += P(j, r) * h[k];
+            }
+        }
+        float s = variance;
+        for (int k = 0; k < count; k++) {
+            s += h[k] * pht[idx[k]];
+            innovation -= h[k] * dx[idx[k]];
+        }
+        if(s <= 0) return false;
+        if(innovation * innovation > innovationGate * innovationGate * s) return false;
+        float recipS = 1.0f / s;
+        for (int r = 0; r < N; r++) {
+            float k = pht[r] * recipS;
+            dx[r] += k * innovation;
+            for (int c = r; c < N; c++) {
+                P(r, c) -= k * pht[c];
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Moves the estimated errors into the nominal state. Called once after every group of scalar updates
+     */
+    void inject() {
+        P.copyUpperToLower();
+        rotateBody(dx[ATT], dx[ATT + 1], dx[ATT + 2]);
+        for (int i = 0; i < 3; i++) {
+            v[i] += dx[VEL + i];
+            p[i] += dx[POS + i];
+            gyroBias[i] += dx[GYRO_BIAS + i];
+            accBias[i] += dx[ACC_BIAS + i];
+        }
+        for (int i = 0; i < N; i++) {
+            dx[i] = 0;
+        }
+        updateRotationMatrix();
+    }
+
+    /**
+     * Measured gravity direction against R^T * z. H = [g]x on the attitude error
+     */
+    void updateGravity(const Vec3& acc) {
+        float ax = acc.x, ay = acc.y, az = acc.z;
+        float norm = sqrtf(ax * ax + ay * ay + az * az);
+        if(norm < 1.0f - maxTiltG || norm > 1.0f + maxTiltG) return;
+        float recipNorm = 1.0f / norm;
+        float a[3] = {ax * recipNorm, ay * recipNorm, az * recipNorm};
+        float g[3] = {R[2][0], R[2][1], R[2][2]};
+        // rows of [g]x with two non zero entries each
+        const int idx[3][2] = {{ATT + 1, ATT + 2}, {ATT, ATT + 2}, {ATT, ATT + 1}};
+        const float h[3][2] = {{-g[2], g[1]}, {g[2], -g[0]}, {-g[1], g[0]}};
+        float variance = tiltNoise * tiltNoise;
+        for (int i = 0; i < 3; i++) {
+            scalarUpdate(idx[i], h[i], 2, a[i] - g[i], variance);
+        }
+        inject();
+    }
+
+    void updateBaro(float altitude) {
+        lastRawBaroAltitude = altitude;
+        if(!baroInitialized) {
+            baroOffset = altitude - p[2];
+            baroInitialized = true;
+            return;
+        }
+        const int idx[1] = {POS + 2};
+        const float h[1] = {1};
+        scalarUpdate(idx, h, 1, altitude - baroOffset - p[2], baroNoise * baroNoise);
+        inject();
+    }
+
+    void updateGPS(const GPS& gps) {
+        if(!gps.locationValid) return;
+        if(!origin.hasOrigin()) {
+            origin.setOrigin(gps.lat, gps.lng);
+            // current estimate becomes the origin
+            p[0] = 0;
+            p[1] = 0;
+            return;
+        }
+        float north, east;
+        origin.toLocal(gps.lat, gps.lng, north, east);
+        float posNoise = gpsPosNoise * max(1.0f, gps.hdop);
+        bool hasVelocity = gps.speedValid && gps.courseValid;
+        float course = gps.course * degToRad;
+        float velNorth = gps.speed * cosf(course);
+        float velEast = gps.speed * sinf(course);
+        if(gpsRejects >= maxGpsRejects) {
+            // a diverged estimate would reject every fix forever. Start over from the gps solution
+            resetHorizontal(north, east, posNoise, hasVelocity, velNorth, velEast);
+            return;
+        }
+        bool rejected = false;
+        const float h[1] = {1};
+        const int idxX[1] = {POS};
+        const int idxY[1] = {POS + 1};
+        rejected |= !scalarUpdate(idxX, h, 1, north - p[0], posNoise * posNoise);
+        rejected |= !scalarUpdate(idxY, h, 1, east - p[1], posNoise * posNoise);
+        if(hasVelocity) {
+            const int idxVX[1] = {VEL};
+            const int idxVY[1] = {VEL + 1};
+            rejected |= !scalarUpdate(idxVX, h, 1, velNorth - v[0], gpsVelNoise * gpsVelNoise);
+            rejected |= !scalarUpdate(idxVY, h, 1, velEast - v[1], gpsVelNoise * gpsVelNoise);
+        }
+        gpsRejects = rejected ? gpsRejects + 1 : 0;
+        inject();
+    }
+
+    /**
+     * Heading of the horizontal field in world frame against the reference. H = last row of R on the attitude error
+     */
+    void updateMag(const Vec3& mag) {
+        float mx = mag.x, my = mag.y, mz = mag.z;
+        if(mx == 0.0f && my == 0.0f && mz == 0.0f) return;
+        float hx = R[0][0] * mx + R[0][1] * my + R[0][2] * mz;
+        float hy = R[1][0] * mx + R[1][1] * my + R[1][2] * mz;
+        if(hx * hx + hy * hy < 1e-12f) return;
+        float innovation = magRefRad - atan2f(hy, hx);
+        while(innovation > PI) innovation -= 2 * PI;
+        while(innovation < -PI) innovation += 2 * PI;
+        const int idx[3] = {ATT, ATT + 1, ATT + 2};
+        const float h[3] = {R[2][0], R[2][1], R[2][2]};
+        scalarUpdate(idx, h, 3, innovation, magNoise * magNoise);
+        inject();
+    }
+
+    /**
+     * Sets horizontal position and velocity to the gps solution and forgets their correlations
+     */
+    void resetHorizontal(float north, float east, float posNoise, bool hasVelocity, float velNorth, float velEast) {
+        const int idx[4] = {POS, POS + 1, VEL, VEL + 1};
+        const float variance[4] = {posNoise * posNoise, posNoise * posNoise, gpsVelNoise * gpsVelNoise, gpsVelNoise * gpsVelNoise};
+        int count = hasVelocity ? 4 : 2;
+        for (int k = 0; k < count; k++) {
+            for (int i = 0; i < N; i++) {
+                P(idx[k], i) = 0;
+                P(i, idx[k]) = 0;
+            }
+            P(idx[k], idx[k]) = variance[k];
+        }
+        p[0] = north;
+        p[1] = east;
+        if(hasVelocity) {
+            v[0] = velNorth;
+            v[1] = velEast;
+        }
+        gpsRejects = 0;
+        publish();
+    }
+
+    void publish() {
+        rot = Quaternion(q[0], q[1], q[2], q[3]);
+        // public frame of every SensorFusion: (east, -north, up)
+        vel = Vec3(v[1], -v[0], v[2]);
+        loc = Vec3(p[1], -p[0], p[2]);
+    }
+};
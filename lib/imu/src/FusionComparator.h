@@ -0,0 +1,122 @@
+/**
+ * @file FusionComparator.h
+ * @author Timo Lehnertz
+ * @brief Runs a candidate sensor fusion in the shadow of the active one and compares their attitudes
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <Arduino.h>
+#include "SensorFusion.h"
+
+/**
+ * Shadow mode for qualifying new estimators in flight
+ *
+ * The candidate reads the same sensor samples as the active fusion but only runs in the idle time at the end of a loop.
+ * Its first run is timed by measure() when the shadow gets selected, outside the loop timing. Until then it never gets a slot.
+ * After that it only gets a slot when the remaining time covers its recent worst run time plus a margin, otherwise the loop is counted as skipped.
+ * Its run time is measured on its own and never shows up in INS Us or the cpu load.
+ *
+ * Divergence statistics are kept per axis (roll, pitch, yaw) in degrees since the last reset
+ */
+class FusionComparator {
+public:
+    uint32_t marginUs = 20; // idle time that is always left to the loop timing
+
+    void reset() {
+        for (int i = 0; i < 3; i++) {
+            sum[i] = 0;
+            sumSq[i] = 0;
+            maxAbs[i] = 0;
+            last[i] = 0;
+        }
+        samples = 0;
+        skipped = 0;
+        lastUs = 0;
+        worstUs = 0;
+        measured = false;
+    }
+
+    /**
+     * Times one run of the freshly started candidate. Call outside the loop timing, like SensorFusion::begin()
+     */
+    void measure(SensorFusion* candidate) {
+        uint32_t start = micros();
+        candidate->handle();
+        candidate->updateAttitudeCache();
+        lastUs = micros() - start;
+        worstUs = lastUs;
+        measured = true;
+    }
+
+    /**
+     * Give the candidate a slot if the budget allows it
+     * @param budgetUs idle time left in this loop
+     * @return true if the candidate ran
+     */
+    bool handle(SensorFusion* active, SensorFusion* candidate, uint32_t budgetUs) {
+        if(!measured) {
+            skipped++;
+            return false;
+        }
+        uint32_t needed = worstUs + marginUs;
+        // the worst case decays slowly so a single run stretched by interrupts does not lock the candidate out
+        worstUs -= worstUs >> 6;
+        if(budgetUs < needed) {
+            skipped++;
+            return false;
+        }
+        uint32_t start = micros();
+        candidate->handle();
+        candidate->updateAttitudeCache();
+        lastUs = micros() - start;
+        if(lastUs > worstUs) worstUs = lastUs;
+
+        const EulerRotation& a = active->getAttitudeCache().euler;
+        const EulerRotation& c = candidate->getAttitudeCache().euler;
+        addDifference(0, c.x - a.x);
+        addDifference(1, c.y - a.y);
+        addDifference(2, c.z - a.z);
+        samples++;
+        return true;
+    }
+
+    /**
+     * Statistics in degrees. Axis 0 = roll, 1 = pitch, 2 = yaw
+     */
+    float getLast(int axis) const { return last[axis]; }
+    float getMean(int axis) const { return samples == 0 ? 0 : sum[axis] / samples; }
+    float getRms(int axis) const { return samples == 0 ? 0 : sqrt(sumSq[axis] / samples); }
+    float getMax(int axis) const { return maxAbs[axis]; }
+
+    uint32_t getSamples() const { return samples; }
+    uint32_t getSkipped() const { return skipped; }
+    uint32_t getLastUs() const { return lastUs; }
+    uint32_t getWorstUs() const { return worstUs; }
+    bool isMeasured() const { return measured; }
+
+private:
+    double sum[3] = {0, 0, 0};
+    double sumSq[3] = {0, 0, 0};
+    float maxAbs[3] = {0, 0, 0};
+    float last[3] = {0, 0, 0};
+    uint32_t samples = 0;
+    uint32_t skipped = 0;
+    uint32_t lastUs = 0;
+    uint32_t worstUs = 0;
+    bool measured = false;
+
+    void addDifference(int axis, double rad) {
+        // wrap to -180 - 180 so yaw around the seam does not count as a full turn
+        while(rad > PI) rad -= 2 * PI;
+        while(rad < -PI) rad += 2 * PI;
+        float deg = rad * RAD_TO_DEG;
+        last[axis] = deg;
+        sum[axis] += deg;
+        sumSq[axis] += deg * deg;
+        if(abs(deg) > maxAbs[axis]) maxAbs[axis] = abs(deg);
+    }
+};
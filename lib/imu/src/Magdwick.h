@@ -1,73 +1,247 @@
 /**
  * @file Magdwick.h
  * @author Timo Lehnertz
- * @brief 
+ * @brief
  * @version 0.1
  * @date 2022-01-01
- * 
+ *
  * @copyright Copyright (c) 2022
- * 
+ *
  */
 #pragma once
 #include "SensorFusion.h"
 #include <sensorInterface.h>
 #include <error.h>
+#include <fastMath.h>
 
+/**
+ * Madgwick gradient descent attitude filter
+ *
+ * IMU path (acc + gyro) and MARG path (acc + gyro + mag). The MARG path is used whenever a valid magnetometer reading exists.
+ * All maths is float. Normalisations use FastMath::rsqrt.
+ *
+ * beta is the gradient step in rad/s. Steps are integrated over the time between gyro sample timestamps,
+ * so the filter behaves the same for every loop and sample rate.
+ * begin() does not block: for warmupUs after it, warmupBeta is used so the attitude converges quickly from rest.
+ *
+ * Axes follow ComplementaryFilter: rot.rotate(acc) points up when resting and the gyro x axis is mirrored
+ */
 class MagdwickFilter : public SensorFusion {
 public:
     MagdwickFilter(SensorInterface* sensors) : SensorFusion(sensors) {}
 
+    float beta = 0.05f;             // rad/s
+    float warmupBeta = 2.5f;        // rad/s
+    uint32_t warmupUs = 500000;
+    float minG = 0.5f;              // accelerometer is only trusted between minG and maxG
+    float maxG = 1.5f;
+
     /**
-     * blocking min 0.5 seconds
+     * Non blocking. Starts the warm up phase
      */
     void begin() {
-        for (int i = 0; i <= 1000; i++) {
-            sensors->handle();
-            handle();
-            delayMicroseconds(500); // not more than 2Khz
-        }
+        warmupStart = micros();
+        warmingUp = true;
     }
 
-    void handle() {
-        //DESCRIPTION: Attitude estimation through sensor fusion - 9DOF
-        /*
-        * This function fuses the accelerometer gyro, and magnetometer readings AccX, AccY, AccZ, GyroX, GyroY, GyroZ, MagX, MagY, and MagZ for attitude estimation.
-        * Don't worry about the math. There is a tunable parameter B_madgwick in the user specified variable section which basically
-        * adjusts the weight of gyro data in the state estimate. Higher beta leads to noisier estimate, lower 
-        * beta leads to slower to respond estimate. It is currently tuned for 2kHz loop rate. This function updates the roll_IMU,
-        * pitch_IMU, and yaw_IMU variables which are in degrees. If magnetometer data is not available, this function calls Madgwick6DOF() instead.
-        */
-        float dt = (micros() - lastUpdate) / 1000000.0;
-        float recipNorm;
-        float s0, s1, s2, s3;
-        float qDot1, qDot2, qDot3, qDot4;
-        float hx, hy;
-        float _2q0mx, _2q0my, _2q0mz, _2q1mx, _2bx, _2bz, _4bx, _4bz, _2q0, _2q1, _2q2, _2q3, _2q0q2, _2q2q3, q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
-        // float mholder;
+    bool isWarmingUp() {
+        return warmingUp;
+    }
 
-        float ax = sensors->acc.x;
-        float ay = sensors->acc.y;
-        float az = sensors->acc.z;
+    void handle() {
+        if(sensors->gyro.isError() || sensors->gyro.lastChange == lastGyro) return;
+        uint32_t deltaT = getSampleDeltaUs(sensors->gyro.lastChange, lastGyro);
+        lastGyro = sensors->gyro.lastChange;
+        if(deltaT == 0) return;
+        float dt = deltaT * 0.000001f;
+
+        if(warmingUp && micros() - warmupStart > warmupUs) {
+            warmingUp = false;
+        }
+        float b = warmingUp ? warmupBeta : beta;
 
         //Convert gyroscope degrees/sec to radians/sec
-        float gx = sensors->gyro.x * 0.0174533f;
-        float gy = sensors->gyro.y * 0.0174533f;
-        float gz = sensors->gyro.z * 0.0174533f;
+        float gx = -sensors->gyro.x * degToRad; // align with sticks, same as ComplementaryFilter
+        float gy = sensors->gyro.y * degToRad;
+        float gz = sensors->gyro.z * degToRad;
+
+        float ax = 0, ay = 0, az = 0;
+        if(!sensors->acc.isError()) {
+            ax = sensors->acc.x;
+            ay = sensors->acc.y;
+            az = sensors->acc.z;
+            float g2 = ax * ax + ay * ay + az * az;
+            if(g2 < minG * minG || g2 > maxG * maxG) {
+                ax = ay = az = 0; // too much movement. Gyro only
+            }
+        }
 
         float mx = sensors->mag.x;
         float my = sensors->mag.y;
         float mz = sensors->mag.z;
+        //Use 6DOF algorithm if magnetometer measurement invalid (avoids NaN in magnetometer normalisation)
+        bool useMag = sensors->useMag && !sensors->mag.isError() && !(mx == 0.0f && my == 0.0f && mz == 0.0f);
 
-        //use 6DOF algorithm if MPU6050 is being used
-        if(sensors->mag.error == Error::CRITICAL_ERROR) {
-            // Madgwick6DOF(gx, gy, gz, ax, ay, az, dt);
-            return;
+        if(useMag) {
+            madgwick9DOF(gx, gy, gz, ax, ay, az, mx, my, mz, b, dt);
+        } else {
+            madgwick6DOF(gx, gy, gz, ax, ay, az, b, dt);
         }
-        //Use 6DOF algorithm if magnetometer measurement invalid (avoids NaN in magnetometer normalisation)
-        if((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f)) {
-            // Madgwick6DOF(gx, gy, gz, ax, ay, az, dt);
-            return;
+        publish();
+    }
+
+    /**
+     * Removes the heading by rotating around the world z axis
+     */
+    void resetYaw() {
+        float w = rot.w, z = rot.z;
+        float norm2 = w * w + z * z;
+        if(norm2 < 1e-12f) return; // upside down with 180deg yaw. Nothing sensible to do
+        float recipNorm = FastMath::rsqrt(norm2);
+        Quaternion yawInv(w * recipNorm, 0, 0, -z * recipNorm);
+        Quaternion leveled = yawInv * rot;
+        Quaternion q = Quaternion(headingW, 0, 0, -headingZ) * leveled; // remove the heading offset again
+        q0 = q.w;
+        q1 = q.x;
+        q2 = q.y;
+        q3 = q.z;
+        publish();
+    }
+
+    void reset() {
+        q0 = 1.0f;
+        q1 = 0.0f;
+        q2 = 0.0f;
+        q3 = 0.0f;
+        loc = Vec3();
+        vel = Vec3();
+        publish();
+        begin();
+    }
+
+    void resetAltitude() {
+        loc.z = 0;
+    }
+
+    bool isLocationValid() {
+        return sensors->gps.error != Error::CRITICAL_ERROR;
+    }
+
+    bool isVelocityValid() {
+        return sensors->gps.error != Error::CRITICAL_ERROR;
+    }
+
+    bool isHeightValid() {
+        return sensors->baro.error != Error::CRITICAL_ERROR;
+    }
+
+    /**
+     * Rotates the published attitude around world z. Applied after the filter so the gradient stays aligned to magnetic north
+     */
+    void setMagZOffset(double deg) {
+        magZOffsetDeg = deg;
+        float halfRad = deg * degToRad * 0.5f;
+        headingW = cosf(halfRad);
+        headingZ = sinf(halfRad);
+        publish();
+    }
+
+    double getMagZOffset() {
+        return magZOffsetDeg;
+    }
+
+private:
+    static constexpr float degToRad = 0.0174532925f;
+
+    uint64_t lastGyro = 0;
+    uint32_t warmupStart = 0;
+    bool warmingUp = true;
+
+    float q0 = 1.0f; //initialize quaternion for madgwick filter
+    float q1 = 0.0f;
+    float q2 = 0.0f;
+    float q3 = 0.0f;
+    double magZOffsetDeg = 0.0;
+    float headingW = 1.0f; // quaternion around z by magZOffsetDeg
+    float headingZ = 0.0f;
+
+    void publish() {
+        // heading * q with heading = (headingW, 0, 0, headingZ)
+        rot.w = headingW * q0 - headingZ * q3;
+        rot.x = headingW * q1 - headingZ * q2;
+        rot.y = headingW * q2 + headingZ * q1;
+        rot.z = headingW * q3 + headingZ * q0;
+    }
+
+    void integrate(float qDot1, float qDot2, float qDot3, float qDot4, float dt) {
+        //Integrate rate of change of quaternion to yield quaternion
+        q0 += qDot1 * dt;
+        q1 += qDot2 * dt;
+        q2 += qDot3 * dt;
+        q3 += qDot4 * dt;
+
+        //Normalise quaternion
+        float recipNorm = FastMath::rsqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+        q0 *= recipNorm;
+        q1 *= recipNorm;
+        q2 *= recipNorm;
+        q3 *= recipNorm;
+    }
+
+    /**
+     * acc and gyro only. ax = ay = az = 0 integrates the gyro without correction
+     */
+    void madgwick6DOF(float gx, float gy, float gz, float ax, float ay, float az, float b, float dt) {
+        float recipNorm;
+        float s0, s1, s2, s3;
+        float qDot1, qDot2, qDot3, qDot4;
+        float _2q0, _2q1, _2q2, _2q3, _4q0, _4q1, _4q2, _8q1, _8q2, q0q0, q1q1, q2q2, q3q3;
+
+        //Rate of change of quaternion from gyroscope
+        qDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+        qDot2 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+        qDot3 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+        qDot4 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+        //Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
+        if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+            //Normalise accelerometer measurement
+            recipNorm = FastMath::rsqrt(ax * ax + ay * ay + az * az);
+            ax *= recipNorm;
+            ay *= recipNorm;
+            az *= recipNorm;
+
+            //Auxiliary variables to avoid repeated arithmetic
+            _2q0 = 2.0f * q0;
+            _2q1 = 2.0f * q1;
+            _2q2 = 2.0f * q2;
+            _2q3 = 2.0f * q3;
+            _4q0 = 4.0f * q0;
+            _4q1 = 4.0f * q1;
+            _4q2 = 4.0f * q2;
+            _8q1 = 8.0f * q1;
+            _8q2 = 8.0f * q2;
+            q0q0 = q0 * q0;
+            q1q1 = q1 * q1;
+            q2q2 = q2 * q2;
+            q3q3 = q3 * q3;
+
+            //Gradient decent algorithm corrective step
+            s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+            s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+            s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+            s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+            applyStep(qDot1, qDot2, qDot3, qDot4, s0, s1, s2, s3, b);
         }
+        integrate(qDot1, qDot2, qDot3, qDot4, dt);
+    }
+
+    void madgwick9DOF(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float b, float dt) {
+        float recipNorm;
+        float s0, s1, s2, s3;
+        float qDot1, qDot2, qDot3, qDot4;
+        float hx, hy;
+        float _2q0mx, _2q0my, _2q0mz, _2q1mx, _2bx, _2bz, _4bx, _4bz, _2q0, _2q1, _2q2, _2q3, _2q0q2, _2q2q3, q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
 
         //Rate of change of quaternion from gyroscope
         qDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
@@ -79,13 +253,13 @@ public:
         if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
 
             //Normalise accelerometer measurement
-            recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+            recipNorm = FastMath::rsqrt(ax * ax + ay * ay + az * az);
             ax *= recipNorm;
             ay *= recipNorm;
             az *= recipNorm;
 
             //Normalise magnetometer measurement
-            recipNorm = invSqrt(mx * mx + my * my + mz * mz);
+            recipNorm = FastMath::rsqrt(mx * mx + my * my + mz * mz);
             mx *= recipNorm;
             my *= recipNorm;
             mz *= recipNorm;
@@ -115,7 +289,8 @@ public:
             //Reference direction of Earth's magnetic field
             hx = mx * q0q0 - _2q0my * q3 + _2q0mz * q2 + mx * q1q1 + _2q1 * my * q2 + _2q1 * mz * q3 - mx * q2q2 - mx * q3q3;
             hy = _2q0mx * q3 + my * q0q0 - _2q0mz * q1 + _2q1mx * q2 - my * q1q1 + my * q2q2 + _2q2 * mz * q3 - my * q3q3;
-            _2bx = sqrtf(hx * hx + hy * hy);
+            float hNorm2 = hx * hx + hy * hy;
+            _2bx = hNorm2 * FastMath::rsqrt(hNorm2 + 1e-12f);
             _2bz = -_2q0mx * q2 + _2q0my * q1 + mz * q0q0 + _2q1mx * q3 - mz * q1q1 + _2q2 * my * q3 - mz * q2q2 + mz * q3q3;
             _4bx = 2.0f * _2bx;
             _4bz = 2.0f * _2bz;
@@ -125,108 +300,21 @@ public:
             s1 = _2q3 * (2.0f * q1q3 - _2q0q2 - ax) + _2q0 * (2.0f * q0q1 + _2q2q3 - ay) - 4.0f * q1 * (1 - 2.0f * q1q1 - 2.0f * q2q2 - az) + _2bz * q3 * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) + (_2bx * q2 + _2bz * q0) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) + (_2bx * q3 - _4bz * q1) * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
             s2 = -_2q0 * (2.0f * q1q3 - _2q0q2 - ax) + _2q3 * (2.0f * q0q1 + _2q2q3 - ay) - 4.0f * q2 * (1 - 2.0f * q1q1 - 2.0f * q2q2 - az) + (-_4bx * q2 - _2bz * q0) * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) + (_2bx * q1 + _2bz * q3) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) + (_2bx * q0 - _4bz * q2) * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
             s3 = _2q1 * (2.0f * q1q3 - _2q0q2 - ax) + _2q2 * (2.0f * q0q1 + _2q2q3 - ay) + (-_4bx * q3 + _2bz * q1) * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) + (-_2bx * q0 + _2bz * q2) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) + _2bx * q1 * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
-            recipNorm = invSqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
-            s0 *= recipNorm;
-            s1 *= recipNorm;
-            s2 *= recipNorm;
-            s3 *= recipNorm;
-
-            //Apply feedback step
-            qDot1 -= B_madgwick * s0;
-            qDot2 -= B_madgwick * s1;
-            qDot3 -= B_madgwick * s2;
-            qDot4 -= B_madgwick * s3;
+            applyStep(qDot1, qDot2, qDot3, qDot4, s0, s1, s2, s3, b);
         }
-
-        //Integrate rate of change of quaternion to yield quaternion
-        q0 += qDot1 * dt;
-        q1 += qDot2 * dt;
-        q2 += qDot3 * dt;
-        q3 += qDot4 * dt;
-
-        //Normalise quaternion
-        recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
-        q0 *= recipNorm;
-        q1 *= recipNorm;
-        q2 *= recipNorm;
-        q3 *= recipNorm;
-        
-        //compute angles - NWU
-        // roll_IMU = atan2(q0*q1 + q2*q3, 0.5f - q1*q1 - q2*q2)*57.29577951; //degrees
-        // pitch_IMU = -asin(-2.0f * (q1*q3 - q0*q2))*57.29577951; //degrees
-        // yaw_IMU = -atan2(q1*q2 + q0*q3, 0.5f - q2*q2 - q3*q3)*57.29577951; //degrees
-
-        rot.w = q0;
-        rot.x = q1;
-        rot.y = q2;
-        rot.z = q3;
-
-        lastUpdate = micros();
-    }
-
-    void reset() {
-        
+        integrate(qDot1, qDot2, qDot3, qDot4, dt);
     }
 
-    void resetYaw() {}
-
-    void resetAltitude() {
-        loc.z = 0;
-    }
-
-    bool isLocationValid() {
-        return sensors->gps.error != Error::CRITICAL_ERROR;
-    }
-
-    bool isVelocityValid() {
-        return sensors->gps.error != Error::CRITICAL_ERROR;
-    }
-
-    bool isHeightValid() {
-        return sensors->baro.error != Error::CRITICAL_ERROR;
-    }
-
-    void setMagZOffset(double deg) {
-        magZOffsetDeg = deg;
-    }
-
-    double getMagZOffset() {
-        return magZOffsetDeg;
+    /**
+     * Normalised gradient step. Skipped when the gradient vanishes (estimate already matches)
+     */
+    static void applyStep(float& qDot1, float& qDot2, float& qDot3, float& qDot4, float s0, float s1, float s2, float s3, float b) {
+        float norm2 = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+        if(norm2 < 1e-20f) return;
+        float recipNorm = FastMath::rsqrt(norm2); // normalise step magnitude
+        qDot1 -= b * s0 * recipNorm;
+        qDot2 -= b * s1 * recipNorm;
+        qDot3 -= b * s2 * recipNorm;
+        qDot4 -= b * s3 * recipNorm;
     }
-
-
-private:
-    uint64_t lastUpdate = 0;
-
-    //Filter parameters - Defaults tuned for 2kHz loop rate; Do not touch unless you know what you are doing:
-    float B_madgwick = 0.04;  //Madgwick filter parameter
-    float B_accel = 0.14;     //Accelerometer LP filter paramter, (MPU6050 default: 0.14. MPU9250 default: 0.2)
-    float B_gyro = 0.1;       //Gyro LP filter paramter, (MPU6050 default: 0.1. MPU9250 default: 0.17)
-    float B_mag = 1.0;        //Magnetometer LP filter parameter
-
-    float q0 = 1.0f; //initialize quaternion for madgwick filter
-    float q1 = 0.0f;
-    float q2 = 0.0f;
-    float q3 = 0.0f;
-    double magZOffsetDeg = 0.0;
-
-    float invSqrt(float x) {
-        //Fast inverse sqrt for madgwick filter
-        /*
-        float halfx = 0.5f * x;
-        float y = x;
-        long i = *(long*)&y;
-        i = 0x5f3759df - (i>>1);
-        y = *(float*)&i;
-        y = y * (1.5f - (halfx * y * y));
-        y = y * (1.5f - (halfx * y * y));
-        return y;
-        */
-        //alternate form:
-        // unsigned int i = 0x5F1F1412 - (*(unsigned int*)&x >> 1);
-        // float tmp = *(float*)&i;
-        // float y = tmp * (1.69000231f - 0.714158168f * x * tmp * tmp);
-        // return y;
-        return 0;
-    }
-};
\ No newline at end of file
+};
@@ -0,0 +1,220 @@
+/**
+ * @file Mahony.h
+ * @author Timo Lehnertz
+ * @brief Quaternion complementary filter with PI gyro bias estimation
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include "SensorFusion.h"
+#include <sensorInterface.h>
+#include <error.h>
+
+/**
+ * Mahony style attitude filter
+ *
+ * Accelerometer and magnetometer are compared against the directions of gravity and north predicted by the current quaternion.
+ * The cross product of measured and predicted direction is a rotation error in body frame that is fed back to the gyro rates
+ * through a PI controller. The integral part converges to the gyro bias.
+ * Errors are weighted with the time since the previous sample of their sensor, so slow sensors like the magnetometer
+ * get the same correction per second as the accelerometer although they are applied in a single gyro step
+ * Everything works on the quaternion directly: no Euler angles, no trig in handle()
+ *
+ * Axes follow ComplementaryFilter: rot.rotate(acc) points up when resting and the gyro x axis is mirrored
+ * Only estimates attitude. Velocity and location stay zero
+ */
+class MahonyFilter : public SensorFusion {
+public:
+    MahonyFilter(SensorInterface* sensors) : SensorFusion(sensors) {}
+
+    float kp = 2.0f;        // proportional gain of the accelerometer correction in rad/s per unit error
+    float ki = 0.1f;        // integral gain. Sets how fast the gyro bias is learned
+    float magKp = 1.0f;     // proportional gain of the heading correction
+    float minG = 0.5f;      // accelerometer is only trusted between minG and maxG
+    float maxG = 1.5f;
+    float maxBias = 0.1f;   // rad/s. Limits the integrator
+
+    void begin() {
+        // nothing to do
+    }
+
+    void handle() {
+        if(!sensors->acc.isError() && sensors->acc.lastChange != lastAcc) {
+            processAcc(sensors->acc.getVec3(), getSampleDeltaUs(sensors->acc.lastChange, lastAcc));
+            lastAcc = sensors->acc.lastChange;
+        }
+        if(sensors->useMag && !sensors->mag.isError() && sensors->mag.lastChange != lastMag) {
+            processMag(sensors->mag.getVec3(), getSampleDeltaUs(sensors->mag.lastChange, lastMag));
+            lastMag = sensors->mag.lastChange;
+        }
+        if(!sensors->gyro.isError() && sensors->gyro.lastChange != lastGyro) {
+            processGyro(sensors->gyro.getVec3(), getSampleDeltaUs(sensors->gyro.lastChange, lastGyro));
+            lastGyro = sensors->gyro.lastChange;
+        }
+    }
+
+    Vec3 getGyroBias() {
+        return Vec3(biasX, biasY, biasZ);
+    }
+
+    bool isLocationValid() {
+        return false;
+    }
+
+    bool isVelocityValid() {
+        return false;
+    }
+
+    bool isHeightValid() {
+        return false;
+    }
+
+    void setMagZOffset(double deg) {
+        magZOffsetDeg = deg;
+        magRefCos = cos(deg * DEG_TO_RAD);
+        magRefSin = sin(deg * DEG_TO_RAD);
+    }
+
+    double getMagZOffset() {
+        return magZOffsetDeg;
+    }
+
+    void reset() {
+        rot = Quaternion();
+        biasX = biasY = biasZ = 0;
+        clearErrors();
+        loc = Vec3();
+        vel = Vec3();
+    }
+
+    /**
+     * Removes the heading by rotating around the world z axis
+     */
+    void resetYaw() {
+        double w = rot.w, z = rot.z;
+        double norm = sqrt(w * w + z * z);
+        if(norm < 1e-6) return; // upside down with 180deg yaw. Nothing sensible to do
+        Quaternion yawInv(w / norm, 0, 0, -z / norm);
+        rot = yawInv * rot;
+    }
+
+    void resetAltitude() {
+        loc.z = 0;
+        vel.z = 0;
+    }
+
+private:
+    uint64_t lastAcc = 0;
+    uint64_t lastGyro = 0;
+    uint64_t lastMag = 0;
+
+    double magZOffsetDeg = 0.0;
+    float magRefCos = 1.0f;
+    float magRefSin = 0.0f;
+
+    // body frame corrections accumulated since the last gyro integration
+    float correctionX = 0, correctionY = 0, correctionZ = 0; // rad, already multiplied with the proportional gains
+    float errorX = 0, errorY = 0, errorZ = 0; // rad, error integrated over time. Input of the integrator
+    // integrator / gyro bias estimate in rad/s
+    float biasX = 0, biasY = 0, biasZ = 0;
+
+    void clearErrors() {
+        correctionX = correctionY = correctionZ = 0;
+        errorX = errorY = errorZ = 0;
+    }
+
+    /**
+     * @param e body frame error
+     * @param gain proportional gain for this sensor
+     * @param dt seconds since the previous sample of this sensor
+     */
+    void addError(float ex, float ey, float ez, float gain, float dt) {
+        ex *= dt;
+        ey *= dt;
+        ez *= dt;
+        errorX += ex;
+        errorY += ey;
+        errorZ += ez;
+        correctionX += ex * gain;
+        correctionY += ey * gain;
+        correctionZ += ez * gain;
+    }
+
+    void processAcc(const Vec3& acc, uint32_t deltaT) {
+        if(deltaT == 0) return;
+        float ax = acc.x, ay = acc.y, az = acc.z;
+        float norm2 = ax * ax + ay * ay + az * az;
+        if(norm2 < minG * minG || norm2 > maxG * maxG) return; // too much movement
+        float recipNorm = 1.0f / sqrtf(norm2);
+        ax *= recipNorm;
+        ay *= recipNorm;
+        az *= recipNorm;
+
+        // predicted up vector in body frame. Last row of the rotation matrix
+        float w = rot.w, x = rot.x, y = rot.y, z = rot.z;
+        float vx = 2.0f * (x * z - w * y);
+        float vy = 2.0f * (y * z + w * x);
+        float vz = 1.0f - 2.0f * (x * x + y * y);
+
+        addError(ay * vz - az * vy, az * vx - ax * vz, ax * vy - ay * vx, kp, deltaT / 1000000.0f);
+    }
+
+    /**
+     * Only corrects heading. The horizontal part of the field in world frame gets compared to the reference direction
+     */
+    void processMag(const Vec3& mag, uint32_t deltaT) {
+        if(deltaT == 0) return;
+        float mx = mag.x, my = mag.y, mz = mag.z;
+        if(mx == 0.0f && my == 0.0f && mz == 0.0f) return;
+        float w = rot.w, x = rot.x, y = rot.y, z = rot.z;
+        // field rotated to world frame, x and y only
+        float hx = (1.0f - 2.0f * (y * y + z * z)) * mx + 2.0f * (x * y - w * z) * my + 2.0f * (x * z + w * y) * mz;
+        float hy = 2.0f * (x * y + w * z) * mx + (1.0f - 2.0f * (x * x + z * z)) * my + 2.0f * (y * z - w * x) * mz;
+        float hNorm2 = hx * hx + hy * hy;
+        if(hNorm2 < 1e-12f) return;
+        float recipNorm = 1.0f / sqrtf(hNorm2);
+        hx *= recipNorm;
+        hy *= recipNorm;
+        // world z error rotating the field onto the reference
+        float ez = hx * magRefSin - hy * magRefCos;
+        // back to body frame: last row of the rotation matrix times ez
+        addError(2.0f * (x * z - w * y) * ez, 2.0f * (y * z + w * x) * ez, (1.0f - 2.0f * (x * x + y * y)) * ez, magKp, deltaT / 1000000.0f);
+    }
+
+    void processGyro(const Vec3& gyro, uint32_t deltaT) {
+        if(deltaT == 0) return;
+        float dt = deltaT / 1000000.0f;
+        float gx = -gyro.x * DEG_TO_RAD; // align with sticks, same as ComplementaryFilter
+        float gy = gyro.y * DEG_TO_RAD;
+        float gz = gyro.z * DEG_TO_RAD;
+
+        if(ki > 0) {
+            biasX = constrain(biasX + ki * errorX, -maxBias, maxBias);
+            biasY = constrain(biasY + ki * errorY, -maxBias, maxBias);
+            biasZ = constrain(biasZ + ki * errorZ, -maxBias, maxBias);
+        }
+        gx += correctionX / dt + biasX;
+        gy += correctionY / dt + biasY;
+        gz += correctionZ / dt + biasZ;
+        clearErrors();
+
+        // q += 0.5 * q * (0, g) * dt
+        float halfDt = 0.5f * dt;
+        gx *= halfDt;
+        gy *= halfDt;
+        gz *= halfDt;
+        float w = rot.w, x = rot.x, y = rot.y, z = rot.z;
+        float w1 = w - x * gx - y * gy - z * gz;
+        float x1 = x + w * gx + y * gz - z * gy;
+        float y1 = y + w * gy - x * gz + z * gx;
+        float z1 = z + w * gz + x * gy - y * gx;
+        float recipNorm = 1.0f / sqrtf(w1 * w1 + x1 * x1 + y1 * y1 + z1 * z1);
+        rot.w = w1 * recipNorm;
+        rot.x = x1 * recipNorm;
+        rot.y = y1 * recipNorm;
+        rot.z = z1 * recipNorm;
+    }
+};
@@ -9,7 +9,7 @@
  * 
  */
 #pragma once
-#include <SensorInterface.h>
+#include <sensorInterface.h>
 #include <math.h>
 
 /**
@@ -33,9 +33,25 @@ public:
     enum FusionAlgorythm {
         ComplementaryFilter = 0,
         MagdwickFilter = 1,
+        MahonyFilter = 2,
+        ErrorStateKalman = 3,
     };
 
-    SensorFusion(SensorInterface* sensors) : sensors(sensors) {}
+    /**
+     * Everything derived from the attitude quaternion that consumers need more than once per loop
+     * Computed once per attitude update in updateAttitudeCache() so getters are free of trig
+     */
+    struct AttitudeCache {
+        EulerRotation euler;    // same convention as Quaternion::toEulerZYX()
+        Matrix3 dcm;            // body to world, applies the same rotation as Quaternion::rotate()
+        double sinRoll = 0, cosRoll = 1;    // of euler.x
+        double sinPitch = 0, cosPitch = 1;  // of euler.y
+        double sinYaw = 0, cosYaw = 1;      // of euler.z
+    };
+
+    SensorFusion(SensorInterface* sensors) : sensors(sensors) {
+        updateAttitudeCache();
+    }
 
     virtual ~SensorFusion() {}
 
@@ -50,20 +66,42 @@ public:
         return rot;
     }
 
+    const AttitudeCache& getAttitudeCache() {
+        return attitude;
+    }
+
     EulerRotation getEulerAttitudeZYX() {
-        return rot.toEulerZYX();
+        return attitude.euler;
     }
 
     double getRoll() {
-        return rot.toEulerZYX().x;
+        return attitude.euler.x;
     }
 
     double getPitch() {
-        return rot.toEulerZYX().y;
+        return attitude.euler.y;
     }
 
     double getYaw() {
-        return rot.toEulerZYX().z;
+        return attitude.euler.z;
+    }
+
+    /**
+     * Same as EulerRotation(0, 0, getYaw()).rotate(v) without recomputing the matrix
+     */
+    void rotateYaw(Vec3& v) {
+        double x = v.x;
+        v.x = attitude.cosYaw * x - attitude.sinYaw * v.y;
+        v.y = attitude.sinYaw * x + attitude.cosYaw * v.y;
+    }
+
+    /**
+     * Same as EulerRotation(0, 0, getYaw()).rotateReverse(v)
+     */
+    void rotateYawReverse(Vec3& v) {
+        double x = v.x;
+        v.x =  attitude.cosYaw * x + attitude.sinYaw * v.y;
+        v.y = -attitude.sinYaw * x + attitude.cosYaw * v.y;
     }
 
     Vec3 getVelocity() {
@@ -72,11 +110,47 @@ public:
 
     Vec3 getLocalVelocity() {
         Vec3 velGlobal = vel.clone();
-        EulerRotation zRot = EulerRotation(0,0, getYaw());
-        zRot.rotate(velGlobal);
+        rotateYaw(velGlobal);
         return velGlobal;//(Local)
     }
 
+    /**
+     * Has to be called after every change of rot that should become visible to the getters
+     * Costs one toEulerZYX() (two atan2, one asin) and three square roots. sin/cos are recovered from the same terms
+     */
+    void updateAttitudeCache() {
+        double w = rot.w, x = rot.x, y = rot.y, z = rot.z;
+        attitude.euler = rot.toEulerZYX();
+
+        double t0 = 2.0 * (w * x + y * z);
+        double t1 = 1.0 - 2.0 * (x * x + y * y);
+        double rollNorm = sqrt(t0 * t0 + t1 * t1);
+        attitude.sinRoll = rollNorm > 0 ? t0 / rollNorm : 0;
+        attitude.cosRoll = rollNorm > 0 ? t1 / rollNorm : 1;
+
+        double t2 = 2.0 * (w * y - z * x); // euler.y = -asin(t2)
+        t2 = t2 > 1.0 ? 1.0 : (t2 < -1.0 ? -1.0 : t2);
+        attitude.sinPitch = -t2;
+        attitude.cosPitch = sqrt(1.0 - t2 * t2);
+
+        double t3 = 2.0 * (w * z + x * y); // euler.z = -atan2(t3, t4)
+        double t4 = 1.0 - 2.0 * (y * y + z * z);
+        double yawNorm = sqrt(t3 * t3 + t4 * t4);
+        attitude.sinYaw = yawNorm > 0 ? -t3 / yawNorm : 0;
+        attitude.cosYaw = yawNorm > 0 ? t4 / yawNorm : 1;
+
+        double* m = attitude.dcm.m;
+        m[0] = 1.0 - 2.0 * (y * y + z * z);
+        m[1] = 2.0 * (x * y - w * z);
+        m[2] = 2.0 * (x * z + w * y);
+        m[3] = 2.0 * (x * y + w * z);
+        m[4] = 1.0 - 2.0 * (x * x + z * z);
+        m[5] = 2.0 * (y * z - w * x);
+        m[6] = 2.0 * (x * z - w * y);
+        m[7] = 2.0 * (y * z + w * x);
+        m[8] = 1.0 - 2.0 * (x * x + y * y);
+    }
+
     Vec3 getLocation() {
         return loc;
     }
@@ -93,4 +167,12 @@ protected:
     Quaternion rot;
     Vec3 vel;
     Vec3 loc;
+    AttitudeCache attitude;
+
+    /**
+     * Time between two sample timestamps in micro seconds. 0 for the very first sample
+     */
+    static uint32_t getSampleDeltaUs(uint64_t sampleTime, uint64_t lastSampleTime) {
+        return lastSampleTime == 0 ? 0 : sampleTime - lastSampleTime;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,128 @@
+/**
+ * @file VerticalKalman.h
+ * @author Timo Lehnertz
+ * @brief 3 state Kalman filter for height, climb rate and vertical accelerometer bias
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+/**
+ * Vertical channel Kalman filter
+ *
+ * State: height (m), climb rate (m/s), accelerometer bias (m/s^2)
+ * Predict:  world frame vertical acceleration without gravity, at loop rate
+ * Update:   any height measurement (baro, tilt compensated ultrasonic) as scalar update
+ *
+ * The covariance is symmetric so only its 6 unique entries are kept.
+ * Every call has a constant cost of a few dozen multiplications. No matrices, no trig, no heap
+ */
+class VerticalKalman {
+public:
+    float accNoise = 0.1f;          // m/s^2/sqrt(Hz). Includes vibration
+    float accBiasNoise = 0.01f;     // m/s^3/sqrt(Hz)
+    float maxAccBias = 2.0f;        // m/s^2
+
+    VerticalKalman() {
+        reset(0);
+    }
+
+    /**
+     * Restarts at the given height with zero climb rate. The accelerometer bias is kept
+     */
+    void reset(float height) {
+        h = height;
+        v = 0;
+        p00 = 1.0f;
+        p01 = 0;
+        p02 = 0;
+        p11 = 1.0f;
+        p12 = 0;
+        p22 = 0.1f;
+    }
+
+    /**
+     * @param acc vertical acceleration in world frame with gravity removed in m/s^2 (up positive)
+     * @param dt seconds since the last prediction
+     */
+    void predict(float acc, float dt) {
+        if(dt <= 0) return;
+        float a = acc - bias;
+        float dt2 = dt * dt;
+        h += v * dt + 0.5f * a * dt2;
+        v += a * dt;
+
+        // P = F P F^T + Q with F = | 1 dt -dt^2/2 |
+        //                          | 0 1  -dt     |
+        //                          | 0 0   1      |
+        float halfDt2 = 0.5f * dt2;
+        float r0p2 = p02 + dt * p12 - halfDt2 * p22; // row 0 of F times column 2 of P
+        float r1p2 = p12 - dt * p22;            // row 1 of F times column 2 of P
+        float r0p0 = p00 + dt * p01 - halfDt2 * p02;
+        float r0p1 = p01 + dt * p11 - halfDt2 * p12;
+        float r1p1 = p11 - dt * p12;
+
+        p00 = r0p0 + dt * r0p1 - halfDt2 * r0p2;
+        p01 = r0p1 - dt * r0p2;
+        p02 = r0p2;
+        p11 = r1p1 - dt * r1p2;
+        p12 = r1p2;
+
+        // acceleration noise enters height and climb rate, bias is a random walk
+        float qa = accNoise * accNoise * dt;
+        p00 += qa * dt2 * (1.0f / 3.0f);
+        p01 += qa * 0.5f * dt;
+        p11 += qa;
+        p22 += accBiasNoise * accBiasNoise * dt;
+    }
+
+    /**
+     * @param height measured height in m
+     * @param variance measurement variance in m^2
+     */
+    void updateHeight(float height, float variance) {
+        float s = p00 + variance;
+        if(s <= 0) return;
+        float recipS = 1.0f / s;
+        float k0 = p00 * recipS;
+        float k1 = p01 * recipS;
+        float k2 = p02 * recipS;
+        float innovation = height - h;
+        h += k0 * innovation;
+        v += k1 * innovation;
+        bias += k2 * innovation;
+        if(bias > maxAccBias) bias = maxAccBias;
+        if(bias < -maxAccBias) bias = -maxAccBias;
+
+        // P = (I - K H) P with H = | 1 0 0 |
+        float q00 = p00, q01 = p01, q02 = p02;
+        p00 -= k0 * q00;
+        p01 -= k0 * q01;
+        p02 -= k0 * q02;
+        p11 -= k1 * q01;
+        p12 -= k1 * q02;
+        p22 -= k2 * q02;
+    }
+
+    float getHeight() const {
+        return h;
+    }
+
+    float getClimbRate() const {
+        return v;
+    }
+
+    float getAccBias() const {
+        return bias;
+    }
+
+private:
+    float h = 0;
+    float v = 0;
+    float bias = 0;
+    // upper triangle of the covariance
+    float p00, p01, p02, p11, p12, p22;
+};
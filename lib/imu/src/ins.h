@@ -15,6 +15,9 @@
 #include "SensorFusion.h"
 #include "ComplementaryFilter.h"
 #include "Magdwick.h"
+#include "Mahony.h"
+#include "ErrorStateEKF.h"
+#include "FusionComparator.h"
 
 class INS {
 public:
@@ -22,15 +25,51 @@ public:
     SensorInterface* sensors;
     ComplementaryFilter complementaryFilter;
     MagdwickFilter magdwickFilter;
+    MahonyFilter mahonyFilter;
+    ErrorStateEKF errorStateEKF;
+    FusionComparator shadowComparator;
 
-    INS(SensorInterface* sensors) : sensors(sensors), complementaryFilter(sensors), magdwickFilter(sensors) {}
+    INS(SensorInterface* sensors) : sensors(sensors), complementaryFilter(sensors), magdwickFilter(sensors), mahonyFilter(sensors), errorStateEKF(sensors) {}
 
-    void begin() {getSensorFusion()->begin();}
-    void handle() {getSensorFusion()->handle();}
+    void begin() {getSensorFusion()->begin(); getSensorFusion()->updateAttitudeCache();}
+    void handle() {getSensorFusion()->handle(); getSensorFusion()->updateAttitudeCache();}
 
-    void reset() {getSensorFusion()->reset();}
+    void reset() {getSensorFusion()->reset(); getSensorFusion()->updateAttitudeCache();}
     void resetAltitude() {getSensorFusion()->resetAltitude();}
-    void resetYaw() {getSensorFusion()->resetYaw();}
+    void resetYaw() {getSensorFusion()->resetYaw(); getSensorFusion()->updateAttitudeCache();}
+
+    /**
+     * Shadow mode: a second algorythm is fed the same samples and compared against the active one.
+     * Only call from idle time, never between sensor read and motor output
+     * @param budgetUs time that is left until the next loop may start
+     */
+    void handleShadow(uint32_t budgetUs) {
+        if(!isShadowActive()) return;
+        shadowComparator.handle(getSensorFusion(), getSensorFusion(shadowType), budgetUs);
+    }
+
+    /**
+     * @param algorythm -1 or the active algorythm disables the shadow
+     */
+    void setShadowAlgorythm(int algorythm) {
+        shadowComparator.reset();
+        if(algorythm < 0 || algorythm > SensorFusion::ErrorStateKalman) {
+            shadowEnabled = false;
+            return;
+        }
+        shadowType = (SensorFusion::FusionAlgorythm) algorythm;
+        shadowEnabled = true;
+        if(!isShadowActive()) return;
+        getSensorFusion(shadowType)->begin();
+        getSensorFusion(shadowType)->updateAttitudeCache();
+        shadowComparator.measure(getSensorFusion(shadowType));
+    }
+
+    /**
+     * @return -1 if disabled
+     */
+    int getShadowAlgorythm() {return shadowEnabled ? shadowType : -1;}
+    bool isShadowActive() {return shadowEnabled && shadowType != sensorFusionType;}
 
     bool isAngleSmallerThanDeg(double deg) {
         float roll = getRoll() * RAD_TO_DEG;
@@ -48,14 +87,21 @@ public:
      * Getters /Setters
      */
     SensorFusion::FusionAlgorythm getFusionAlgorythm() {return sensorFusionType;}
-    void setFusionAlgorythm(SensorFusion::FusionAlgorythm algorythm) {sensorFusionType = algorythm; begin();}
-    double getRoll()        {return getEulerRotationZYX().getRoll();}
+    /**
+     * Restarts the shadow as well, it compares against a different fusion now and may have been the active one so far
+     */
+    void setFusionAlgorythm(SensorFusion::FusionAlgorythm algorythm) {
+        sensorFusionType = algorythm;
+        begin();
+        setShadowAlgorythm(getShadowAlgorythm());
+    }
+    double getRoll()        {return getSensorFusion()->getRoll();}
     double getRollRate()    {return sensors->gyro.x;}
     double getMaxRate()     {return max(abs(sensors->gyro.x), max(abs(sensors->gyro.y), abs(sensors->gyro.z)));}
     double getMaxRateExceptYaw()     {return max(abs(sensors->gyro.x), abs(sensors->gyro.y));}
-    double getPitch()       {return getEulerRotationZYX().getPitch();}
+    double getPitch()       {return getSensorFusion()->getPitch();}
     double getPitchRate()   {return sensors->gyro.y;}
-    double getYaw()         {return getEulerRotationZYX().getYaw();}
+    double getYaw()         {return getSensorFusion()->getYaw();}
     double getYawRate()     {return sensors->gyro.z;}
     float getGForce()       {return sensors->acc.getVec3().getLength();}
     double getMagZOffset()  {return getSensorFusion()->getMagZOffset();}
@@ -64,16 +110,26 @@ public:
     Vec3 getVelocity()      {return getSensorFusion()->getVelocity();}
     Vec3 getLocalVelocity()      {return getSensorFusion()->getLocalVelocity();}
     EulerRotation getEulerRotationZYX() {return getSensorFusion()->getEulerAttitudeZYX();}
+    const SensorFusion::AttitudeCache& getAttitudeCache() {return getSensorFusion()->getAttitudeCache();}
+    void rotateYawReverse(Vec3& v) {getSensorFusion()->rotateYawReverse(v);}
     Quaternion getQuaternionRotation() {return getSensorFusion()->getAttitude();}
 
 private:
     SensorFusion::FusionAlgorythm sensorFusionType;
+    SensorFusion::FusionAlgorythm shadowType = SensorFusion::ComplementaryFilter;
+    bool shadowEnabled = false;
 
     SensorFusion* getSensorFusion() {
-        switch(sensorFusionType) {
+        return getSensorFusion(sensorFusionType);
+    }
+
+    SensorFusion* getSensorFusion(SensorFusion::FusionAlgorythm type) {
+        switch(type) {
             case SensorFusion::ComplementaryFilter: return &complementaryFilter;
             case SensorFusion::MagdwickFilter: return &magdwickFilter;
+            case SensorFusion::MahonyFilter: return &mahonyFilter;
+            case SensorFusion::ErrorStateKalman: return &errorStateEKF;
             default: return &complementaryFilter;
         }
-    };
+    }
 };
\ No newline at end of file
@@ -25,6 +25,16 @@ EulerRotation EulerRotation::clone() const {
 }
 
 Matrix3 EulerRotation::getMatrix() const {
+    if(mode == ZYX_EULER) {
+        // closed form of zMat * yMat * xMat
+        double sr = sin(x), cr = cos(x);
+        double sp = sin(y), cp = cos(y);
+        double sy = sin(z), cy = cos(z);
+        return Matrix3(
+            cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr,
+            sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr,
+            -sp,     cp * sr,                cp * cr);
+    }
     Matrix3 xMat(
         1.0, 0.0, 0.0,
         0.0, cos(x), -sin(x),
@@ -57,7 +67,7 @@ void EulerRotation::rotate(Vec3 &v) const {
 }
 
 void EulerRotation::rotateReverse(Vec3 &v) const {
-    v = getMatrix().getTranspose() * v;
+    v = getMatrix().transposeTimes(v);
 }
 
 double EulerRotation::getPitch() {
@@ -80,7 +80,17 @@ Matrix3 Matrix3::operator * (const Matrix3& m2) const {
 // }
 
 Vec3 Matrix3::operator * (const Vec3& v) const {
-    return (*this * v.toMatrix3()).toVec3();
+    return Vec3(
+        m[0] * v.x + m[1] * v.y + m[2] * v.z,
+        m[3] * v.x + m[4] * v.y + m[5] * v.z,
+        m[6] * v.x + m[7] * v.y + m[8] * v.z);
+}
+
+Vec3 Matrix3::transposeTimes(const Vec3& v) const {
+    return Vec3(
+        m[0] * v.x + m[3] * v.y + m[6] * v.z,
+        m[1] * v.x + m[4] * v.y + m[7] * v.z,
+        m[2] * v.x + m[5] * v.y + m[8] * v.z);
 }
 
 Matrix3 Matrix3::getTranspose() const {
@@ -17,13 +17,7 @@ int strpos4(const char* haystack, const char needle, int start = 0) {
   return -1;
 }
 
-Quaternion::Quaternion() : Rotation() {
-    Quaternion f = Quaternion::getForward();
-    w = f.w;
-    x = f.x;
-    y = f.y;
-    z = f.z;
-}
+Quaternion::Quaternion() : Rotation(1, 0, 0, 0) {} // same as getForward() without the trig
 
 Quaternion::Quaternion(double w, double x, double y, double z) : Rotation(w, x, y, z) {}
 
@@ -125,11 +119,11 @@ double Quaternion::lengthSquared() const {
 EulerRotation Quaternion::toEulerZYX() const {
     double t0 = 2.0 * (w * x + y * z);
     double t1 = 1.0 - 2.0 * (x * x + y * y);
-    double roll = atan2(t0, t1);//
+    double roll = atan2(t0, t1);
 
     double t2 = 2.0 * (w * y - z * x);
     t2 = t2 > 1.0 ? 1.0 : t2;
-    t2 = t2 < -1.0 ? 1.0 : t2;
+    t2 = t2 < -1.0 ? -1.0 : t2;
     double pitch = asin(t2);
 
     double t3 = 2.0 * (w * z + x * y);
@@ -188,7 +182,7 @@ Quaternion Quaternion::operator * (const Quaternion &q) const {
     return qres.multiply(q);
 }
 
-Quaternion Quaternion::operator *= (const Quaternion &q) {
+Quaternion& Quaternion::operator *= (const Quaternion &q) {
     multiply(q);
     return *this;
 }
@@ -217,35 +211,109 @@ Quaternion Quaternion::clone() const {
     return Quaternion(w, x, y, z);
 }
 
+/**
+ * v' = q * v * q^-1 expanded to two cross products:
+ * v' = v + 2 / |q|^2 * (w * (u x v) + u x (u x v)) with u = (x, y, z)
+ */
 void Quaternion::rotate(Vec3 &v) const {
-    Quaternion p(v);
-    Quaternion q = clone();
-    q.normalize();
-    q *= p;
-    q.multiply(clone().conjugate().normalize());
-    v.setFrom(q);
+    double s = 2.0 / (w * w + x * x + y * y + z * z);
+    double tx = y * v.z - z * v.y;  // u x v
+    double ty = z * v.x - x * v.z;
+    double tz = x * v.y - y * v.x;
+    double cx = y * tz - z * ty;    // u x (u x v)
+    double cy = z * tx - x * tz;
+    double cz = x * ty - y * tx;
+    v.x += s * (w * tx + cx);
+    v.y += s * (w * ty + cy);
+    v.z += s * (w * tz + cz);
 }
 
 void Quaternion::rotateZ(Vec3 &v) const {
-    Quaternion q = Quaternion(EulerRotation(0,0,toEulerZYX().z));
-    q.rotate(v);
+    double t3 = 2.0 * (w * z + x * y);
+    double t4 = 1.0 - 2.0 * (y * y + z * z);
+    double n = sqrt(t3 * t3 + t4 * t4);
+    if(n <= 0) return;
+    rotateZ(v, -t3 / n, t4 / n); // toEulerZYX().z = -atan2(t3, t4)
 }
 
+/**
+ * Same as rotate with the conjugate (u = -u)
+ */
 void Quaternion::rotateReverse(Vec3 &v) const {
-    double len = v.getLength();
-    // v.x *= -1;
-    v /= len;
-    Quaternion p(v);
-    Quaternion q = clone().conjugate();
-    q.normalize();
-    q *= p;
-    q.multiply(clone().normalize());
-    v.setFrom(q);
-    // v.x *= -1;
-    v *= len;
+    double s = 2.0 / (w * w + x * x + y * y + z * z);
+    double tx = z * v.y - y * v.z;
+    double ty = x * v.z - z * v.x;
+    double tz = y * v.x - x * v.y;
+    double cx = z * ty - y * tz;
+    double cy = x * tz - z * tx;
+    double cz = y * tx - x * ty;
+    v.x += s * (w * tx + cx);
+    v.y += s * (w * ty + cy);
+    v.z += s * (w * tz + cz);
 }
 
 void Quaternion::rotateReverseZ(Vec3 &v) const {
-    Quaternion q = Quaternion(EulerRotation(0,0,toEulerZYX().z));
-    q.rotateReverse(v);
-}
\ No newline at end of file
+    double t3 = 2.0 * (w * z + x * y);
+    double t4 = 1.0 - 2.0 * (y * y + z * z);
+    double n = sqrt(t3 * t3 + t4 * t4);
+    if(n <= 0) return;
+    rotateReverseZ(v, -t3 / n, t4 / n);
+}
+
+void Quaternion::rotateZ(Vec3 &v, double sinYaw, double cosYaw) {
+    double vx = v.x;
+    v.x = cosYaw * vx - sinYaw * v.y;
+    v.y = sinYaw * vx + cosYaw * v.y;
+}
+
+void Quaternion::rotateReverseZ(Vec3 &v, double sinYaw, double cosYaw) {
+    double vx = v.x;
+    v.x =  cosYaw * vx + sinYaw * v.y;
+    v.y = -sinYaw * vx + cosYaw * v.y;
+}
+
+void Quaternion::integrateFirstOrder(const Vec3 &rate, double dt) {
+    double hx = rate.x * dt * 0.5;
+    double hy = rate.y * dt * 0.5;
+    double hz = rate.z * dt * 0.5;
+    double qw = w, qx = x, qy = y, qz = z;
+    w += -qx * hx - qy * hy - qz * hz;
+    x +=  qw * hx + qy * hz - qz * hy;
+    y +=  qw * hy - qx * hz + qz * hx;
+    z +=  qw * hz + qx * hy - qy * hx;
+    normalizeIfNeeded();
+}
+
+void Quaternion::integrateSecondOrder(const Vec3 &rate, double dt) {
+    double ax = rate.x * dt;
+    double ay = rate.y * dt;
+    double az = rate.z * dt;
+    double angle2 = ax * ax + ay * ay + az * az;
+    // exp(a / 2) = (cos(|a| / 2), a * sin(|a| / 2) / |a|)
+    double dw = 1.0 - angle2 * (1.0 / 8.0);
+    double s = 0.5 - angle2 * (1.0 / 48.0);
+    double hx = ax * s, hy = ay * s, hz = az * s;
+    double qw = w, qx = x, qy = y, qz = z;
+    w = qw * dw - qx * hx - qy * hy - qz * hz;
+    x = qw * hx + qx * dw + qy * hz - qz * hy;
+    y = qw * hy - qx * hz + qy * dw + qz * hx;
+    z = qw * hz + qx * hy - qy * hx + qz * dw;
+    normalizeIfNeeded();
+}
+
+bool Quaternion::normalizeIfNeeded(double tolerance) {
+    double n2 = w * w + x * x + y * y + z * z;
+    double error = n2 - 1.0;
+    if(error < tolerance && error > -tolerance) return false;
+    if(error < 0.01 && error > -0.01) {
+        // 1 / sqrt(n2) ~ 1.5 - 0.5 * n2 close to 1
+        double f = 1.5 - 0.5 * n2;
+        w *= f;
+        x *= f;
+        y *= f;
+        z *= f;
+    } else {
+        normalize();
+    }
+    return true;
+}
@@ -90,8 +90,8 @@ double Vec3::dot(const Vec3& v) const {
 
 Vec3 Vec3::crossProduct(const Vec3& v) const {
     Vec3 res;
-    res.x = y * v.z - z * y;
-    res.y = -(x * v.z - z * x);
+    res.x = y * v.z - z * v.y;
+    res.y = z * v.x - x * v.z;
     res.z = x * v.y - y * v.x;
     return res;
 }
@@ -217,27 +217,35 @@ Vec3 Vec3::operator ^ (const Vec3& v) const {
 }
 
 
-Vec3 Vec3::operator += (const Vec3& v) {
-    *this = *this + v;
+Vec3& Vec3::operator += (const Vec3& v) {
+    x += v.x;
+    y += v.y;
+    z += v.z;
     return *this;
 }
 
-Vec3 Vec3::operator -= (const Vec3& v) {
-    *this = *this - v;
+Vec3& Vec3::operator -= (const Vec3& v) {
+    x -= v.x;
+    y -= v.y;
+    z -= v.z;
     return *this;
 }
 
-Vec3 Vec3::operator *= (const Vec3& v) {
-    *this = *this * v;
+Vec3& Vec3::operator *= (const Vec3& v) {
+    x *= v.x;
+    y *= v.y;
+    z *= v.z;
     return *this;
 }
 
-Vec3 Vec3::operator /= (const Vec3& v) {
-    *this = *this / v;
+Vec3& Vec3::operator /= (const Vec3& v) {
+    x /= v.x;
+    y /= v.y;
+    z /= v.z;
     return *this;
 }
 
-Vec3 Vec3::operator ^= (const Vec3& v) {
+Vec3& Vec3::operator ^= (const Vec3& v) {
     *this = *this ^ v;
     return *this;
 }
@@ -271,38 +279,46 @@ Vec3 Vec3::operator ^ (double s) const {
     return Vec3(pow(x, s), pow(y, s), pow(z, s));
 }
 
-Vec3 Vec3::operator += (double s) {
-    *this = *this + s;
+Vec3& Vec3::operator += (double s) {
+    x += s;
+    y += s;
+    z += s;
     return *this;
 }
 
-Vec3 Vec3::operator -= (double s) {
-    *this = *this - s;
+Vec3& Vec3::operator -= (double s) {
+    x -= s;
+    y -= s;
+    z -= s;
     return *this;
 }
 
-Vec3 Vec3::operator *= (double s) {
-    *this = *this * s;
+Vec3& Vec3::operator *= (double s) {
+    x *= s;
+    y *= s;
+    z *= s;
     return *this;
 }
 
-Vec3 Vec3::operator /= (double s) {
-    *this = *this / s;
+Vec3& Vec3::operator /= (double s) {
+    x /= s;
+    y /= s;
+    z /= s;
     return *this;
 }
 
-Vec3 Vec3::operator ^= (double s) {
+Vec3& Vec3::operator ^= (double s) {
     *this = *this ^ s;
     return *this;
 }
 
 
-Vec3 Vec3::operator = (const Vec3& v) {
+Vec3& Vec3::operator = (const Vec3& v) {
     setFrom(v);
     return *this;
 }
 
-Vec3 Vec3::operator = (const Matrix3& m) {
+Vec3& Vec3::operator = (const Matrix3& m) {
     setFrom(m);
     return *this;
 }
@@ -0,0 +1,176 @@
+/**
+ * @file fastMath.h
+ * @author Timo Lehnertz
+ * @brief Bounded error float approximations for trig, sqrt and exp on the hot paths
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Build wide default for Trig<>. -DFAST_MATH=0 switches every call site that uses FastTrig back to libm
+ */
+#ifndef FAST_MATH
+#define FAST_MATH 1
+#endif
+
+/**
+ * Polynomial approximations. Maximum errors are measured over the full input range against double precision libm
+ */
+struct FastMath {
+    static constexpr float PI_F = 3.14159265f;
+    static constexpr float HALF_PI_F = 1.57079633f;
+
+    /**
+     * Max error 3.3e-7 rad (1.9e-5 deg). 0 for atan2(0, 0)
+     */
+    static float atan2(float y, float x) {
+        float ax = x < 0 ? -x : x;
+        float ay = y < 0 ? -y : y;
+        float maxAbs = ax > ay ? ax : ay;
+        if(maxAbs == 0) return 0;
+        float a = (ax < ay ? ax : ay) / maxAbs;
+        float r = atanUnit(a);
+        if(ay > ax) r = HALF_PI_F - r;
+        if(x < 0) r = PI_F - r;
+        return y < 0 ? -r : r;
+    }
+
+    /**
+     * Max error 3.0e-7 rad. Input is clamped to -1 - 1
+     */
+    static float asin(float x) {
+        bool negative = x < 0;
+        if(negative) x = -x;
+        if(x > 1) x = 1;
+        // Abramowitz & Stegun 4.4.46
+        float p = -0.0012624911f;
+        p = p * x + 0.0066700901f;
+        p = p * x - 0.0170881256f;
+        p = p * x + 0.0308918810f;
+        p = p * x - 0.0501743046f;
+        p = p * x + 0.0889789874f;
+        p = p * x - 0.2145988016f;
+        p = p * x + 1.5707963050f;
+        float r = HALF_PI_F - sqrtf(1 - x) * p;
+        return negative ? -r : r;
+    }
+
+    /**
+     * Max error 1.1e-7 for |angle| <= 100 rad. Accuracy drops with the size of the argument because of the float range reduction
+     */
+    static void sincos(float angle, float& s, float& c) {
+        // reduce to -pi/4 - pi/4 and a quadrant
+        float q = angle * (2.0f / PI_F);
+        int quadrant = (int) (q < 0 ? q - 0.5f : q + 0.5f);
+        float x = (angle - quadrant * 1.5703125f) - quadrant * 4.83826794897e-4f; // pi/2 split in two for precision
+        float x2 = x * x;
+        float sx = x + x * x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f + x2 * (1.0f / 362880.0f))));
+        float cx = 1.0f + x2 * (-0.5f + x2 * (1.0f / 24.0f + x2 * (-1.0f / 720.0f + x2 * (1.0f / 40320.0f))));
+        switch(quadrant & 3) {
+            case 0: s = sx;  c = cx;  break;
+            case 1: s = cx;  c = -sx; break;
+            case 2: s = -sx; c = -cx; break;
+            default: s = -cx; c = sx; break;
+        }
+    }
+
+    static float sin(float angle) {
+        float s, c;
+        sincos(angle, s, c);
+        return s;
+    }
+
+    static float cos(float angle) {
+        float s, c;
+        sincos(angle, s, c);
+        return c;
+    }
+
+    /**
+     * 1 / sqrt(x). Bit estimate and two newton steps. Max relative error 4.7e-6. x has to be > 0
+     */
+    static float rsqrt(float x) {
+        uint32_t i;
+        memcpy(&i, &x, sizeof(i));
+        i = 0x5f375a86 - (i >> 1);
+        float y;
+        memcpy(&y, &i, sizeof(y));
+        float halfX = 0.5f * x;
+        y = y * (1.5f - halfX * y * y);
+        y = y * (1.5f - halfX * y * y);
+        return y;
+    }
+
+    /**
+     * e^x. Max relative error 2.6e-7 for -87 < x < 88. Meant for filter coefficients like exp(-2 pi fc dt)
+     */
+    static float exp(float x) {
+        if(x < -87.0f) return 0;
+        if(x > 88.0f) x = 88.0f;
+        // e^x = 2^n * 2^f with n integer and f in -0.5 - 0.5
+        float t = x * 1.44269504f;
+        int n = (int) (t < 0 ? t - 0.5f : t + 0.5f);
+        float f = (x - n * 0.693359375f) + n * 2.12194440e-4f; // ln2 split in two for precision
+        float p = 1.0f + f * (1.0f + f * (0.5f + f * (1.0f / 6.0f + f * (1.0f / 24.0f + f * (1.0f / 120.0f + f * (1.0f / 720.0f))))));
+        uint32_t bits = (uint32_t) (n + 127) << 23;
+        float scale;
+        memcpy(&scale, &bits, sizeof(scale));
+        return p * scale;
+    }
+
+private:
+    /**
+     * atan for 0 <= a <= 1
+     */
+    static float atanUnit(float a) {
+        float a2 = a * a;
+        float p = -0.0040540580f;
+        p = p * a2 + 0.0218612288f;
+        p = p * a2 - 0.0559098861f;
+        p = p * a2 + 0.0964200441f;
+        p = p * a2 - 0.1390853351f;
+        p = p * a2 + 0.1994653599f;
+        p = p * a2 - 0.3332985605f;
+        p = p * a2 + 0.9999993329f;
+        return p * a;
+    }
+};
+
+/**
+ * Compile time choice between libm and FastMath. Every call site picks its own:
+ *  Trig<true>  always the approximations
+ *  Trig<false> always libm (float versions)
+ *  FastTrig    follows FAST_MATH
+ */
+template<bool FAST>
+struct Trig {
+    static float atan2(float y, float x) { return FastMath::atan2(y, x); }
+    static float asin(float x) { return FastMath::asin(x); }
+    static float sin(float x) { return FastMath::sin(x); }
+    static float cos(float x) { return FastMath::cos(x); }
+    static void sincos(float x, float& s, float& c) { FastMath::sincos(x, s, c); }
+    static float sqrt(float x) { return x > 0 ? sqrtf(x) : 0; } // VSQRT is a single instruction on the M7
+    static float rsqrt(float x) { return FastMath::rsqrt(x); }
+    static float exp(float x) { return FastMath::exp(x); }
+};
+
+template<>
+struct Trig<false> {
+    static float atan2(float y, float x) { return atan2f(y, x); }
+    static float asin(float x) { return asinf(x < -1 ? -1 : (x > 1 ? 1 : x)); }
+    static float sin(float x) { return sinf(x); }
+    static float cos(float x) { return cosf(x); }
+    static void sincos(float x, float& s, float& c) { s = sinf(x); c = cosf(x); }
+    static float sqrt(float x) { return x > 0 ? sqrtf(x) : 0; }
+    static float rsqrt(float x) { return 1.0f / sqrtf(x); }
+    static float exp(float x) { return expf(x); }
+};
+
+using FastTrig = Trig<FAST_MATH != 0>;
@@ -0,0 +1,89 @@
+/**
+ * @file fixedPoint.h
+ * @author Timo Lehnertz
+ * @brief Saturating Q15 / Q31 arithmetic with Cortex-M7 DSP instructions and a portable fallback
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <stdint.h>
+
+/**
+ * Q31: int32_t, 1.0 = 2^31. Q15: int16_t, 1.0 = 2^15.
+ *
+ * With __ARM_FEATURE_DSP (Teensy 4) the saturating operations are single instructions (QADD, QSUB, SSAT).
+ * Everywhere else the same results come from plain C so host builds can compare against the float path
+ */
+struct FixedPoint {
+
+    /**
+     * Saturating a + b
+     */
+    static inline int32_t add(int32_t a, int32_t b) {
+#if defined(__ARM_FEATURE_DSP)
+        int32_t res;
+        asm("qadd %0, %1, %2" : "=r" (res) : "r" (a), "r" (b));
+        return res;
+#else
+        return clamp32((int64_t) a + b);
+#endif
+    }
+
+    /**
+     * Saturating a - b
+     */
+    static inline int32_t sub(int32_t a, int32_t b) {
+#if defined(__ARM_FEATURE_DSP)
+        int32_t res;
+        asm("qsub %0, %1, %2" : "=r" (res) : "r" (a), "r" (b));
+        return res;
+#else
+        return clamp32((int64_t) a - b);
+#endif
+    }
+
+    /**
+     * Saturates to the Q15 range
+     */
+    static inline int16_t sat16(int32_t a) {
+#if defined(__ARM_FEATURE_DSP)
+        int32_t res;
+        asm("ssat %0, #16, %1" : "=r" (res) : "r" (a));
+        return res;
+#else
+        return a > 32767 ? 32767 : (a < -32768 ? -32768 : a);
+#endif
+    }
+
+    /**
+     * Q31 * Q15 -> Q31, saturated. One SMULL and a shift on the M7
+     */
+    static inline int32_t mulQ31Q15(int32_t a, int32_t b) {
+        return clamp32(((int64_t) a * b) >> 15);
+    }
+
+    /**
+     * a * b >> shift with a 64 bit intermediate, saturated
+     */
+    static inline int32_t mulShift(int32_t a, int32_t b, int shift) {
+        return clamp32(((int64_t) a * b) >> shift);
+    }
+
+    static inline int32_t clamp32(int64_t a) {
+        return a > INT32_MAX ? INT32_MAX : (a < INT32_MIN ? INT32_MIN : (int32_t) a);
+    }
+
+    static inline int32_t fromFloat(float value, int fractionBits) {
+        float scaled = value * (float) (1UL << fractionBits);
+        if(scaled >= 2147483520.0f) return INT32_MAX; // largest float below 2^31
+        if(scaled <= -2147483648.0f) return INT32_MIN;
+        return (int32_t) (scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+    }
+
+    static inline float toFloat(int32_t value, int fractionBits) {
+        return value * (1.0f / (float) (1UL << fractionBits));
+    }
+};
@@ -0,0 +1,107 @@
+/**
+ * @file geodesy.h
+ * @author Timo Lehnertz
+ * @brief Local tangent plane around a GPS origin
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <math.h>
+
+/**
+ * Flat earth projection around an origin, usually the position at arm
+ *
+ * Meters per degree are computed once for the origin latitude (WGS84 series). After that a fix is converted with
+ * two subtractions and two multiplications. The flat earth error stays below 0.1% within a few kilometers of the origin
+ *
+ * Axes: north and east in meters. Bearings are in degrees clockwise from north
+ */
+class LocalTangentPlane {
+public:
+
+    /**
+     * Fixes the origin and precomputes the scale factors for its latitude
+     */
+    void setOrigin(double lat, double lng) {
+        originLat = lat;
+        originLng = lng;
+        double phi = lat * (M_PI / 180.0);
+        metersPerDegLat = 111132.92 - 559.82 * cos(2 * phi) + 1.175 * cos(4 * phi);
+        metersPerDegLng = 111412.84 * cos(phi) - 93.5 * cos(3 * phi);
+        originSet = true;
+    }
+
+    void clearOrigin() {
+        originSet = false;
+    }
+
+    bool hasOrigin() const {
+        return originSet;
+    }
+
+    double getOriginLat() const {
+        return originLat;
+    }
+
+    double getOriginLng() const {
+        return originLng;
+    }
+
+    /**
+     * Position of a fix relative to the origin in meters
+     */
+    void toLocal(double lat, double lng, float& north, float& east) const {
+        north = (lat - originLat) * metersPerDegLat;
+        east = (lng - originLng) * metersPerDegLng;
+    }
+
+    /**
+     * Inverse of toLocal
+     */
+    void toGlobal(float north, float east, double& lat, double& lng) const {
+        lat = originLat + north / metersPerDegLat;
+        lng = originLng + east / metersPerDegLng;
+    }
+
+    /**
+     * Distance and bearing from a fix to the origin. Used for return to home and the home indicator
+     * @param bearingDeg 0 - 360 clockwise from north
+     * @return distance in meters
+     */
+    float toOrigin(double lat, double lng, float& bearingDeg) const {
+        float north, east;
+        toLocal(lat, lng, north, east);
+        return bearingDistance(-north, -east, bearingDeg);
+    }
+
+    /**
+     * Distance and bearing between two fixes near the origin
+     * @param bearingDeg 0 - 360 clockwise from north
+     * @return distance in meters
+     */
+    float fromTo(double lat1, double lng1, double lat2, double lng2, float& bearingDeg) const {
+        float north = (lat2 - lat1) * metersPerDegLat;
+        float east = (lng2 - lng1) * metersPerDegLng;
+        return bearingDistance(north, east, bearingDeg);
+    }
+
+    /**
+     * @param bearingDeg 0 - 360 clockwise from north
+     * @return length of the vector
+     */
+    static float bearingDistance(float north, float east, float& bearingDeg) {
+        bearingDeg = atan2f(east, north) * (float) (180.0 / M_PI);
+        if(bearingDeg < 0) bearingDeg += 360;
+        return sqrtf(north * north + east * east);
+    }
+
+private:
+    bool originSet = false;
+    double originLat = 0;
+    double originLng = 0;
+    double metersPerDegLat = 111319.5; // equator until an origin is set
+    double metersPerDegLng = 111319.5;
+};
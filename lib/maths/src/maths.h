@@ -10,6 +10,8 @@
  */
 #pragma once
 #include <Arduino.h>
+#include "vector3.h"
+#include "quaternion.h"
 
 class Vec3;
 class Quaternion;
@@ -28,6 +30,7 @@ public:
 
     Matrix3 operator * (const Matrix3&) const;
     Vec3 operator * (const Vec3&) const;
+    Vec3 transposeTimes(const Vec3&) const; // getTranspose() * v without building the transpose
     // String toString () const {
     //     return String("") + m[0] + String(",") + m[1] + String(",") + m[2] + String(",") + m[3] + String(",") + m[4] + String(",") + m[5] + String(",") + m[6] + String(",") + m[7] + String(",") + m[8] + String(",");
     //     // String s("");
@@ -50,6 +53,17 @@ struct Vec3 {
     Vec3(double, double, double);
     Vec3(double[]);
 
+    /**
+     * Compatibility with the header only float core (vector3.h)
+     */
+    template<typename T>
+    Vec3(const Vector3<T>& v) : x(v.x), y(v.y), z(v.z) {}
+
+    template<typename T = float>
+    Vector3<T> toVector3() const {
+        return Vector3<T>(x, y, z);
+    }
+
     double getLength() const;
     double getLength2D() const;
     void setLength(double len);
@@ -97,11 +111,11 @@ struct Vec3 {
     Vec3 operator / (const Vec3&) const;
     Vec3 operator ^ (const Vec3&) const;
 
-    Vec3 operator += (const Vec3&);
-    Vec3 operator -= (const Vec3&);
-    Vec3 operator *= (const Vec3&);
-    Vec3 operator /= (const Vec3&);
-    Vec3 operator ^= (const Vec3&);
+    Vec3& operator += (const Vec3&);
+    Vec3& operator -= (const Vec3&);
+    Vec3& operator *= (const Vec3&);
+    Vec3& operator /= (const Vec3&);
+    Vec3& operator ^= (const Vec3&);
 
     // scalar operators
     Vec3 operator + (double) const;
@@ -112,14 +126,14 @@ struct Vec3 {
     // Vec3 operator / (long) const;
     Vec3 operator ^ (double) const;
 
-    Vec3 operator += (double);
-    Vec3 operator -= (double);
-    Vec3 operator *= (double);
-    Vec3 operator /= (double);
-    Vec3 operator ^= (double);
+    Vec3& operator += (double);
+    Vec3& operator -= (double);
+    Vec3& operator *= (double);
+    Vec3& operator /= (double);
+    Vec3& operator ^= (double);
 
-    Vec3 operator = (const Vec3&);
-    Vec3 operator = (const Matrix3&);
+    Vec3& operator = (const Vec3&);
+    Vec3& operator = (const Matrix3&);
 
     bool operator == (const Vec3&) const;
     bool operator != (const Vec3&) const;
@@ -218,7 +232,18 @@ public:
     Quaternion(const EulerRotation&);
     Quaternion(const Vec3&, double theta);
     Quaternion(char* str);
-    
+
+    /**
+     * Compatibility with the header only float core (quaternion.h)
+     */
+    template<typename T>
+    Quaternion(const QuaternionT<T>& q) : Rotation(q.w, q.x, q.y, q.z) {}
+
+    template<typename T = float>
+    QuaternionT<T> toQuaternionT() const {
+        return QuaternionT<T>(w, x, y, z);
+    }
+
     void setFromAngle(const Vec3&, double);
     void setFromEuler(const EulerRotation&);
 
@@ -229,6 +254,30 @@ public:
     void rotateReverse(Vec3&) const;
     void rotateReverseZ(Vec3&) const;
 
+    /**
+     * Yaw only rotation from a cached sin / cos of toEulerZYX().z. Same result as rotateZ / rotateReverseZ without any trig
+     */
+    static void rotateZ(Vec3& v, double sinYaw, double cosYaw);
+    static void rotateReverseZ(Vec3& v, double sinYaw, double cosYaw);
+
+    /**
+     * Integrates an angular rate in body axes: q = q * exp(rate * dt / 2)
+     * First order: q += 1/2 * q * rate * dt. Good for angles well below 1deg per call
+     * Second order: truncated series of the exact increment. Good up to a few degrees per call
+     * Both renormalize only when the length has drifted (see normalizeIfNeeded)
+     * @param rate rad/s
+     * @param dt seconds
+     */
+    void integrateFirstOrder(const Vec3& rate, double dt);
+    void integrateSecondOrder(const Vec3& rate, double dt);
+
+    /**
+     * Renormalizes only if the squared length is off by more than tolerance.
+     * Small errors are corrected with one newton step instead of a sqrt and division
+     * @return true if the quaternion was changed
+     */
+    bool normalizeIfNeeded(double tolerance = 1e-6);
+
     Quaternion normalize();
     Quaternion conjugate();
     Quaternion calibrate(double limit = 80); // compensate for potential gimbal lock from conversions
@@ -250,7 +299,7 @@ public:
 
     Quaternion operator * (const Quaternion&) const;
     Quaternion operator * (double) const;
-    Quaternion operator *= (const Quaternion&);
+    Quaternion& operator *= (const Quaternion&);
     Quaternion operator * (const Vec3&) const;
 
     Quaternion operator + (const Quaternion&) const;
@@ -0,0 +1,242 @@
+/**
+ * @file matrix.h
+ * @author Timo Lehnertz
+ * @brief Fixed size matrices for estimators. No heap, sizes known at compile time
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include "vector3.h"
+
+/**
+ * Dot products of rows and columns, unrolled at compile time
+ */
+template<int I, int K>
+struct MatrixDot {
+    template<int C, typename T>
+    static T rowCol(const T (&row)[K], const T (&b)[K][C], int col) {
+        return row[I] * b[I][col] + MatrixDot<I + 1, K>::rowCol(row, b, col);
+    }
+
+    template<int C, typename T>
+    static T rowRow(const T (&row)[K], const T (&b)[C][K], int bRow) {
+        return row[I] * b[bRow][I] + MatrixDot<I + 1, K>::rowRow(row, b, bRow);
+    }
+
+    template<int CA, int CB, typename T>
+    static T colCol(const T (&a)[K][CA], int aCol, const T (&b)[K][CB], int bCol) {
+        return a[I][aCol] * b[I][bCol] + MatrixDot<I + 1, K>::colCol(a, aCol, b, bCol);
+    }
+};
+
+template<int K>
+struct MatrixDot<K, K> {
+    template<int C, typename T>
+    static T rowCol(const T (&)[K], const T (&)[K][C], int) { return 0; }
+
+    template<int C, typename T>
+    static T rowRow(const T (&)[K], const T (&)[C][K], int) { return 0; }
+
+    template<int CA, int CB, typename T>
+    static T colCol(const T (&)[K][CA], int, const T (&)[K][CB], int) { return 0; }
+};
+
+/**
+ * Row major R x C matrix
+ */
+template<int R, int C, typename T = float>
+struct Matrix {
+    static constexpr int rows = R;
+    static constexpr int cols = C;
+
+    T m[R][C];
+
+    T& operator()(int row, int col) { return m[row][col]; }
+    const T& operator()(int row, int col) const { return m[row][col]; }
+
+    static Matrix zeros() {
+        Matrix res;
+        res.setZero();
+        return res;
+    }
+
+    static Matrix identity() {
+        static_assert(R == C, "identity needs a square matrix");
+        Matrix res;
+        res.setZero();
+        for (int i = 0; i < R; i++) {
+            res.m[i][i] = 1;
+        }
+        return res;
+    }
+
+    void setZero() {
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < C; c++) {
+                m[r][c] = 0;
+            }
+        }
+    }
+
+    Matrix<C, R, T> transpose() const {
+        Matrix<C, R, T> res;
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < C; c++) {
+                res.m[c][r] = m[r][c];
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Mirrors the upper triangle into the lower one
+     */
+    void copyUpperToLower() {
+        static_assert(R == C, "symmetry needs a square matrix");
+        for (int r = 1; r < R; r++) {
+            for (int c = 0; c < r; c++) {
+                m[r][c] = m[c][r];
+            }
+        }
+    }
+
+    template<int C2>
+    Matrix<R, C2, T> operator * (const Matrix<C, C2, T>& b) const {
+        Matrix<R, C2, T> res;
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < C2; c++) {
+                res.m[r][c] = MatrixDot<0, C>::rowCol(m[r], b.m, c);
+            }
+        }
+        return res;
+    }
+
+    /**
+     * this * b^T without building the transpose
+     */
+    template<int R2>
+    Matrix<R, R2, T> timesTranspose(const Matrix<R2, C, T>& b) const {
+        Matrix<R, R2, T> res;
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < R2; c++) {
+                res.m[r][c] = MatrixDot<0, C>::rowRow(m[r], b.m, c);
+            }
+        }
+        return res;
+    }
+
+    /**
+     * this^T * b without building the transpose
+     */
+    template<int C2>
+    Matrix<C, C2, T> transposeTimes(const Matrix<R, C2, T>& b) const {
+        Matrix<C, C2, T> res;
+        for (int r = 0; r < C; r++) {
+            for (int c = 0; c < C2; c++) {
+                res.m[r][c] = MatrixDot<0, R>::colCol(m, r, b.m, c);
+            }
+        }
+        return res;
+    }
+
+    /**
+     * 3 x 3 times vector, 9 multiplications
+     */
+    Vector3<T> operator * (const Vector3<T>& v) const {
+        static_assert(R == 3 && C == 3, "vector product needs a 3 x 3 matrix");
+        return Vector3<T>(
+            m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+            m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+            m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+    }
+
+    /**
+     * this^T * v. For rotation matrices this is the reverse rotation
+     */
+    Vector3<T> transposeTimes(const Vector3<T>& v) const {
+        static_assert(R == 3 && C == 3, "vector product needs a 3 x 3 matrix");
+        return Vector3<T>(
+            m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+            m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+            m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z);
+    }
+
+    /**
+     * Closed form Rz(yaw) * Ry(pitch) * Rx(roll) from cached sin / cos. Same matrix as EulerRotation::getMatrix() in ZYX mode
+     */
+    static Matrix rotationZYX(T sinRoll, T cosRoll, T sinPitch, T cosPitch, T sinYaw, T cosYaw) {
+        static_assert(R == 3 && C == 3, "rotation needs a 3 x 3 matrix");
+        Matrix res;
+        res.m[0][0] = cosYaw * cosPitch;
+        res.m[0][1] = cosYaw * sinPitch * sinRoll - sinYaw * cosRoll;
+        res.m[0][2] = cosYaw * sinPitch * cosRoll + sinYaw * sinRoll;
+        res.m[1][0] = sinYaw * cosPitch;
+        res.m[1][1] = sinYaw * sinPitch * sinRoll + cosYaw * cosRoll;
+        res.m[1][2] = sinYaw * sinPitch * cosRoll - cosYaw * sinRoll;
+        res.m[2][0] = -sinPitch;
+        res.m[2][1] = cosPitch * sinRoll;
+        res.m[2][2] = cosPitch * cosRoll;
+        return res;
+    }
+
+    static Matrix rotationZYX(T roll, T pitch, T yaw) {
+        return rotationZYX(Scalar<T>::sin(roll), Scalar<T>::cos(roll), Scalar<T>::sin(pitch), Scalar<T>::cos(pitch), Scalar<T>::sin(yaw), Scalar<T>::cos(yaw));
+    }
+
+    Matrix operator * (T s) const {
+        Matrix res;
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < C; c++) {
+                res.m[r][c] = m[r][c] * s;
+            }
+        }
+        return res;
+    }
+
+    Matrix operator + (const Matrix& b) const {
+        Matrix res;
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < C; c++) {
+                res.m[r][c] = m[r][c] + b.m[r][c];
+            }
+        }
+        return res;
+    }
+
+    Matrix operator - (const Matrix& b) const {
+        Matrix res;
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < C; c++) {
+                res.m[r][c] = m[r][c] - b.m[r][c];
+            }
+        }
+        return res;
+    }
+
+    Matrix& operator += (const Matrix& b) {
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < C; c++) {
+                m[r][c] += b.m[r][c];
+            }
+        }
+        return *this;
+    }
+
+    Matrix& operator -= (const Matrix& b) {
+        for (int r = 0; r < R; r++) {
+            for (int c = 0; c < C; c++) {
+                m[r][c] -= b.m[r][c];
+            }
+        }
+        return *this;
+    }
+};
+
+template<int N, typename T = float>
+using Vector = Matrix<N, 1, T>;
+
+template<typename T = float>
+using Matrix3T = Matrix<3, 3, T>;
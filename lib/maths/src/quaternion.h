@@ -0,0 +1,155 @@
+/**
+ * @file quaternion.h
+ * @author Timo Lehnertz
+ * @brief Header only quaternion templated on the scalar type
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include "vector3.h"
+
+/**
+ * Hamilton quaternion (w, x, y, z) with the same conventions as Quaternion in maths.h:
+ * a * b applies b in the frame of a, rotate(v) = q * v * q^-1, toEulerZYX() returns (roll, -pitch, -yaw).
+ *
+ * Rotations are plain member functions, not virtual. Compound operators work in place and return a reference
+ */
+template<typename T = float>
+struct QuaternionT {
+    T w, x, y, z;
+
+    constexpr QuaternionT() : w(1), x(0), y(0), z(0) {}
+    constexpr QuaternionT(T w, T x, T y, T z) : w(w), x(x), y(y), z(z) {}
+
+    template<typename U>
+    constexpr explicit QuaternionT(const QuaternionT<U>& q) : w(T(q.w)), x(T(q.x)), y(T(q.y)), z(T(q.z)) {}
+
+    static constexpr QuaternionT identity() { return QuaternionT(); }
+
+    /**
+     * @param axis unit vector
+     * @param angle rad
+     */
+    static QuaternionT fromAxisAngle(const Vector3<T>& axis, T angle) {
+        T s = Scalar<T>::sin(angle * T(0.5));
+        return QuaternionT(Scalar<T>::cos(angle * T(0.5)), axis.x * s, axis.y * s, axis.z * s);
+    }
+
+    /**
+     * Same as Quaternion(EulerRotation(roll, pitch, yaw, ZYX_EULER))
+     */
+    static QuaternionT fromEulerZYX(T roll, T pitch, T yaw) {
+        T cy = Scalar<T>::cos(yaw * T(0.5));
+        T sy = Scalar<T>::sin(yaw * T(0.5));
+        T cp = Scalar<T>::cos(pitch * T(0.5));
+        T sp = Scalar<T>::sin(pitch * T(0.5));
+        T cr = Scalar<T>::cos(roll * T(0.5));
+        T sr = Scalar<T>::sin(roll * T(0.5));
+        return QuaternionT(
+            cr * cp * cy + sr * sp * sy,
+            sr * cp * cy - cr * sp * sy,
+            cr * sp * cy + sr * cp * sy,
+            cr * cp * sy - sr * sp * cy);
+    }
+
+    /**
+     * Same convention as Quaternion::toEulerZYX(): (roll, -pitch, -yaw) in rad
+     */
+    Vector3<T> toEulerZYX() const {
+        T roll = Scalar<T>::atan2(T(2) * (w * x + y * z), T(1) - T(2) * (x * x + y * y));
+        T t2 = T(2) * (w * y - z * x);
+        t2 = t2 > T(1) ? T(1) : (t2 < T(-1) ? T(-1) : t2);
+        T pitch = Scalar<T>::asin(t2);
+        T yaw = Scalar<T>::atan2(T(2) * (w * z + x * y), T(1) - T(2) * (y * y + z * z));
+        return Vector3<T>(roll, -pitch, -yaw);
+    }
+
+    constexpr Vector3<T> vec() const { return Vector3<T>(x, y, z); }
+
+    constexpr T lengthSquared() const { return w * w + x * x + y * y + z * z; }
+    constexpr T dot(const QuaternionT& q) const { return w * q.w + x * q.x + y * q.y + z * q.z; }
+
+    constexpr QuaternionT conjugated() const { return QuaternionT(w, -x, -y, -z); }
+
+    QuaternionT& normalize() {
+        T n2 = lengthSquared();
+        if(n2 > 0) *this *= T(1) / Scalar<T>::sqrt(n2);
+        return *this;
+    }
+
+    /**
+     * Renormalizes only if the squared length is off by more than tolerance. Small errors take one newton step instead of sqrt and division
+     * @return true if the quaternion was changed
+     */
+    bool normalizeIfNeeded(T tolerance = T(1e-6)) {
+        T error = lengthSquared() - T(1);
+        if(error < tolerance && error > -tolerance) return false;
+        if(error < T(0.01) && error > T(-0.01)) {
+            *this *= T(1) - T(0.5) * error;
+        } else {
+            normalize();
+        }
+        return true;
+    }
+
+    constexpr QuaternionT operator * (const QuaternionT& q) const {
+        return QuaternionT(
+            w * q.w - x * q.x - y * q.y - z * q.z,
+            w * q.x + x * q.w + y * q.z - z * q.y,
+            w * q.y - x * q.z + y * q.w + z * q.x,
+            w * q.z + x * q.y - y * q.x + z * q.w);
+    }
+
+    QuaternionT& operator *= (const QuaternionT& q) {
+        *this = *this * q;
+        return *this;
+    }
+
+    QuaternionT& operator *= (T s) {
+        w *= s;
+        x *= s;
+        y *= s;
+        z *= s;
+        return *this;
+    }
+
+    /**
+     * v' = v + 2 / |q|^2 * (w * (u x v) + u x (u x v)) with u = (x, y, z)
+     */
+    void rotate(Vector3<T>& v) const {
+        Vector3<T> u = vec();
+        Vector3<T> t = u.cross(v);
+        v += (t * w + u.cross(t)) * (T(2) / lengthSquared());
+    }
+
+    void rotateReverse(Vector3<T>& v) const {
+        Vector3<T> u = -vec();
+        Vector3<T> t = u.cross(v);
+        v += (t * w + u.cross(t)) * (T(2) / lengthSquared());
+    }
+
+    Vector3<T> rotated(Vector3<T> v) const {
+        rotate(v);
+        return v;
+    }
+
+    /**
+     * Integrates a body rate with the second order increment exp(rate * dt / 2). Good up to a few degrees per call
+     * @param rate rad/s
+     * @param dt seconds
+     */
+    QuaternionT& integrate(const Vector3<T>& rate, T dt) {
+        Vector3<T> a = rate * dt;
+        T angle2 = a.lengthSquared();
+        T s = T(0.5) - angle2 * T(1.0 / 48.0);
+        *this *= QuaternionT(T(1) - angle2 * T(1.0 / 8.0), a.x * s, a.y * s, a.z * s);
+        normalizeIfNeeded();
+        return *this;
+    }
+};
+
+using Quaternionf = QuaternionT<float>;
+using Quaterniond = QuaternionT<double>;
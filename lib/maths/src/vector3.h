@@ -0,0 +1,124 @@
+/**
+ * @file vector3.h
+ * @author Timo Lehnertz
+ * @brief Header only 3d vector templated on the scalar type
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+#include <math.h>
+
+/**
+ * Scalar functions picked by type so float code never falls back to the double versions
+ */
+template<typename T>
+struct Scalar;
+
+template<>
+struct Scalar<float> {
+    static float sqrt(float v) { return sqrtf(v); }
+    static float sin(float v) { return sinf(v); }
+    static float cos(float v) { return cosf(v); }
+    static float asin(float v) { return asinf(v); }
+    static float atan2(float y, float x) { return atan2f(y, x); }
+};
+
+template<>
+struct Scalar<double> {
+    static double sqrt(double v) { return ::sqrt(v); }
+    static double sin(double v) { return ::sin(v); }
+    static double cos(double v) { return ::cos(v); }
+    static double asin(double v) { return ::asin(v); }
+    static double atan2(double y, double x) { return ::atan2(y, x); }
+};
+
+/**
+ * Plain 3d vector. Everything is inline, compound operators work in place and return a reference.
+ * Defaults to float for the single precision FPU of the M7. Use Vec3 (maths.h) where the double interface is needed
+ */
+template<typename T = float>
+struct Vector3 {
+    T x, y, z;
+
+    constexpr Vector3() : x(0), y(0), z(0) {}
+    constexpr Vector3(T x, T y, T z) : x(x), y(y), z(z) {}
+    constexpr explicit Vector3(T s) : x(s), y(s), z(s) {}
+
+    template<typename U>
+    constexpr explicit Vector3(const Vector3<U>& v) : x(T(v.x)), y(T(v.y)), z(T(v.z)) {}
+
+    constexpr T dot(const Vector3& v) const { return x * v.x + y * v.y + z * v.z; }
+
+    constexpr Vector3 cross(const Vector3& v) const {
+        return Vector3(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x);
+    }
+
+    constexpr T lengthSquared() const { return x * x + y * y + z * z; }
+    T length() const { return Scalar<T>::sqrt(lengthSquared()); }
+
+    /**
+     * Scales to unit length. Zero vectors stay zero
+     */
+    Vector3& normalize() {
+        T len2 = lengthSquared();
+        if(len2 > 0) *this *= T(1) / Scalar<T>::sqrt(len2);
+        return *this;
+    }
+
+    Vector3 normalized() const {
+        Vector3 res = *this;
+        return res.normalize();
+    }
+
+    constexpr Vector3 operator - () const { return Vector3(-x, -y, -z); }
+
+    constexpr Vector3 operator + (const Vector3& v) const { return Vector3(x + v.x, y + v.y, z + v.z); }
+    constexpr Vector3 operator - (const Vector3& v) const { return Vector3(x - v.x, y - v.y, z - v.z); }
+    constexpr Vector3 operator * (T s) const { return Vector3(x * s, y * s, z * s); }
+    constexpr Vector3 operator / (T s) const { return Vector3(x / s, y / s, z / s); }
+
+    Vector3& operator += (const Vector3& v) {
+        x += v.x;
+        y += v.y;
+        z += v.z;
+        return *this;
+    }
+
+    Vector3& operator -= (const Vector3& v) {
+        x -= v.x;
+        y -= v.y;
+        z -= v.z;
+        return *this;
+    }
+
+    Vector3& operator *= (T s) {
+        x *= s;
+        y *= s;
+        z *= s;
+        return *this;
+    }
+
+    Vector3& operator /= (T s) {
+        x /= s;
+        y /= s;
+        z /= s;
+        return *this;
+    }
+
+    constexpr bool operator == (const Vector3& v) const { return x == v.x && y == v.y && z == v.z; }
+    constexpr bool operator != (const Vector3& v) const { return !(*this == v); }
+
+    T& operator[](int axis) { return axis == 0 ? x : (axis == 1 ? y : z); }
+    constexpr const T& operator[](int axis) const { return axis == 0 ? x : (axis == 1 ? y : z); }
+};
+
+template<typename T>
+constexpr Vector3<T> operator * (T s, const Vector3<T>& v) {
+    return v * s;
+}
+
+using Vec3f = Vector3<float>;
+using Vec3d = Vector3<double>;
@@ -47,15 +47,19 @@ PID::PID(char* str) {
 }
 
 float PID::compute(float measurement, float setpoint) {
-    return compute(measurement, setpoint, -1000000.0f);
+    return compute(measurement, setpoint, noGyro, micros());
 }
 
 float PID::compute(float measurement, float setpoint, float gyro) {
+    return compute(measurement, setpoint, gyro, micros());
+}
+
+float PID::compute(float measurement, float setpoint, float gyro, uint64_t timeUs, float feedforward) {
     float minOut = -maxOut;
     if(this->minOut > -10000000) {
         minOut = this->minOut;
     }
-    uint64_t now = micros();
+    uint64_t now = timeUs;
     if(dlpf > 1.0f) dlpf = 1.0f;
     if(dlpf < 0.0f) dlpf = 0.0f;
     float t = ((double) (now - prevTime)) / 1000000.0f;
@@ -89,7 +93,7 @@ float PID::compute(float measurement, float setpoint, float gyro) {
      * derivative on measurement
      */
     float derivative;
-    if(gyro == -1000000.0f) {
+    if(gyro == noGyro) {
         derivative = (measurement - prevMeasurement) * dlpf + prevD * (1.0f - dlpf);
     } else {
         derivative = gyro * dlpf + prevD * (1 - dlpf);
@@ -101,7 +105,7 @@ float PID::compute(float measurement, float setpoint, float gyro) {
     /**
      * Compute
      */
-    float out = p * error + integrator - derivative;
+    float out = p * error + integrator - derivative + feedforward;
     if(out > maxOut) out = maxOut;
     if(out < minOut) out = minOut;
 
@@ -114,6 +118,7 @@ float PID::compute(float measurement, float setpoint, float gyro) {
     // Debug
     prevP = p * error;
     prevI = integrator;
+    prevF = feedforward;
     prevOut = out;
 
     return out;
@@ -52,6 +52,7 @@ public:
      * Debug values
      */
     float prevI = 0;
+    float prevF = 0;
     float prevOut = 0;
 
     PID();
@@ -64,9 +65,20 @@ public:
 
     ~PID();
 
+    /**
+     * Passed as gyro if the derivative should be computed from the measurement
+     */
+    static constexpr float noGyro = -1000000.0f;
+
     float compute(float measurement, float setpoint);
     float compute(float measurement, float setpoint, float gyro);
 
+    /**
+     * @param timeUs acquisition time of the measurement. dt is derived from consecutive timestamps
+     * @param feedforward added to the output before limiting
+     */
+    float compute(float measurement, float setpoint, float gyro, uint64_t timeUs, float feedforward = 0);
+
     void reset();
 
     static void updateAux(float aux1, float aux2, float aux3);
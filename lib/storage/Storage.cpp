@@ -68,6 +68,25 @@ PID Storage::read(PidValues pidVal) {
     return pid;
 }
 
+Mixer Storage::read(MixerValues mixerVal) {
+    Mixer mixer;
+    int addr = mixerStart() + mixerVal * STORAGE_SIZE_MIXER;
+    EEPROM.get(addr, mixer.motorCount);
+    for (int i = 0; i < Mixer::maxMotors; i++) {
+        EEPROM.get(addr + sizeof(int) + i * sizeof(MixerRule), mixer.rules[i]);
+    }
+    return mixer;
+}
+
+MotorCalibration Storage::read(MotorCalibrationValues calVal) {
+    MotorCalibration cal;
+    int addr = motorCalibrationStart() + calVal * STORAGE_SIZE_MOTOR_CAL;
+    for (int i = 0; i < MotorCalibration::POINTS; i++) {
+        EEPROM.get(addr + i * sizeof(float), cal.points[i]);
+    }
+    return cal;
+}
+
 void Storage::write(BoolValues boolVal, bool flag) {
     int addr = boolStart() +  boolVal * STORAGE_SIZE_BOOL;
     if(addr >= eepromSize - 10) return;//preserve last 10 bytes
@@ -117,6 +136,23 @@ void Storage::write(PidValues pidVal, PID pid) {
     EEPROM.put(addr + 5 * sizeof(float), aux);
 }
 
+void Storage::write(MixerValues mixerVal, const Mixer& mixer) {
+    int addr = mixerStart() + mixerVal * STORAGE_SIZE_MIXER;
+    if(addr + STORAGE_SIZE_MIXER >= eepromSize - 10) return;//preserve last 10 bytes
+    EEPROM.put(addr, mixer.motorCount);
+    for (int i = 0; i < Mixer::maxMotors; i++) {
+        EEPROM.put(addr + sizeof(int) + i * sizeof(MixerRule), mixer.rules[i]);
+    }
+}
+
+void Storage::write(MotorCalibrationValues calVal, const MotorCalibration& cal) {
+    int addr = motorCalibrationStart() + calVal * STORAGE_SIZE_MOTOR_CAL;
+    if(addr + STORAGE_SIZE_MOTOR_CAL >= eepromSize - 10) return;//preserve last 10 bytes
+    for (int i = 0; i < MotorCalibration::POINTS; i++) {
+        EEPROM.put(addr + i * sizeof(float), cal.points[i]);
+    }
+}
+
 void Storage::begin() {
     int x;
     EEPROM.get(eepromSize - 5, x);
@@ -144,6 +180,8 @@ void Storage::writeDefaults() {
     write(BoolValues::useLeds, true);
     write(BoolValues::useAntiGravity, true);
     write(BoolValues::useVCell, true);
+    write(BoolValues::useRcSmoothing, true);
+    write(BoolValues::useRcExtrapolation, false);
 
     write(FloatValues::m1Pin, 4);
     write(FloatValues::m2Pin, 3);
@@ -161,9 +199,11 @@ void Storage::writeDefaults() {
 
     write(FloatValues::insAccMaxG, 1.0);
     write(FloatValues::accLPF, 0.01f);
-    write(FloatValues::gyroLPF, 1.0f);
+    write(FloatValues::gyroLPF, 0.0f); // Hz, 0 = off
     write(FloatValues::accInsInf, 0.0002f);
     write(FloatValues::magInsInf, 1.0f);
+    write(FloatValues::accCorrectionHz, 500.0f);
+    write(FloatValues::magCorrectionHz, 50.0f);
     write(FloatValues::antiGravityMul, 4.0f);
     write(FloatValues::boostLpf, 0.005f);
     write(FloatValues::boostSpeed, 40.0f);
@@ -177,6 +217,9 @@ void Storage::writeDefaults() {
     write(FloatValues::magZOffset, 0.0f);
     write(FloatValues::throttleMul4S, 1.0f);
     write(FloatValues::throttleMul6S, 1.0f);
+    write(FloatValues::thrustLinearization, THRUST_LINEARIZATION);
+    write(FloatValues::rcSmoothingFactor, RC_SMOOTHING_FACTOR);
+    write(FloatValues::feedforwardDeadband, FEEDFORWARD_DEADBAND);
 
     /**
      * FC
@@ -193,6 +236,9 @@ void Storage::writeDefaults() {
     write(Vec3Values::rateP, Rates(RATE_RC, RATE_SUPER, RATE_RC_EXPO).toVec3());
     write(Vec3Values::rateY, Rates(RATE_RC, RATE_SUPER, RATE_RC_EXPO).toVec3());
 
+    write(Vec3Values::feedforwardGain,   Vec3(FEEDFORWARD_GAIN_RP, FEEDFORWARD_GAIN_RP, FEEDFORWARD_GAIN_Y));
+    write(Vec3Values::feedforwardStatic, Vec3(FEEDFORWARD_STATIC, FEEDFORWARD_STATIC, FEEDFORWARD_STATIC));
+
     /**
      * PIDs
      */
@@ -224,6 +270,12 @@ void Storage::writeDefaults() {
 
     write(QuaternionValues::accAngleOffset,  Quaternion());
 
+    write(MixerValues::motorMixer, Mixer::quadX());
+
+    for (int i = 0; i < MotorCalibrationValues::MotorCalibrationValuesCount; i++) {
+        write((MotorCalibrationValues) i, MotorCalibration());
+    }
+
     Serial.println("Wrote defaults into EEPROM");
     Serial2.println("Wrote defaults into EEPROM");
 }
@@ -252,6 +304,14 @@ int Storage::pidStart() {
     return matrix3Start() + (Matrix3Values::Matrix3ValuesCount) * STORAGE_SIZE_MATRIX3;
 }
 
-int Storage::size() {
+int Storage::mixerStart() {
     return pidStart() + (PidValues::PidValuesCount) * STORAGE_SIZE_PID;
+}
+
+int Storage::motorCalibrationStart() {
+    return mixerStart() + (MixerValues::MixerValuesCount) * STORAGE_SIZE_MIXER;
+}
+
+int Storage::size() {
+    return motorCalibrationStart() + (MotorCalibrationValues::MotorCalibrationValuesCount) * STORAGE_SIZE_MOTOR_CAL;
 }
\ No newline at end of file
@@ -14,7 +14,7 @@
 #include <pid.h>
 #include <fc.h>
 
-#define STORAGE_VERSION 314 // 3.14159265359
+#define STORAGE_VERSION 320 // 3.14159265359
 
 #define STORAGE_SIZE_BOOL       (sizeof(bool)   * 1)
 #define STORAGE_SIZE_FLOAT      (sizeof(float)  * 1)
@@ -23,6 +23,8 @@
 #define STORAGE_SIZE_MATRIX3    (sizeof(double) * 9)
 #define STORAGE_SIZE_PID        (sizeof(float)  * 6)
 #define STORAGE_SIZE_RATES      (sizeof(double) * 3)
+#define STORAGE_SIZE_MIXER      (sizeof(int) + sizeof(MixerRule) * Mixer::maxMotors)
+#define STORAGE_SIZE_MOTOR_CAL  (sizeof(float)  * MotorCalibration::POINTS)
 
 enum BoolValues {
     propsIn,
@@ -32,6 +34,9 @@ enum BoolValues {
 
     useVCell,
 
+    useRcSmoothing,
+    useRcExtrapolation,
+
     BoolValuesCount
 };
 
@@ -41,6 +46,8 @@ enum FloatValues {
 
     accInsInf,
     magInsInf,
+    accCorrectionHz,
+    magCorrectionHz,
 
 	loopFreqRate,
 	loopFreqLevel,
@@ -81,6 +88,12 @@ enum FloatValues {
     throttleMul4S,
     throttleMul6S,
 
+    thrustLinearization,
+
+    rcSmoothingFactor,
+
+    feedforwardDeadband,
+
     FloatValuesCount
 };
 
@@ -97,6 +110,10 @@ enum Vec3Values {
     rateP,
     rateY,
 
+    //Feedforward
+    feedforwardGain,
+    feedforwardStatic,
+
     Vec3ValuesCount
 };
 
@@ -125,6 +142,25 @@ enum PidValues {
     PidValuesCount
 };
 
+enum MixerValues {
+    motorMixer,
+
+    MixerValuesCount
+};
+
+enum MotorCalibrationValues {
+    m1Calibration,
+    m2Calibration,
+    m3Calibration,
+    m4Calibration,
+    m5Calibration,
+    m6Calibration,
+    m7Calibration,
+    m8Calibration,
+
+    MotorCalibrationValuesCount
+};
+
 class Storage {
 public:
 
@@ -136,6 +172,8 @@ public:
     static Quaternion read(QuaternionValues quatVal);
     static Matrix3 read(Matrix3Values matVal);
     static PID read(PidValues pidVal);
+    static Mixer read(MixerValues mixerVal);
+    static MotorCalibration read(MotorCalibrationValues calVal);
 
     static void write(BoolValues floatVal, bool flag);
     static void write(FloatValues floatVal, float val);
@@ -143,6 +181,8 @@ public:
     static void write(QuaternionValues quatVal, Quaternion quat);
     static void write(Matrix3Values matVal, Matrix3 mat);
     static void write(PidValues matVal, PID mat);
+    static void write(MixerValues mixerVal, const Mixer& mixer);
+    static void write(MotorCalibrationValues calVal, const MotorCalibration& cal);
 
     static void writeDefaults();
     static int size();
@@ -159,6 +199,8 @@ private:
     static int quaternionStart();
     static int matrix3Start();
     static int pidStart();
+    static int mixerStart();
+    static int motorCalibrationStart();
     static const int offset = 0;
 };
 
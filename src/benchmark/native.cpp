@@ -0,0 +1,37 @@
+/**
+ * @file native.cpp
+ * @author Timo Lehnertz
+ * @brief Benchmark runner for the host. pio run -e native && .pio/build/native/program [filter]
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <benchmarks.h>
+
+/**
+ * Nanoseconds, truncated to 32 bits. Batches stay far below one wrap around (4.3 s)
+ */
+uint32_t clockNs() {
+    return (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void printLine(const char* line) {
+    puts(line);
+    fflush(stdout);
+}
+
+/**
+ * Usage: program [filter] [samples]
+ */
+int main(int argc, char** argv) {
+    BenchmarkRunner runner("native", "ns", 1e9, clockNs, printLine);
+    runner.batchTicks = 200000; // 200 us per batch
+    runner.samples = argc > 2 ? atoi(argv[2]) : 31;
+    runner.runAll(benchmarks, benchmarkCount, benchmarkBuild, argc > 1 ? argv[1] : nullptr);
+    return 0;
+}
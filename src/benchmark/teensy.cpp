@@ -0,0 +1,51 @@
+/**
+ * @file teensy.cpp
+ * @author Timo Lehnertz
+ * @brief Benchmark runner for the Teensy 4.0. Counts cpu cycles with the DWT cycle counter and reports over USB
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <Arduino.h>
+#include <benchmarks.h>
+
+uint32_t clockCycles() {
+    return ARM_DWT_CYCCNT;
+}
+
+void printLine(const char* line) {
+    Serial.println(line);
+}
+
+BenchmarkRunner runner("teensy40", "cycles", F_CPU_ACTUAL, clockCycles, printLine);
+
+char filter[64];
+int filterLength = 0;
+
+void setup() {
+    Serial.begin(115200);
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+    while(!Serial && millis() < 5000) {}
+    runner.batchTicks = 60000; // 100 us at 600 MHz
+    runner.runAll(benchmarks, benchmarkCount, benchmarkBuild);
+}
+
+/**
+ * Every received line reruns the benchmarks whose name contains it. An empty line runs all
+ */
+void loop() {
+    while(Serial.available()) {
+        char c = Serial.read();
+        if(c == '\r') continue;
+        if(c == '\n') {
+            filter[filterLength] = 0;
+            filterLength = 0;
+            runner.runAll(benchmarks, benchmarkCount, benchmarkBuild, filter);
+        } else if(filterLength < (int) sizeof(filter) - 1) {
+            filter[filterLength++] = c;
+        }
+    }
+}
@@ -9,18 +9,26 @@
  * 
  */
 #include <Arduino.h>
+#include "setup.h"
 #include <OneShotMotor.h>
 #include <DShotMotor.h>
+#ifdef USE_ICM42688
+#include <SensorImpICM-42688.h>
+#else
 #include <SensorImpMPU-9250.h>
+#endif
 #include <crossfire.h>
 #include <FC.h>
 #include <Comunicator.h>
 #include <Storage.h>
-#include "setup.h"
 #include <EEPROM.h>
 #include <Adafruit_NeoPixel.h>
 
+#ifdef USE_ICM42688
+ICM42688Sensor sensors;// Sensor interface to interface with all sensors on board
+#else
 MPU9250Sensor sensors;// Sensor interface to interface with all sensors on board
+#endif
 
 INS ins(&sensors);// Inertial navigation system to convert sensor reading into position, velocity, rotation, rotational rates
 
@@ -37,7 +45,8 @@ DShotMotor mFR;
 DShotMotor mBL;
 DShotMotor mBR;
 
-FC fc(&ins, &mFL, &mFR, &mBL, &mBR, &crsf); // Flight controller
+Motor* motors[] = {&mFL, &mFR, &mBL, &mBR}; // mixer order
+FC fc(&ins, motors, 4, &crsf); // Flight controller
 
 #define NUMPIXELS 10 // maximum number of pixels controlled
 #define PIXEL_PIN 20 // Digital pin from LED Strip
@@ -56,10 +65,20 @@ void handleLoopFreq() {
     case FlightMode::level: freq = com.loopFreqLevel; break;
     default:                freq = com.loopFreqLevel;
   }
+  static int sensorFreq = 0;
+  if(freq != sensorFreq) { // decimation and gyro low pass follow the loop rate
+    sensors.setLoopFreq(freq);
+    sensorFreq = freq;
+  }
   float microT = 1000000.0f / freq;
   com.cpuLoad = ((float)(com.loopEnd - com.loopStart) / microT) * 100.0f;
   com.loopTimeUs = com.loopEnd - com.loopStart;
-  delayMicroseconds(microT - (com.loopEnd - com.loopStart));
+  // idle time. The shadow fusion may use it but is timed on its own so INS Us and cpu load stay untouched
+  float idleUs = microT - (com.loopEnd - com.loopStart);
+  uint32_t shadowStart = micros();
+  ins.handleShadow(idleUs > 0 ? idleUs : 0);
+  com.shadowTime = micros() - shadowStart;
+  if(idleUs > com.shadowTime) delayMicroseconds(idleUs - com.shadowTime);
   com.actualFreq = 1000000.0f / (micros() - com.loopStart);
 }
 
@@ -117,14 +136,10 @@ void loop() {
   if(!com.motorOverwrite) { // available in GUI
     fc.handle(); //also handles motors
   } else {
-    mFL.arm();
-    mFR.arm();
-    mBL.arm();
-    mBR.arm();
-    mFL.writeRaw(((float) com.motorFL) / 100);
-    mFR.writeRaw(((float) com.motorFR) / 100);
-    mBL.writeRaw(((float) com.motorBL) / 100);
-    mBR.writeRaw(((float) com.motorBR) / 100);
+    for (int i = 0; i < fc.getMotorCount(); i++) {
+      motors[i]->arm();
+      motors[i]->writeRaw(((float) com.motorOverwriteValues[i]) / 100);
+    }
   }
   com.fcTime = micros();
   com.loopEnd = micros();
@@ -9,6 +9,8 @@
  * 
  */
 #define IMU_SERIAL_PORT Serial1
+
+// #define USE_ICM42688 // ICM-42688-P instead of MPU9250
 #define CRSF_SERIAL_PORT &Serial3
 
 #define MOTOR_1 2
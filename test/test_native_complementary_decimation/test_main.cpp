@@ -0,0 +1,142 @@
+/**
+ * @file test_main.cpp
+ * @author Timo Lehnertz
+ * @brief Decimated ComplementaryFilter corrections against corrections with every sample, replayed from simulated flight
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <unity.h>
+#include <ComplementaryFilter.h>
+
+/**
+ * Sensors without hardware. Samples are pushed by the test
+ */
+class ReplaySensors : public SensorInterface {
+public:
+    ReplaySensors() {
+        useMag = false;
+        for (size_t i = 0; i < sensorCount; i++) {
+            sensors[i]->error = Error::NO_ERROR;
+            sensors[i]->lastChange = 0;
+        }
+        ultrasonic.lastChange = 0;
+    }
+
+    void begin() {}
+    void handle() {}
+    void setAccCal(Vec3, Vec3) {}
+    void setGyroCal(Vec3, Vec3) {}
+    void setMagCal(Vec3, Vec3) {}
+    void calibrateAcc() {}
+    void calibrateGyroOffset() {}
+    void calibrateGyroScale() {}
+    void calibrateMag() {}
+    Vec3 getAccOffset() { return Vec3(); }
+    Vec3 getAccScale() { return Vec3(1, 1, 1); }
+    Vec3 getGyroOffset() { return Vec3(); }
+    Vec3 getGyroScale() { return Vec3(1, 1, 1); }
+    Vec3 getMagOffset() { return Vec3(); }
+    Vec3 getMagScale() { return Vec3(1, 1, 1); }
+    void calibrateBat(float) {}
+};
+
+/**
+ * Deterministic noise in -1 - 1
+ */
+float noise(uint32_t i, uint32_t salt) {
+    uint32_t x = i * 2654435761UL ^ salt * 40503UL;
+    x ^= x >> 13;
+    x *= 0x5bd1e995;
+    x ^= x >> 15;
+    return (float) (x & 0xFFFF) / 32768.0f - 1.0f;
+}
+
+struct ReplayResult {
+    float maxRollPitchDiff = 0; // decimated against every sample, rad
+    float maxRollPitchError = 0; // decimated against the true attitude, rad
+};
+
+/**
+ * True attitude at time t. Roll and pitch swing within 25 deg, yaw within 115 deg
+ */
+Quaternion trueAttitude(float t) {
+    return Quaternion(EulerRotation(0.4 * sin(t * 1.3), 0.3 * sin(t * 0.7 + 1), 2.0 * sin(t * 0.4)));
+}
+
+/**
+ * 10 s at 4 kHz. The gyro reads the body rate between two true attitudes, the accelerometer gravity at the true attitude.
+ * Both get noise
+ */
+ReplayResult replay(float accCorrectionHz) {
+    ReplaySensors sensorsA, sensorsB;
+    ComplementaryFilter everySample(&sensorsA);
+    ComplementaryFilter decimated(&sensorsB);
+    everySample.accCorrectionHz = 0;
+    decimated.accCorrectionHz = accCorrectionHz;
+
+    ReplayResult result;
+    const uint32_t periodUs = 250;
+    const float dt = periodUs * 0.000001f;
+    uint64_t time = 1000;
+    Quaternion truth = trueAttitude(0);
+    for (uint32_t i = 1; i <= 40000; i++) {
+        float t = i * dt;
+        Quaternion next = trueAttitude(t);
+        // rotation vector of truth^-1 * next. Same axes as DeltaAngleAccumulator: gyro x mirrored
+        Quaternion delta = Quaternion(truth.w, -truth.x, -truth.y, -truth.z) * next;
+        double sign = delta.w < 0 ? -2 : 2;
+        Vec3 gyro(-delta.x * sign, delta.y * sign, delta.z * sign);
+        gyro = gyro * (RAD_TO_DEG / dt) + Vec3(noise(i, 4), noise(i, 5), noise(i, 6)) * 0.5;
+        truth = next;
+        Vec3 acc(0, 0, 1);
+        truth.rotateReverse(acc);
+        acc = acc + Vec3(noise(i, 1), noise(i, 2), noise(i, 3)) * 0.02;
+
+        time += periodUs;
+        sensorsA.gyro.update(gyro, time);
+        sensorsA.acc.update(acc, time);
+        sensorsB.gyro.update(gyro, time);
+        sensorsB.acc.update(acc, time);
+        everySample.handle();
+        decimated.handle();
+
+        if(t < 1) continue; // both filters start level and need to converge first
+        EulerRotation a = everySample.getAttitude().toEulerZYX();
+        EulerRotation b = decimated.getAttitude().toEulerZYX();
+        EulerRotation e = truth.toEulerZYX();
+        result.maxRollPitchDiff = max(result.maxRollPitchDiff, (float) max(fabs(a.x - b.x), fabs(a.y - b.y)));
+        result.maxRollPitchError = max(result.maxRollPitchError, (float) max(fabs(e.x - b.x), fabs(e.y - b.y)));
+    }
+    return result;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_decimated_500hz_matches_every_sample() {
+    ReplayResult r = replay(500);
+    printf("500 Hz: max roll/pitch diff %.5f rad, max error %.5f rad\n", r.maxRollPitchDiff, r.maxRollPitchError);
+    TEST_ASSERT_TRUE_MESSAGE(r.maxRollPitchDiff < 0.001f, "500 Hz differs from every sample by more than 0.001 rad");
+}
+
+void test_decimated_100hz_matches_every_sample() {
+    ReplayResult r = replay(100);
+    printf("100 Hz: max roll/pitch diff %.5f rad, max error %.5f rad\n", r.maxRollPitchDiff, r.maxRollPitchError);
+    TEST_ASSERT_TRUE_MESSAGE(r.maxRollPitchDiff < 0.005f, "100 Hz differs from every sample by more than 0.005 rad");
+}
+
+void test_decimated_tracks_truth() {
+    ReplayResult r = replay(500);
+    TEST_ASSERT_TRUE_MESSAGE(r.maxRollPitchError < 0.005f, "roll or pitch more than 0.005 rad off");
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_decimated_500hz_matches_every_sample);
+    RUN_TEST(test_decimated_100hz_matches_every_sample);
+    RUN_TEST(test_decimated_tracks_truth);
+    return UNITY_END();
+}
@@ -0,0 +1,83 @@
+/**
+ * @file test_main.cpp
+ * @author Timo Lehnertz
+ * @brief CIC decimator gain and group delay
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <unity.h>
+#include <decimator.h>
+
+/**
+ * A ramp comes out of a linear phase filter unchanged but shifted by the group delay.
+ * Checks every output after the priming phase against the ramp at (newest input - getGroupDelay())
+ */
+template<int ORDER>
+void checkRampDelay(uint32_t ratio, bool compensate) {
+    const int32_t slope = 1000; // counts per input sample, keeps the truncation of the division small in relative terms
+    CicDecimator<ORDER> decimator;
+    decimator.configure(ratio, compensate);
+    int outputs = 0;
+    for (int32_t n = 0; n < 400; n++) {
+        int32_t out;
+        if(!decimator.push(n * slope, out)) continue;
+        if(++outputs <= ORDER + 2) continue; // combs and compensation history are not settled yet
+        float expected = (n - decimator.getGroupDelay()) * slope;
+        TEST_ASSERT_FLOAT_WITHIN(1.0f, expected, (float) out);
+    }
+    TEST_ASSERT_EQUAL_INT(400 / ratio, outputs);
+}
+
+void testPassThrough() {
+    CicDecimator<2> decimator;
+    decimator.configure(1, false);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, decimator.getGroupDelay());
+    int32_t out = 0;
+    for (int32_t n = 0; n < 10; n++) {
+        TEST_ASSERT_TRUE(decimator.push(n * 7 - 20, out));
+        TEST_ASSERT_EQUAL_INT(n * 7 - 20, out);
+    }
+}
+
+void testDcGain() {
+    CicDecimator<3> decimator;
+    decimator.configure(8, false);
+    int32_t out = 0;
+    for (int n = 0; n < 200; n++) {
+        decimator.push(-123456, out);
+    }
+    TEST_ASSERT_EQUAL_INT(-123456, out);
+}
+
+void testGroupDelayBoxcar() {
+    checkRampDelay<1>(4, false);
+    checkRampDelay<1>(8, false);
+}
+
+void testGroupDelayCic() {
+    checkRampDelay<2>(2, false);
+    checkRampDelay<2>(8, false);
+    checkRampDelay<3>(5, false);
+}
+
+void testGroupDelayCompensated() {
+    checkRampDelay<2>(8, true);
+    checkRampDelay<3>(4, true);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(testPassThrough);
+    RUN_TEST(testDcGain);
+    RUN_TEST(testGroupDelayBoxcar);
+    RUN_TEST(testGroupDelayCic);
+    RUN_TEST(testGroupDelayCompensated);
+    return UNITY_END();
+}
@@ -0,0 +1,120 @@
+/**
+ * @file test_main.cpp
+ * @author Timo Lehnertz
+ * @brief Error bounds of FastMath against double precision libm. Run with pio test -e native
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <unity.h>
+#include <fastMath.h>
+
+void setUp() {}
+void tearDown() {}
+
+float fromBits(uint32_t bits) {
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+/**
+ * The relative error repeats every two binades, so 1 - 4 covers every mantissa and exponent parity
+ */
+void test_rsqrt_relative_error() {
+    double maxError = 0;
+    for (uint32_t bits = 0x3F800000; bits < 0x40800000; bits++) {
+        float x = fromBits(bits);
+        double error = fabs(FastMath::rsqrt(x) * sqrt((double) x) - 1.0);
+        if(error > maxError) maxError = error;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(maxError < 4.8e-6, "rsqrt above 4.8e-6 between 1 and 4");
+}
+
+/**
+ * Sparse check over all normal floats, catches exponent handling
+ */
+void test_rsqrt_all_normal_floats() {
+    double maxError = 0;
+    for (uint32_t bits = 0x00800000; bits < 0x7F800000; bits += 4099) {
+        float x = fromBits(bits);
+        double error = fabs(FastMath::rsqrt(x) * sqrt((double) x) - 1.0);
+        if(error > maxError) maxError = error;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(maxError < 4.8e-6, "rsqrt above 4.8e-6 over the normal range");
+}
+
+/**
+ * Full circle at magnitudes from 1e-20 to 1e20
+ */
+void test_atan2() {
+    const double magnitudes[] = {1e-20, 1e-3, 1, 7.5, 1e20};
+    double maxError = 0;
+    for (int i = 0; i < 1000000; i++) {
+        double angle = -M_PI + 2 * M_PI * i / 1000000.0;
+        for (double magnitude : magnitudes) {
+            float y = magnitude * sin(angle);
+            float x = magnitude * cos(angle);
+            double error = fabs(FastMath::atan2(y, x) - atan2((double) y, (double) x));
+            if(error > maxError) maxError = error;
+        }
+    }
+    TEST_ASSERT_TRUE_MESSAGE(maxError < 3.3e-7, "atan2 above 3.3e-7 rad");
+    TEST_ASSERT_EQUAL(0.0f, FastMath::atan2(0, 0));
+    TEST_ASSERT_FLOAT_WITHIN(3.3e-7, M_PI, FastMath::atan2(0, -1));
+    TEST_ASSERT_FLOAT_WITHIN(3.3e-7, -M_PI / 2, FastMath::atan2(-1, 0));
+}
+
+/**
+ * Every 7th float in 0 - 1 and the mirrored negative side
+ */
+void test_asin() {
+    double maxError = 0;
+    for (uint32_t bits = 0; bits <= 0x3F800000; bits += 7) {
+        float x = fromBits(bits);
+        double error = fabs(FastMath::asin(x) - asin((double) x));
+        if(error > maxError) maxError = error;
+        error = fabs(FastMath::asin(-x) + asin((double) x));
+        if(error > maxError) maxError = error;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(maxError < 3.0e-7, "asin above 3.0e-7 rad");
+    TEST_ASSERT_FLOAT_WITHIN(3.0e-7, M_PI / 2, FastMath::asin(1.5f));
+    TEST_ASSERT_FLOAT_WITHIN(3.0e-7, -M_PI / 2, FastMath::asin(-1.5f));
+}
+
+void test_sincos() {
+    double maxError = 0;
+    for (int i = 0; i <= 4000000; i++) {
+        float angle = -100 + 200.0 * i / 4000000;
+        float s, c;
+        FastMath::sincos(angle, s, c);
+        double error = fmax(fabs(s - sin((double) angle)), fabs(c - cos((double) angle)));
+        if(error > maxError) maxError = error;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(maxError < 1.1e-7, "sincos above 1.1e-7 for |angle| <= 100");
+}
+
+void test_exp() {
+    double maxError = 0;
+    for (int i = 0; i <= 4000000; i++) {
+        float x = -87 + 175.0 * i / 4000000;
+        double error = fabs(FastMath::exp(x) / exp((double) x) - 1);
+        if(error > maxError) maxError = error;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(maxError < 2.6e-7, "exp above 2.6e-7 relative");
+    TEST_ASSERT_EQUAL(0.0f, FastMath::exp(-100));
+    TEST_ASSERT_TRUE(isfinite(FastMath::exp(100)));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_atan2);
+    RUN_TEST(test_asin);
+    RUN_TEST(test_sincos);
+    RUN_TEST(test_exp);
+    RUN_TEST(test_rsqrt_relative_error);
+    RUN_TEST(test_rsqrt_all_normal_floats);
+    return UNITY_END();
+}
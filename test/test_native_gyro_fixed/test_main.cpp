@@ -0,0 +1,128 @@
+/**
+ * @file test_main.cpp
+ * @author Timo Lehnertz
+ * @brief Fixed point gyro path against the float path of the ICM-42688-P sensor, with and without low pass
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <unity.h>
+#include <gyroFixed.h>
+#include <gyroLowPass.h>
+
+/**
+ * Deterministic noise in -1 - 1
+ */
+float noise(uint32_t i, uint32_t salt) {
+    uint32_t x = i * 2654435761UL ^ salt * 40503UL;
+    x ^= x >> 13;
+    x *= 0x5bd1e995;
+    x ^= x >> 15;
+    return (float) (x & 0xFFFF) / 32768.0f - 1.0f;
+}
+
+/**
+ * Replays 20000 samples of +-1500 deg/s swings with noise through both paths, calibrated like the sensor does.
+ *
+ * @param fullScaleCounts counts at 2000 deg/s, 32768 for 16 bit and 524288 for 20 bit FIFO packets
+ * @return largest difference in deg/s
+ */
+float maxDifference(int32_t fullScaleCounts, float cutoffHz, float sampleHz) {
+    const float degPerCount = 2000.0f / fullScaleCounts;
+    const int sign[3] = {1, 1, -1};
+    const float offset[3] = {0.3f, -1.2f, 0.05f};
+    const float scale[3] = {1.01f, 0.99f, 1.0f};
+    const Vec3 gyroOffset(offset[0], offset[1], offset[2]);
+    const Vec3 gyroScale(scale[0], scale[1], scale[2]);
+
+    GyroLowPass lpf;
+    lpf.configure(cutoffHz, sampleHz);
+    GyroRateFixed fixed;
+    fixed.configure(degPerCount, sign, offset, scale, lpf.getFactor());
+
+    float maxDiff = 0;
+    for (uint32_t i = 0; i < 20000; i++) {
+        float t = i / sampleHz;
+        int32_t counts[3];
+        for (int axis = 0; axis < 3; axis++) {
+            float rate = 1500.0f * sinf(t * (2.0f + axis)) + 20.0f * noise(i, axis);
+            counts[axis] = (int32_t) (rate / degPerCount);
+        }
+        // as in ICM42688Sensor::handle
+        Vec3 raw(counts[0] * degPerCount, counts[1] * degPerCount, -counts[2] * degPerCount);
+        Vec3 rate = lpf.update((raw - gyroOffset) * gyroScale);
+        fixed.update(counts);
+        for (int axis = 0; axis < 3; axis++) {
+            float diff = fabsf(fixed.getRate(axis) - (float) rate.getAxis(axis));
+            if(diff > maxDiff) maxDiff = diff;
+        }
+    }
+    return maxDiff;
+}
+
+void testFactor() {
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, GyroLowPass::factor(0, 4000));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, GyroLowPass::factor(100, 0));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.0f - expf(-2.0f * (float) M_PI * 100.0f / 4000.0f), GyroLowPass::factor(100, 4000));
+}
+
+void testPassThrough() {
+    GyroLowPass lpf;
+    lpf.configure(0, 4000);
+    Vec3 rate(12.5, -300.25, 0.125);
+    TEST_ASSERT_TRUE(lpf.update(Vec3()) == Vec3());
+    TEST_ASSERT_TRUE(lpf.update(rate) == rate);
+}
+
+void testReconfigure() {
+    GyroLowPass lpf;
+    TEST_ASSERT_FALSE(lpf.isConfigured(0, 4000));
+    lpf.configure(0, 4000);
+    TEST_ASSERT_TRUE(lpf.isConfigured(0, 4000));
+    TEST_ASSERT_FALSE(lpf.isConfigured(100, 4000));
+    TEST_ASSERT_FALSE(lpf.isConfigured(0, 8000));
+}
+
+void testStepResponse() {
+    GyroLowPass lpf;
+    lpf.configure(100, 4000);
+    lpf.update(Vec3());
+    Vec3 out;
+    // one time constant is 4000 / (2 pi 100) = 6.4 samples
+    for (int i = 0; i < 64; i++) {
+        out = lpf.update(Vec3(100, 100, 100));
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 100, out.x);
+}
+
+void testParity16Bit() {
+    TEST_ASSERT_LESS_THAN_FLOAT(2e-4f, maxDifference(32768, 0, 4000));
+}
+
+void testParity20Bit() {
+    TEST_ASSERT_LESS_THAN_FLOAT(2e-4f, maxDifference(524288, 0, 4000));
+}
+
+void testParityLowPass() {
+    TEST_ASSERT_LESS_THAN_FLOAT(2e-4f, maxDifference(32768, 100, 4000));
+    TEST_ASSERT_LESS_THAN_FLOAT(2e-4f, maxDifference(524288, 100, 4000));
+    TEST_ASSERT_LESS_THAN_FLOAT(2e-4f, maxDifference(524288, 30, 8000));
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(testFactor);
+    RUN_TEST(testPassThrough);
+    RUN_TEST(testReconfigure);
+    RUN_TEST(testStepResponse);
+    RUN_TEST(testParity16Bit);
+    RUN_TEST(testParity20Bit);
+    RUN_TEST(testParityLowPass);
+    return UNITY_END();
+}
@@ -0,0 +1,382 @@
+/**
+ * @file test_main.cpp
+ * @author Timo Lehnertz
+ * @brief ICM42688 driver against a register level emulation of the chip: FIFO decoding, readFifo, timestamps and error paths
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <unity.h>
+#include <ICM42688.h>
+#include <deque>
+
+/**
+ * Register map of the ICM-42688-P behind SPI.
+ * First byte of a transaction is the address (bit 7 set for reads), following bytes auto increment it.
+ * FIFO_DATA does not increment and pops bytes from the FIFO. FIFO_COUNTH/L report its size in bytes, big endian
+ */
+class Icm42688Emulation : public SPIClass {
+public:
+    static constexpr uint8_t WHO_AM_I = 0x75;
+    static constexpr uint8_t REG_BANK_SEL = 0x76;
+    static constexpr uint8_t FIFO_COUNTH = 0x2E;
+    static constexpr uint8_t FIFO_COUNTL = 0x2F;
+    static constexpr uint8_t FIFO_DATA = 0x30;
+    static constexpr uint8_t SIGNAL_PATH_RESET = 0x4B;
+
+    uint8_t registers[4][128] = {};
+    uint8_t bank = 0;
+    std::deque<uint8_t> fifo;
+    int readOnlyRegister = -1; // bank 0 register that ignores writes
+    bool disconnected = false;  // MISO floats high
+
+    Icm42688Emulation(uint8_t whoAmI = 0x47) {
+        for (int b = 0; b < 4; b++) {
+            registers[b][WHO_AM_I] = whoAmI;
+        }
+    }
+
+    uint8_t reg(uint8_t address, uint8_t inBank = 0) {
+        return registers[inBank][address];
+    }
+
+    void beginTransaction(SPISettings settings) {
+        first = true;
+    }
+
+    uint8_t transfer(uint8_t data) {
+        if(first) {
+            first = false;
+            reading = data & 0x80;
+            address = data & 0x7F;
+            return 0;
+        }
+        if(disconnected) return 0xFF;
+        if(reading) {
+            uint8_t value = read(address);
+            if(address != FIFO_DATA) address++;
+            return value;
+        }
+        write(address++, data);
+        return 0;
+    }
+
+    void push(const uint8_t* data, size_t length) {
+        fifo.insert(fifo.end(), data, data + length);
+    }
+
+private:
+    bool first = true;
+    bool reading = false;
+    uint8_t address = 0;
+
+    uint8_t read(uint8_t a) {
+        if(a == REG_BANK_SEL) return bank;
+        if(bank == 0) {
+            if(a == FIFO_COUNTH) return fifo.size() >> 8;
+            if(a == FIFO_COUNTL) return fifo.size() & 0xFF;
+            if(a == FIFO_DATA) {
+                if(fifo.empty()) return 0xFF;
+                uint8_t value = fifo.front();
+                fifo.pop_front();
+                return value;
+            }
+        }
+        return registers[bank][a];
+    }
+
+    void write(uint8_t a, uint8_t data) {
+        if(a == REG_BANK_SEL) {
+            bank = data & 0x03;
+            return;
+        }
+        if(bank == 0 && a == SIGNAL_PATH_RESET && (data & 0x02)) {
+            fifo.clear();
+            return;
+        }
+        if(bank == 0 && a == readOnlyRegister) return;
+        if(a == WHO_AM_I) return;
+        registers[bank][a] = data;
+    }
+};
+
+struct Packet {
+    uint8_t bytes[20];
+    size_t size;
+};
+
+void put16(uint8_t* dest, int32_t value) {
+    dest[0] = (uint16_t) value >> 8;
+    dest[1] = (uint16_t) value & 0xFF;
+}
+
+/**
+ * Packet 3: header, accel, gyro, 8 bit temperature, timestamp
+ */
+Packet packet16(const int16_t accel[3], const int16_t gyro[3], int8_t temperature, uint16_t timestamp) {
+    Packet p = {};
+    p.size = 16;
+    p.bytes[0] = 0x68; // accel, gyro, timestamp in ODR
+    for (int axis = 0; axis < 3; axis++) {
+        put16(p.bytes + 1 + axis * 2, accel[axis]);
+        put16(p.bytes + 7 + axis * 2, gyro[axis]);
+    }
+    p.bytes[13] = (uint8_t) temperature;
+    put16(p.bytes + 14, timestamp);
+    return p;
+}
+
+/**
+ * Packet 4: header, upper 16 bits of accel and gyro, 16 bit temperature, timestamp, extension nibbles
+ */
+Packet packet20(const int32_t accel[3], const int32_t gyro[3], int16_t temperature, uint16_t timestamp) {
+    Packet p = {};
+    p.size = 20;
+    p.bytes[0] = 0x78;
+    for (int axis = 0; axis < 3; axis++) {
+        put16(p.bytes + 1 + axis * 2, accel[axis] >> 4);
+        put16(p.bytes + 7 + axis * 2, gyro[axis] >> 4);
+        p.bytes[17 + axis] = ((accel[axis] & 0x0F) << 4) | (gyro[axis] & 0x0F);
+    }
+    put16(p.bytes + 13, temperature);
+    put16(p.bytes + 15, timestamp);
+    return p;
+}
+
+const int16_t accelA[3] = {100, -200, 2048};
+const int16_t gyroA[3] = {-1, 32767, -32767};
+
+void setUp() {}
+void tearDown() {}
+
+/**
+ * Decoding without bus access
+ */
+void test_decode_packet16() {
+    Packet p = packet16(accelA, gyroA, -12, 0xBEEF);
+    ICM42688::FifoSample sample;
+    TEST_ASSERT_EQUAL(1, ICM42688::decodeFifo(p.bytes, p.size, &sample, 1));
+    for (int axis = 0; axis < 3; axis++) {
+        TEST_ASSERT_EQUAL_INT32(accelA[axis], sample.accel[axis]);
+        TEST_ASSERT_EQUAL_INT32(gyroA[axis], sample.gyro[axis]);
+    }
+    TEST_ASSERT_EQUAL_INT(-12, sample.temperature);
+    TEST_ASSERT_EQUAL_UINT32(0xBEEF, sample.timestamp);
+    TEST_ASSERT_TRUE(sample.accelValid);
+    TEST_ASSERT_TRUE(sample.gyroValid);
+}
+
+void test_decode_packet20() {
+    const int32_t accel[3] = {524287, -524288 + 16, -5};
+    const int32_t gyro[3] = {-1, 17, 300001};
+    Packet p = packet20(accel, gyro, -1234, 7);
+    ICM42688::FifoSample sample;
+    TEST_ASSERT_EQUAL(1, ICM42688::decodeFifo(p.bytes, p.size, &sample, 1));
+    for (int axis = 0; axis < 3; axis++) {
+        TEST_ASSERT_EQUAL_INT32(accel[axis], sample.accel[axis]);
+        TEST_ASSERT_EQUAL_INT32(gyro[axis], sample.gyro[axis]);
+    }
+    TEST_ASSERT_EQUAL_INT(-1234, sample.temperature);
+    TEST_ASSERT_EQUAL_UINT32(7, sample.timestamp);
+}
+
+void test_decode_invalid_marker() {
+    const int16_t accel[3] = {0, INT16_MIN, 0};
+    Packet p = packet16(accel, gyroA, 0, 0);
+    ICM42688::FifoSample sample;
+    TEST_ASSERT_EQUAL(1, ICM42688::decodeFifo(p.bytes, p.size, &sample, 1));
+    TEST_ASSERT_FALSE(sample.accelValid);
+    TEST_ASSERT_TRUE(sample.gyroValid);
+}
+
+/**
+ * Single sensor packets are skipped, an empty marker or a cut off packet ends decoding
+ */
+void test_decode_stops_at_empty_and_partial_packets() {
+    uint8_t data[64] = {};
+    Packet a = packet16(accelA, gyroA, 0, 1);
+    data[0] = 0x40; // packet 1: accel only, 8 bytes
+    memcpy(data + 8, a.bytes, 16);
+    memcpy(data + 24, a.bytes, 16);
+    data[40] = 0x80; // empty
+    memcpy(data + 41, a.bytes, 16);
+    ICM42688::FifoSample samples[4];
+    TEST_ASSERT_EQUAL(2, ICM42688::decodeFifo(data, sizeof(data), samples, 4));
+    TEST_ASSERT_EQUAL(1, ICM42688::decodeFifo(data, 8 + 16 + 15, samples, 4));
+    TEST_ASSERT_EQUAL(1, ICM42688::decodeFifo(data, sizeof(data), samples, 1));
+}
+
+/**
+ * begin() against the register map
+ */
+void test_begin_configures_the_chip() {
+    Icm42688Emulation chip;
+    ICM42688 imu(chip, 10);
+    TEST_ASSERT_EQUAL_INT(1, imu.begin());
+    TEST_ASSERT_EQUAL_UINT8(0x33, chip.reg(0x4C));  // INTF_CONFIG0: spi only, big endian
+    TEST_ASSERT_EQUAL_UINT8(0x0F, chip.reg(0x4E));  // PWR_MGMT0: gyro and accel low noise
+    TEST_ASSERT_EQUAL_UINT8(0x03, chip.reg(0x4F));  // GYRO_CONFIG0: 2000dps, 8kHz
+    TEST_ASSERT_EQUAL_UINT8(0x03, chip.reg(0x50));  // ACCEL_CONFIG0: 16g, 8kHz
+    TEST_ASSERT_EQUAL_UINT8(0x21, chip.reg(0x54));  // TMST_CONFIG
+    TEST_ASSERT_EQUAL_UINT8(0x00, chip.reg(0x16));  // FIFO_CONFIG: bypass
+    TEST_ASSERT_EQUAL_UINT32(8000, imu.getOdrHz());
+
+    TEST_ASSERT_EQUAL_INT(1, imu.setGyroAaf(ICM42688::AAF_BANDWIDTH_997HZ));
+    TEST_ASSERT_EQUAL_UINT8(21, chip.reg(0x0C, 1));                 // GYRO_CONFIG_STATIC3: delt
+    TEST_ASSERT_EQUAL_UINT8(440 & 0xFF, chip.reg(0x0D, 1));         // deltSqr low
+    TEST_ASSERT_EQUAL_UINT8((6 << 4) | (440 >> 8), chip.reg(0x0E, 1));
+    TEST_ASSERT_EQUAL_UINT8(0, chip.bank);                          // back in bank 0
+}
+
+/**
+ * readFifo: only complete packets are read, the rest stays in the FIFO
+ */
+void test_read_fifo_16() {
+    Icm42688Emulation chip;
+    ICM42688 imu(chip, 10);
+    TEST_ASSERT_EQUAL_INT(1, imu.begin());
+    TEST_ASSERT_EQUAL_INT(1, imu.enableFifo(false));
+    TEST_ASSERT_EQUAL_UINT8(0x40, chip.reg(0x16));  // stream mode
+    TEST_ASSERT_EQUAL_UINT8(0x07, chip.reg(0x5F));  // accel, gyro, temp without hires
+    for (uint16_t i = 0; i < 3; i++) {
+        const int16_t gyro[3] = {(int16_t) (i * 100), 0, 0};
+        Packet p = packet16(accelA, gyro, 10, 1000 + i * 125);
+        chip.push(p.bytes, p.size);
+    }
+    Packet next = packet16(accelA, gyroA, 0, 1375);
+    chip.push(next.bytes, 5);
+
+    uint64_t before = micros();
+    TEST_ASSERT_EQUAL_INT(3, imu.readFifo());
+    uint64_t after = micros();
+    TEST_ASSERT_EQUAL(5, chip.fifo.size());
+    TEST_ASSERT_EQUAL(3, imu.getFifoSampleCount());
+    TEST_ASSERT_EQUAL_INT32(200, imu.getFifoSample(2).gyro[0]);
+    // newest sample is stamped with the read time, the others by their chip timestamp distance
+    TEST_ASSERT_TRUE(imu.getFifoSampleTimeUs(2) >= before && imu.getFifoSampleTimeUs(2) <= after);
+    TEST_ASSERT_EQUAL_UINT64(125, imu.getFifoSampleTimeUs(2) - imu.getFifoSampleTimeUs(1));
+    TEST_ASSERT_EQUAL_UINT64(250, imu.getFifoSampleTimeUs(2) - imu.getFifoSampleTimeUs(0));
+    TEST_ASSERT_EQUAL_UINT64(imu.getFifoSampleTimeUs(2), imu.getSampleTimeUs());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 200 * 2000.0 / 32768.0, imu.getGyroX_dps());
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 2048 / 2048.0, imu.getAccelZ_G());
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 10 / 2.07 + 25, imu.getTemperature_C());
+}
+
+void test_read_fifo_20() {
+    Icm42688Emulation chip;
+    ICM42688 imu(chip, 10);
+    TEST_ASSERT_EQUAL_INT(1, imu.begin());
+    TEST_ASSERT_EQUAL_INT(1, imu.enableFifo(true));
+    TEST_ASSERT_EQUAL_UINT8(0x17, chip.reg(0x5F));
+    const int32_t accel[3] = {0, 0, 32768};         // 1G at 8192 LSB/g times 4
+    const int32_t gyro[3] = {262144, 0, -131072};    // 1000 and -500 dps at 131.072 LSB/dps times 2
+    Packet p = packet20(accel, gyro, 0, 50);
+    chip.push(p.bytes, p.size);
+    chip.push(p.bytes, 12);
+    TEST_ASSERT_EQUAL_INT(1, imu.readFifo());
+    TEST_ASSERT_EQUAL(12, chip.fifo.size());
+    TEST_ASSERT_FLOAT_WITHIN(1e-5, 1.0, imu.getAccelZ_G());
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 1000.0, imu.getGyroX_dps());
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, -500.0, imu.getGyroZ_dps());
+}
+
+/**
+ * The 16 bit chip timestamp wraps every 65ms at 1us resolution. Sample spacing has to survive the wrap within and across reads
+ */
+void test_read_fifo_timestamp_wrap() {
+    Icm42688Emulation chip;
+    ICM42688 imu(chip, 10);
+    TEST_ASSERT_EQUAL_INT(1, imu.begin());
+    TEST_ASSERT_EQUAL_INT(1, imu.enableFifo(false));
+    const uint16_t stamps[] = {0xFF00, 0xFF80, 0x0000, 0x0080};
+    for (uint16_t stamp : stamps) {
+        Packet p = packet16(accelA, gyroA, 0, stamp);
+        chip.push(p.bytes, p.size);
+    }
+    TEST_ASSERT_EQUAL_INT(4, imu.readFifo());
+    TEST_ASSERT_EQUAL_UINT64(0x80, imu.getFifoSampleTimeUs(2) - imu.getFifoSampleTimeUs(1));
+    TEST_ASSERT_EQUAL_UINT64(0x180, imu.getFifoSampleTimeUs(3) - imu.getFifoSampleTimeUs(0));
+
+    Packet p = packet16(accelA, gyroA, 0, 0x0100);
+    chip.push(p.bytes, p.size);
+    TEST_ASSERT_EQUAL_INT(1, imu.readFifo());
+    TEST_ASSERT_EQUAL(1, imu.getFifoSampleCount());
+}
+
+void test_read_fifo_empty() {
+    Icm42688Emulation chip;
+    ICM42688 imu(chip, 10);
+    TEST_ASSERT_EQUAL_INT(1, imu.begin());
+    TEST_ASSERT_EQUAL_INT(1, imu.enableFifo(false));
+    TEST_ASSERT_EQUAL_INT(0, imu.readFifo());
+    Packet p = packet16(accelA, gyroA, 0, 0);
+    chip.push(p.bytes, 15);
+    TEST_ASSERT_EQUAL_INT(0, imu.readFifo());
+    TEST_ASSERT_EQUAL(15, chip.fifo.size());
+}
+
+/**
+ * Error paths. SPI has no acknowledge, so a missing or broken chip only shows up in the data
+ */
+void test_read_fifo_disabled() {
+    Icm42688Emulation chip;
+    ICM42688 imu(chip, 10);
+    TEST_ASSERT_EQUAL_INT(1, imu.begin());
+    TEST_ASSERT_EQUAL_INT(-1, imu.readFifo());
+    TEST_ASSERT_EQUAL_INT(1, imu.enableFifo(false));
+    TEST_ASSERT_EQUAL_INT(1, imu.disableFifo());
+    TEST_ASSERT_EQUAL_INT(-1, imu.readFifo());
+}
+
+void test_begin_wrong_device() {
+    Icm42688Emulation chip(0x71); // MPU9250
+    ICM42688 imu(chip, 10);
+    TEST_ASSERT_EQUAL_INT(-3, imu.begin());
+}
+
+void test_begin_register_write_not_taken() {
+    Icm42688Emulation chip;
+    chip.readOnlyRegister = 0x4E; // PWR_MGMT0
+    ICM42688 imu(chip, 10);
+    TEST_ASSERT_EQUAL_INT(-5, imu.begin());
+}
+
+void test_no_device_on_the_bus() {
+    SPIClass floating;
+    ICM42688 imu(floating, 10);
+    TEST_ASSERT_EQUAL_INT(-3, imu.begin());
+    TEST_ASSERT_EQUAL_INT(-1, imu.setGyroRange(ICM42688::GYRO_RANGE_2000DPS)); // read back fails
+}
+
+void test_read_fifo_lost_device() {
+    Icm42688Emulation chip;
+    ICM42688 imu(chip, 10);
+    TEST_ASSERT_EQUAL_INT(1, imu.begin());
+    TEST_ASSERT_EQUAL_INT(1, imu.enableFifo(false));
+    Packet p = packet16(accelA, gyroA, 0, 0);
+    chip.push(p.bytes, p.size);
+    chip.disconnected = true;
+    TEST_ASSERT_EQUAL_INT(-2, imu.readFifo());
+    TEST_ASSERT_EQUAL(0, imu.getFifoSampleCount());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_decode_packet16);
+    RUN_TEST(test_decode_packet20);
+    RUN_TEST(test_decode_invalid_marker);
+    RUN_TEST(test_decode_stops_at_empty_and_partial_packets);
+    RUN_TEST(test_begin_configures_the_chip);
+    RUN_TEST(test_read_fifo_16);
+    RUN_TEST(test_read_fifo_20);
+    RUN_TEST(test_read_fifo_timestamp_wrap);
+    RUN_TEST(test_read_fifo_empty);
+    RUN_TEST(test_read_fifo_disabled);
+    RUN_TEST(test_begin_wrong_device);
+    RUN_TEST(test_begin_register_write_not_taken);
+    RUN_TEST(test_no_device_on_the_bus);
+    RUN_TEST(test_read_fifo_lost_device);
+    return UNITY_END();
+}
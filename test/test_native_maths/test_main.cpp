@@ -0,0 +1,75 @@
+/**
+ * @file test_main.cpp
+ * @author Timo Lehnertz
+ * @brief Legacy double classes against the templated core (quaternion.h, matrix.h) in double precision
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <unity.h>
+#include <maths.h>
+#include <matrix.h>
+
+constexpr int samples = 100000;
+constexpr double tolerance = 1e-15;
+
+/**
+ * Deterministic pseudo random value in -1 - 1
+ */
+double input(int i, int salt) {
+    uint32_t x = (uint32_t) (i * 2654435761UL) ^ (uint32_t) (salt * 40503UL);
+    x ^= x >> 13;
+    x *= 0x5bd1e995;
+    x ^= x >> 15;
+    return (double) (x & 0xFFFF) / 32768.0 - 1.0;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_euler_to_quaternion() {
+    double maxError = 0;
+    for (int i = 0; i < samples; i++) {
+        double roll = input(i, 1) * 3, pitch = input(i, 2) * 1.5, yaw = input(i, 3) * 3;
+        Quaternion legacy(EulerRotation(roll, pitch, yaw));
+        Quaterniond q = Quaterniond::fromEulerZYX(roll, pitch, yaw);
+        maxError = fmax(maxError, fmax(fmax(fabs(legacy.w - q.w), fabs(legacy.x - q.x)), fmax(fabs(legacy.y - q.y), fabs(legacy.z - q.z))));
+    }
+    TEST_ASSERT_TRUE_MESSAGE(maxError < tolerance, "Quaternion(EulerRotation) differs from Quaterniond::fromEulerZYX");
+}
+
+void test_quaternion_to_euler() {
+    double maxError = 0;
+    for (int i = 0; i < samples; i++) {
+        Quaterniond q = Quaterniond::fromEulerZYX(input(i, 1) * 3, input(i, 2) * 1.5, input(i, 3) * 3);
+        EulerRotation legacy = Quaternion(q).toEulerZYX();
+        Vec3d e = q.toEulerZYX();
+        maxError = fmax(maxError, fmax(fabs(legacy.x - e.x), fmax(fabs(legacy.y - e.y), fabs(legacy.z - e.z))));
+    }
+    TEST_ASSERT_TRUE_MESSAGE(maxError < tolerance, "Quaternion::toEulerZYX differs from Quaterniond::toEulerZYX");
+}
+
+void test_euler_matrix() {
+    double maxError = 0;
+    for (int i = 0; i < samples; i++) {
+        double roll = input(i, 1) * 3, pitch = input(i, 2) * 1.5, yaw = input(i, 3) * 3;
+        Matrix3 legacy = EulerRotation(roll, pitch, yaw).getMatrix();
+        Matrix3T<double> m = Matrix3T<double>::rotationZYX(roll, pitch, yaw);
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                maxError = fmax(maxError, fabs(legacy.m[r * 3 + c] - m.m[r][c]));
+            }
+        }
+    }
+    TEST_ASSERT_TRUE_MESSAGE(maxError < tolerance, "EulerRotation::getMatrix differs from Matrix3T<double>::rotationZYX");
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_euler_to_quaternion);
+    RUN_TEST(test_quaternion_to_euler);
+    RUN_TEST(test_euler_matrix);
+    return UNITY_END();
+}
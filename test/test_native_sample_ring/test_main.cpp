@@ -0,0 +1,185 @@
+/**
+ * @file test_main.cpp
+ * @author Timo Lehnertz
+ * @brief SampleRing wrap-around, reader overrun, spans across the wrap and publishing between threads
+ * @version 0.1
+ * @date 2022-05-01
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <unity.h>
+#include <sampleRing.h>
+#include <atomic>
+#include <thread>
+
+typedef SampleRing<8> Ring;
+
+/**
+ * Sample i carries (i, 2i, -i) at time 1000 + i so every value identifies its sample
+ */
+void pushSamples(Ring& ring, uint32_t from, uint32_t count) {
+    for (uint32_t i = from; i < from + count; i++) {
+        ring.push(i, 2.0f * i, -(float) i, 1000 + i);
+    }
+}
+
+void testFillWithoutWrap() {
+    static Ring ring;
+    pushSamples(ring, 0, 5);
+    TEST_ASSERT_EQUAL_INT(5, ring.getHead());
+    TEST_ASSERT_EQUAL_INT(5, ring.getCount());
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, ring.getX(0));
+    TEST_ASSERT_EQUAL_FLOAT(-2.0f, ring.getZ(2));
+    TEST_ASSERT_EQUAL_INT(1000, ring.getTime(4));
+
+    // more than pushed is clamped
+    SampleSpan<float> span = ring.getAxis(1, 20);
+    TEST_ASSERT_EQUAL_INT(5, span.length());
+    TEST_ASSERT_EQUAL_INT(0, span.secondLength);
+    for (size_t i = 0; i < span.length(); i++) {
+        TEST_ASSERT_EQUAL_FLOAT(2.0f * i, span[i]);
+    }
+}
+
+void testWrapAround() {
+    static Ring ring;
+    pushSamples(ring, 0, 13);
+    TEST_ASSERT_EQUAL_INT(13, ring.getHead());
+    TEST_ASSERT_EQUAL_INT(Ring::capacity, ring.getCount());
+    for (size_t age = 0; age < Ring::capacity; age++) {
+        uint32_t i = 12 - age;
+        TEST_ASSERT_EQUAL_FLOAT((float) i, ring.getX(age));
+        TEST_ASSERT_EQUAL_FLOAT(2.0f * i, ring.getY(age));
+        TEST_ASSERT_EQUAL_FLOAT(-(float) i, ring.getZ(age));
+        TEST_ASSERT_EQUAL_INT(1000 + i, ring.getTime(age));
+    }
+}
+
+void testSpanAcrossWrap() {
+    static Ring ring;
+    pushSamples(ring, 0, 13); // newest at slot 4, oldest valid sample 5 at slot 5
+
+    SampleSpan<float> x = ring.getAxis(0, Ring::capacity);
+    TEST_ASSERT_EQUAL_INT(Ring::capacity, x.length());
+    TEST_ASSERT_EQUAL_INT(3, x.firstLength);  // slots 5 - 7
+    TEST_ASSERT_EQUAL_INT(5, x.secondLength); // slots 0 - 4
+    for (size_t i = 0; i < x.length(); i++) {
+        TEST_ASSERT_EQUAL_FLOAT(5.0f + i, x[i]);
+    }
+
+    // window ending right at the wrap
+    SampleSpan<uint64_t> times = ring.getTimes(6);
+    TEST_ASSERT_EQUAL_INT(6, times.length());
+    TEST_ASSERT_EQUAL_INT(1, times.firstLength);
+    for (size_t i = 0; i < times.length(); i++) {
+        TEST_ASSERT_EQUAL_INT(1000 + 7 + i, times[i]);
+    }
+
+    // window inside the second segment only
+    SampleSpan<float> z = ring.getAxis(2, 3);
+    TEST_ASSERT_EQUAL_INT(3, z.firstLength);
+    TEST_ASSERT_EQUAL_INT(0, z.secondLength);
+    TEST_ASSERT_EQUAL_FLOAT(-10.0f, z[0]);
+    TEST_ASSERT_EQUAL_FLOAT(-12.0f, z[2]);
+}
+
+void testCursorAcrossWrap() {
+    static Ring ring;
+    pushSamples(ring, 0, 6);
+    Ring::Cursor cursor = ring.createCursor(); // only sees samples from 6 on
+    TEST_ASSERT_EQUAL_INT(0, cursor.available());
+    float x, y, z;
+    uint64_t t;
+    TEST_ASSERT_FALSE(cursor.read(x, y, z, t));
+
+    pushSamples(ring, 6, 5); // slots 6, 7, 0, 1, 2
+    TEST_ASSERT_EQUAL_INT(5, cursor.available());
+    for (uint32_t i = 6; i < 11; i++) {
+        TEST_ASSERT_TRUE(cursor.read(x, y, z, t));
+        TEST_ASSERT_EQUAL_FLOAT((float) i, x);
+        TEST_ASSERT_EQUAL_FLOAT(2.0f * i, y);
+        TEST_ASSERT_EQUAL_FLOAT(-(float) i, z);
+        TEST_ASSERT_EQUAL_INT(1000 + i, t);
+    }
+    TEST_ASSERT_FALSE(cursor.read(x, y, z, t));
+
+    pushSamples(ring, 11, 2);
+    cursor.skip();
+    TEST_ASSERT_EQUAL_INT(0, cursor.available());
+}
+
+void testReaderOverrun() {
+    static Ring ring;
+    Ring::Cursor cursor = ring.createCursor();
+    pushSamples(ring, 0, 2 * Ring::capacity + 3);
+
+    // only the newest capacity samples are left, the older ones are skipped
+    TEST_ASSERT_EQUAL_INT(Ring::capacity, cursor.available());
+    float x, y, z;
+    uint64_t t;
+    uint32_t expected = Ring::capacity + 3;
+    while(cursor.read(x, y, z, t)) {
+        TEST_ASSERT_EQUAL_FLOAT((float) expected, x);
+        TEST_ASSERT_EQUAL_INT(1000 + expected, t);
+        expected++;
+    }
+    TEST_ASSERT_EQUAL_INT(2 * Ring::capacity + 3, expected);
+
+    // a partial overrun keeps the reader at the oldest sample still in the ring
+    pushSamples(ring, expected, 5);
+    TEST_ASSERT_TRUE(cursor.read(x, y, z, t));
+    pushSamples(ring, expected + 5, Ring::capacity);
+    TEST_ASSERT_EQUAL_INT(Ring::capacity, cursor.available());
+    TEST_ASSERT_TRUE(cursor.read(x, y, z, t));
+    TEST_ASSERT_EQUAL_FLOAT((float) (expected + 5), x);
+}
+
+/**
+ * A writer thread pushes while a reader thread consumes. The reader must never see a sample before it is complete.
+ * The writer stays less than half the capacity ahead, so the reader is never lapped while it reads a slot
+ */
+void testPublishBetweenThreads() {
+    static SampleRing<64> ring;
+    const uint32_t total = 200000;
+    std::atomic<uint32_t> consumed(0);
+    SampleRing<64>::Cursor cursor = ring.createCursor();
+
+    std::thread writer([&]() {
+        for (uint32_t i = 0; i < total; i++) {
+            while(i - consumed.load(std::memory_order_acquire) >= 32) {
+                std::this_thread::yield();
+            }
+            ring.push(i, 2.0f * i, -(float) i, i);
+        }
+    });
+
+    uint32_t expected = 0;
+    uint32_t torn = 0;
+    float x, y, z;
+    uint64_t t;
+    while(expected < total) {
+        if(!cursor.read(x, y, z, t)) continue;
+        if(t != expected || x != (float) expected || y != 2.0f * expected || z != -(float) expected) torn++;
+        expected++;
+        consumed.store(expected, std::memory_order_release);
+    }
+    writer.join();
+    TEST_ASSERT_EQUAL_INT(0, torn);
+    TEST_ASSERT_EQUAL_INT(total, ring.getHead());
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(testFillWithoutWrap);
+    RUN_TEST(testWrapAround);
+    RUN_TEST(testSpanAcrossWrap);
+    RUN_TEST(testCursorAcrossWrap);
+    RUN_TEST(testReaderOverrun);
+    RUN_TEST(testPublishBetweenThreads);
+    return UNITY_END();
+}